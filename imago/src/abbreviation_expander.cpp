@@ -0,0 +1,432 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "abbreviation_expander.h"
+
+#include <cctype>
+#include <cmath>
+#include <unordered_map>
+#include "molecule.h"
+#include "superatom.h"
+#include "periodic_table.h"
+#include "exception.h"
+#include "log_ext.h"
+
+namespace imago
+{
+	namespace abbreviation_expander
+	{
+		// fragments are written in a SMILES subset: elements, [X+]/[X-] charges,
+		// '=' and '#' bonds, branches and single-digit ring closures; the first atom is attached
+		struct AbbreviationDefinition
+		{
+			const char* names; // space separated
+			const char* fragment;
+		};
+
+		static const AbbreviationDefinition Definitions[] =
+		{
+			{ "Me",                        "C" },
+			{ "Et",                        "CC" },
+			{ "iPr",                       "C(C)C" },
+			{ "Bu nBu",                    "CCCC" },
+			{ "tBu",                       "C(C)(C)C" },
+			{ "Ph",                        "C1=CC=CC=C1" },
+			{ "Bn",                        "CC1=CC=CC=C1" },
+			{ "Bz",                        "C(=O)C1=CC=CC=C1" },
+			{ "Ac",                        "C(C)=O" },
+			{ "Boc BOC",                   "C(=O)OC(C)(C)C" },
+			{ "Ts",                        "S(=O)(=O)C1=CC=C(C)C=C1" },
+			{ "Ms",                        "S(C)(=O)=O" },
+			{ "Tf",                        "S(=O)(=O)C(F)(F)F" },
+			{ "OMe MeO",                   "OC" },
+			{ "OEt EtO",                   "OCC" },
+			{ "OAc AcO OAC",               "OC(C)=O" },
+			{ "OTf TfO",                   "OS(=O)(=O)C(F)(F)F" },
+			{ "OTs TsO",                   "OS(=O)(=O)C1=CC=C(C)C=C1" },
+			{ "OPh PhO",                   "OC1=CC=CC=C1" },
+			{ "OBn BnO",                   "OCC1=CC=CC=C1" },
+			{ "OCF3 F3CO",                 "OC(F)(F)F" },
+			{ "NHBoc NHBOC BocHN BocNH",   "NC(=O)OC(C)(C)C" },
+			{ "NHAc AcHN AcNH",            "NC(C)=O" },
+			{ "NMe2 Me2N",                 "N(C)C" },
+			{ "NEt2 Et2N",                 "N(CC)CC" },
+			{ "COOH CO2H HOOC HO2C",       "C(=O)O" },
+			{ "COOMe CO2Me MeOOC MeO2C",   "C(=O)OC" },
+			{ "COOEt CO2Et EtOOC EtO2C",   "C(=O)OCC" },
+			{ "CONH2 H2NOC",               "C(N)=O" },
+			{ "CHO OHC",                   "C=O" },
+			{ "CN",                        "C#N" },
+			{ "NO2 O2N",                   "[N+](=O)[O-]" },
+			{ "CF3 F3C",                   "C(F)(F)F" },
+			{ "CCl3 Cl3C",                 "C(Cl)(Cl)Cl" },
+			{ "SO3H HO3S",                 "S(=O)(=O)O" },
+			{ "SO2Me MeO2S",               "S(=O)(=O)C" },
+		};
+
+		struct Fragment
+		{
+			std::vector<ExportedAtom> atoms; // coordinates are not used
+			std::vector<ExportedBond> bonds;
+			std::vector<int> parent;         // spanning tree, -1 for the attachment atom
+			std::vector<int> ring;           // ring atoms in cycle order, empty if none
+		};
+
+		static void parseFragment(const std::string& smiles, Fragment& f)
+		{
+			std::vector<int> branches;
+			int ring_open[10];
+			for (int u = 0; u < 10; u++)
+				ring_open[u] = -1;
+
+			int prev = -1, order = 1;
+			for (size_t p = 0; p < smiles.size(); p++)
+			{
+				char c = smiles[p];
+				if (c == '=')
+					order = 2;
+				else if (c == '#')
+					order = 3;
+				else if (c == '(')
+					branches.push_back(prev);
+				else if (c == ')')
+				{
+					prev = branches.back();
+					branches.pop_back();
+				}
+				else if (isdigit(c))
+				{
+					int digit = c - '0';
+					if (ring_open[digit] < 0)
+						ring_open[digit] = prev;
+					else
+					{
+						ExportedBond bond;
+						bond.begin = ring_open[digit];
+						bond.end = prev;
+						bond.order = order;
+						f.bonds.push_back(bond);
+
+						// the ring is the tree path between the closure atoms
+						std::vector<int> path;
+						for (int v = prev; v != ring_open[digit]; v = f.parent[v])
+							path.push_back(v);
+						path.push_back(ring_open[digit]);
+						f.ring.assign(path.rbegin(), path.rend());
+
+						ring_open[digit] = -1;
+						order = 1;
+					}
+				}
+				else
+				{
+					ExportedAtom atom;
+					if (c == '[')
+					{
+						size_t close = smiles.find(']', p);
+						std::string inner = smiles.substr(p + 1, close - p - 1);
+						size_t sign = inner.find_first_of("+-");
+						atom.label = inner.substr(0, sign);
+						if (sign != std::string::npos)
+							atom.charge = (inner[sign] == '+') ? 1 : -1;
+						p = close;
+					}
+					else
+					{
+						atom.label = c;
+						if (p + 1 < smiles.size() && islower(smiles[p + 1]))
+							atom.label += smiles[++p];
+					}
+					atom.quality = -1;
+
+					int idx = (int)f.atoms.size();
+					f.atoms.push_back(atom);
+					f.parent.push_back(prev);
+					if (prev >= 0)
+					{
+						ExportedBond bond;
+						bond.begin = prev;
+						bond.end = idx;
+						bond.order = order;
+						f.bonds.push_back(bond);
+					}
+					prev = idx;
+					order = 1;
+				}
+			}
+		}
+
+		typedef std::unordered_map<std::string, Fragment> AbbreviationTable;
+
+		static const AbbreviationTable& getTable()
+		{
+			// built once, thread-safe since C++11
+			static const AbbreviationTable table = []()
+			{
+				AbbreviationTable result;
+				for (size_t u = 0; u < sizeof(Definitions) / sizeof(Definitions[0]); u++)
+				{
+					Fragment f;
+					parseFragment(Definitions[u].fragment, f);
+
+					std::string names = Definitions[u].names;
+					size_t start = 0;
+					while (start < names.size())
+					{
+						size_t end = names.find(' ', start);
+						if (end == std::string::npos)
+							end = names.size();
+						if (end > start)
+							result[names.substr(start, end - start)] = f;
+						start = end + 1;
+					}
+				}
+				return result;
+			}();
+			return table;
+		}
+
+		// returns true if the superatom is a single heavy atom with hydrogens, like OH or NH3+
+		static bool getHydride(const Superatom& satom, ExportedAtom& atom)
+		{
+			int heavy = -1, charge = 0;
+			for (size_t u = 0; u < satom.atoms.size(); u++)
+			{
+				const Atom& a = satom.atoms[u];
+				charge += a.charge;
+				if (a.getLabelFirst() == 'H' && a.getLabelSecond() == 0)
+					continue;
+				if (heavy >= 0 || a.count > 1)
+					return false;
+				heavy = (int)u;
+			}
+
+			if (heavy < 0)
+				return false;
+
+			std::string symbol = satom.atoms[heavy].getPrintableForm(false);
+			if (!AtomMap.lookup(symbol))
+				return false;
+
+			atom.label = symbol;
+			atom.charge = charge;
+			atom.isotope = satom.atoms[heavy].isotope;
+			return true;
+		}
+
+		static void rotate(double& x, double& y, double angle)
+		{
+			double c = cos(angle), s = sin(angle);
+			double nx = x * c - y * s;
+			double ny = x * s + y * c;
+			x = nx;
+			y = ny;
+		}
+
+		// appends the fragment atoms to 'out' replacing the atom 'idx', lays them out along (dx, dy)
+		static void insertFragment(const Fragment& f, int idx, double dx, double dy, ExportedStructure& out)
+		{
+			const double PI = 3.14159265358979323846;
+			size_t n = f.atoms.size();
+			std::vector<int> mapping(n);
+			std::vector<double> px(n), py(n), dirx(n), diry(n);
+			std::vector<bool> placed(n, false);
+			std::vector<int> depth(n, 0);
+
+			std::vector<bool> in_ring(n, false);
+			for (size_t r = 0; r < f.ring.size(); r++)
+				in_ring[f.ring[r]] = true;
+
+			ExportedAtom& attach = out.atoms[idx];
+			px[0] = attach.x;
+			py[0] = attach.y;
+			dirx[0] = dx;
+			diry[0] = dy;
+			placed[0] = true;
+
+			for (size_t a = 0; a < n; a++)
+			{
+				if (!placed[a])
+				{
+					int q = f.parent[a];
+
+					// siblings are spread symmetrically around the parent direction
+					std::vector<int> siblings;
+					for (size_t b = 1; b < n; b++)
+						if (f.parent[b] == q && !(in_ring[b] && in_ring[q]))
+							siblings.push_back((int)b);
+
+					double angle;
+					if (siblings.size() == 1 && in_ring[q])
+						angle = 0.0; // ring substituents are radial
+					else if (siblings.size() == 1)
+						angle = (depth[q] % 2 ? PI : -PI) / 3.0; // zig-zag chains
+					else
+					{
+						size_t k = 0;
+						while (siblings[k] != (int)a)
+							k++;
+						angle = -2.0 * PI / 3.0 + 4.0 * PI / 3.0 * (k + 1) / (siblings.size() + 1);
+					}
+
+					double x = dirx[q], y = diry[q];
+					rotate(x, y, angle);
+					px[a] = px[q] + x;
+					py[a] = py[q] + y;
+					dirx[a] = x;
+					diry[a] = y;
+					depth[a] = depth[q] + 1;
+					placed[a] = true;
+				}
+
+				// the whole ring is placed as a regular polygon when its first atom is reached
+				if (!f.ring.empty() && f.ring[0] == (int)a)
+				{
+					size_t m = f.ring.size();
+					double radius = 0.5 / sin(PI / m);
+					double cx = px[a] + dirx[a] * radius, cy = py[a] + diry[a] * radius;
+					for (size_t r = 1; r < m; r++)
+					{
+						int v = f.ring[r];
+						double x = -dirx[a], y = -diry[a];
+						rotate(x, y, 2.0 * PI * r / m);
+						px[v] = cx + x * radius;
+						py[v] = cy + y * radius;
+						dirx[v] = x;
+						diry[v] = y;
+						depth[v] = depth[a] + 1;
+						placed[v] = true;
+					}
+				}
+			}
+
+			// the attachment atom reuses the superatom record
+			attach.label = f.atoms[0].label;
+			attach.charge = f.atoms[0].charge;
+			attach.isotope = 0;
+			mapping[0] = idx;
+
+			for (size_t a = 1; a < n; a++)
+			{
+				ExportedAtom atom = f.atoms[a];
+				atom.x = px[a];
+				atom.y = py[a];
+				mapping[a] = (int)out.atoms.size();
+				out.atoms.push_back(atom);
+			}
+
+			for (size_t b = 0; b < f.bonds.size(); b++)
+			{
+				ExportedBond bond = f.bonds[b];
+				bond.begin = mapping[bond.begin];
+				bond.end = mapping[bond.end];
+				out.bonds.push_back(bond);
+			}
+		}
+
+		bool expand(const Settings& vars, const Molecule& mol, ExportedStructure& out)
+		{
+			logEnterFunction();
+
+			exportMolecule(vars, mol, out);
+
+			// superatoms in the same order as exported atoms
+			/*const*/ Skeleton::SkeletonGraph& graph = const_cast<Skeleton::SkeletonGraph&>(mol.getSkeleton());
+			const Molecule::ChemMapping& labels = mol.getMappedLabels();
+			std::vector<const Superatom*> satoms;
+			for (Skeleton::SkeletonGraph::vertex_iterator begin = graph.vertexBegin(), end = graph.vertexEnd(); begin != end; ++begin)
+			{
+				Molecule::ChemMapping::const_iterator it = labels.find(*begin);
+				satoms.push_back(it == labels.end() ? NULL : &it->second->satom);
+			}
+
+			const AbbreviationTable& table = getTable();
+			size_t count = out.atoms.size();
+
+			for (size_t idx = 0; idx < count; idx++)
+			{
+				if (satoms[idx] == NULL)
+					continue;
+
+				const Superatom& satom = *satoms[idx];
+				ExportedAtom& atom = out.atoms[idx];
+
+				if (satom.atoms.size() == 1)
+				{
+					const Atom& a = satom.atoms[0];
+					if (a.getLabelFirst() == 'R' && a.getLabelSecond() == 0)
+						continue; // R-groups are kept as is
+					if (AtomMap.lookup(atom.label))
+						continue;
+				}
+
+				if (getHydride(satom, atom))
+					continue;
+
+				AbbreviationTable::const_iterator it = table.find(atom.label);
+				if (it == table.end())
+				{
+					getLogExt().append("Unknown abbreviation", atom.label);
+					return false;
+				}
+
+				// fragments have a single attachment point
+				int degree = 0;
+				double nx = 0, ny = 0;
+				for (size_t b = 0; b < out.bonds.size(); b++)
+				{
+					int other = -1;
+					if (out.bonds[b].begin == (int)idx)
+						other = out.bonds[b].end;
+					else if (out.bonds[b].end == (int)idx)
+						other = out.bonds[b].begin;
+					if (other >= 0)
+					{
+						degree++;
+						nx += out.atoms[other].x;
+						ny += out.atoms[other].y;
+					}
+				}
+
+				if (degree > 1)
+				{
+					getLogExt().append("Abbreviation with several attachments", atom.label);
+					return false;
+				}
+
+				double dx = 1.0, dy = 0.0;
+				if (degree == 1)
+				{
+					dx = atom.x - nx;
+					dy = atom.y - ny;
+					double len = sqrt(dx * dx + dy * dy);
+					if (len > 0)
+					{
+						dx /= len;
+						dy /= len;
+					}
+					else
+					{
+						dx = 1.0;
+						dy = 0.0;
+					}
+				}
+
+				insertFragment(it->second, (int)idx, dx, dy, out);
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _abbreviation_expander_h
+#define _abbreviation_expander_h
+
+#include "structure_export.h"
+
+namespace imago
+{
+	class Molecule;
+
+	namespace abbreviation_expander
+	{
+		// builds the structure of the molecule with all superatoms expanded:
+		// hydride labels (OH, NH2, CH3...) become single atoms and known abbreviations
+		// (Ph, OMe, CO2H...) are replaced by their fragments.
+		// returns false if some label is unknown, the caller should fall back to Indigo then
+		bool expand(const Settings& vars, const Molecule& mol, ExportedStructure& out);
+	}
+}
+
+#endif // _abbreviation_expander_h
@@ -96,7 +96,7 @@ Vec2d Algebra::linesIntersection(const Settings& vars, const Vec2d &p11, const V
    Line l2 = points2line(p21, p22);
    double den = l1.A * l2.B - l2.A * l1.B;
 
-   if (absolute(den) < vars.routines.Algebra_IntersectionEps)
+   if (absolute(den) < vars.routines().Algebra_IntersectionEps)
    {
       Vec2d res;
       res.add(p11);
@@ -114,7 +114,7 @@ Vec2d Algebra::linesIntersection(const Settings& vars, const Line &l1, const Lin
 {
    double den = l1.A * l2.B - l2.A * l1.B; 
 
-   if (absolute(den) < vars.routines.Algebra_IntersectionEps) 
+   if (absolute(den) < vars.routines().Algebra_IntersectionEps) 
       throw DivizionByZeroException("linesIntersection");
 
    Vec2d res;
@@ -224,8 +224,8 @@ bool Algebra::SegmentsOnSameLine(const Settings& vars, Vec2d &b1, Vec2d &e1,
 	bdif.diff(b1, b2);
 	edif.diff(e1, e2);
 
-	if(Algebra::segmentsParallel(b1, e1, b2, e2, vars.routines.Algebra_SameLineEps) &&
-		Algebra::segmentsParallel(bdif, edif, b2, e2, vars.routines.Algebra_SameLineEps))
+	if(Algebra::segmentsParallel(b1, e1, b2, e2, vars.routines().Algebra_SameLineEps) &&
+		Algebra::segmentsParallel(bdif, edif, b2, e2, vars.routines().Algebra_SameLineEps))
 		return true;
 	return false;
 }
\ No newline at end of file
@@ -19,6 +19,8 @@
 #include <cmath>
 #include <cfloat>
 #include <deque>
+#include <mutex>
+#include <functional>
 #include <opencv2/opencv.hpp>
 #include <string.h> // memcpy
 #include "stl_fwd.h"
@@ -35,6 +37,7 @@
 #include "fonts_list.h"
 #include "file_helpers.h"
 #include "platform_tools.h"
+#include "pipeline_counters.h"
 
 using namespace imago;
 
@@ -66,20 +69,20 @@ bool imago::CharacterRecognizer::isPossibleCharacter(const Settings& vars, const
 	if (CharacterRecognizer::like_bonds.find(ch) != std::string::npos)
 	{
 		Points2i endpoints = SegmentTools::getEndpoints(seg);
-		if ((int)endpoints.size() < vars.characters.MinEndpointsPossible)
+		if ((int)endpoints.size() < vars.characters().MinEndpointsPossible)
 		{
 			return false;
 		}
 	}
 
-	if (best_dist < vars.characters.PossibleCharacterDistanceStrong && 
-		rd.getQuality() > vars.characters.PossibleCharacterMinimalQuality) 
+	if (best_dist < vars.characters().PossibleCharacterDistanceStrong && 
+		rd.getQuality() > vars.characters().PossibleCharacterMinimalQuality) 
 	{
 		return true;
 	}
 
-	if (loose_cmp && (best_dist < vars.characters.PossibleCharacterDistanceWeak 
-		          && rd.getQuality() > vars.characters.PossibleCharacterMinimalQuality))
+	if (loose_cmp && (best_dist < vars.characters().PossibleCharacterDistanceWeak 
+		          && rd.getQuality() > vars.characters().PossibleCharacterMinimalQuality))
 	{
 		return true;
 	}
@@ -116,6 +119,15 @@ void internalInitTemplates(imago::CharacterRecognizerImp::Templates& templates)
 	//printf("Loaded font (%u entries) in %u ms\n", templates.size(), platform::TICKS() - start);
 }
 
+const CharacterRecognizerImp::Templates& CharacterRecognizer::getTemplates()
+{
+	// initialized once and read-only after that, so it can be shared between threads
+	static std::once_flag init;
+	static CharacterRecognizerImp::Templates templates;
+	std::call_once(init, internalInitTemplates, std::ref(templates));
+	return templates;
+}
+
 
 RecognitionDistance CharacterRecognizer::recognize(const Settings& vars, const Segment &seg, const std::string &candidates) const
 {
@@ -127,30 +139,41 @@ RecognitionDistance CharacterRecognizer::recognize(const Settings& vars, const S
 	qword segHash = getSegmentHash(seg);	
 	getLogExt().append("Segment hash", segHash);
 	RecognitionDistance rec;
+	bool cached = false;
    
-	if (vars.caches.PCacheSymbolsRecognition &&
-		vars.caches.PCacheSymbolsRecognition->find(segHash) != vars.caches.PCacheSymbolsRecognition->end())
+	if (vars.caches.PCacheSymbolsRecognition)
+	{
+		std::lock_guard<std::mutex> lock(*vars.caches.PCacheLock);
+		RecognitionDistanceCacheType::const_iterator it = vars.caches.PCacheSymbolsRecognition->find(segHash);
+		if (it != vars.caches.PCacheSymbolsRecognition->end())
+		{
+			rec = it->second;
+			cached = true;
+		}
+	}
+
+	if (vars.caches.PCacheSymbolsRecognition)
+		pipeline_counters::add(cached ? pipeline_counters::CHARACTER_CACHE_HITS : pipeline_counters::CHARACTER_CACHE_MISSES);
+
+	if (cached)
 	{
-		rec = (*vars.caches.PCacheSymbolsRecognition)[segHash];
 		getLogExt().appendText("Used cache: clean");
 	}
 	else
 	{
-		static bool init = false;
-		static CharacterRecognizerImp::Templates templates;
-		
-		if (!init)
-		{
-			internalInitTemplates(templates);
-			init = true;
-		}
-
-		rec = CharacterRecognizerImp::recognizeMat(vars, seg, templates);
+		rec = CharacterRecognizerImp::recognizeMat(vars, seg, getTemplates());
 		getLogExt().appendMap("Font recognition result", rec);
 
 		if (vars.caches.PCacheSymbolsRecognition)
 		{
-			(*vars.caches.PCacheSymbolsRecognition)[segHash] = rec;
+			std::lock_guard<std::mutex> lock(*vars.caches.PCacheLock);
+			if (vars.caches.PCacheSymbolsRecognition->insert(std::make_pair(segHash, rec)).second)
+			{
+				// map nodes of the entry and of its distances
+				size_t bytes = sizeof(RecognitionDistanceCacheType::value_type) + sizeof(RecognitionDistance::value_type) * rec.size() +
+				               4 * sizeof(void*) * (rec.size() + 1);
+				vars.caches.PCacheMemory->resize(vars.caches.PCacheMemory->getBytes() + bytes);
+			}
 			getLogExt().appendText("Filled cache: clean");
 		}
 	}
@@ -278,7 +301,7 @@ namespace imago
 		cv::Mat1b prepareImage(const Settings& vars, const cv::Mat1b& src, double &ratio)
 		{
 			imago::Image temp;
-			cv::threshold(src, temp, vars.characters.InternalBinarizationThreshold, 255, CV_THRESH_BINARY);
+			cv::threshold(src, temp, vars.characters().InternalBinarizationThreshold, 255, CV_THRESH_BINARY);
 			temp.crop();
 			
 			if (temp.cols * temp.rows == 0)
@@ -294,7 +317,7 @@ namespace imago
 
 			cv::resize(temp, temp, cv::Size(size_x, size_y), 0.0, 0.0, cv::INTER_CUBIC);
 
-			cv::threshold(temp, temp, vars.characters.InternalBinarizationThreshold, 255, CV_THRESH_BINARY);
+			cv::threshold(temp, temp, vars.characters().InternalBinarizationThreshold, 255, CV_THRESH_BINARY);
 		
 			return temp;
 		}	
@@ -399,6 +422,7 @@ namespace imago
 				return _result;
 			}
 
+			long long compared = 0;
 			for (size_t u = 0; u < templates.size(); u++)
 			{
 				// Imago supports only one-char-length templates, TODO: upgrade
@@ -407,10 +431,11 @@ namespace imago
 
 				try
 				{
+					compared++;
 					double distance = compareImages(img, templates[u].penalty_ink, templates[u].penalty_white);
 					double ratio_diff = imago::absolute(ratio - templates[u].wh_ratio);
 				
-					if (ratio_diff < vars.characters.RatioDiffThresh)
+					if (ratio_diff < vars.characters().RatioDiffThresh)
 					{
 						results.push_back(ResultEntry(distance, templates[u].text));
 					}
@@ -420,6 +445,7 @@ namespace imago
 					printf("Exception: %s\n", e.what());
 				}
 			}
+			pipeline_counters::add(pipeline_counters::TEMPLATES_COMPARED, compared);
 
 			if (results.empty())
 				return _result;
@@ -430,7 +456,7 @@ namespace imago
 			{
 				if (results[u].text.size() == 1) // Imago supports only one-char-length templates
 				{
-					_result[results[u].text[0]] = results[u].value / vars.characters.DistanceScaleFactor;
+					_result[results[u].text[0]] = results[u].value / vars.characters().DistanceScaleFactor;
 				}
 			}
 
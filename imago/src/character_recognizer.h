@@ -29,6 +29,11 @@
 namespace imago
 {
    class Segment;   
+
+   namespace CharacterRecognizerImp
+   {
+		struct MatchRecord;
+   }
 	
    class CharacterRecognizer
    {
@@ -52,6 +57,7 @@ namespace imago
 
    private:
 	   static qword getSegmentHash(const Segment &seg);
+	   static const std::vector<CharacterRecognizerImp::MatchRecord>& getTemplates();
    };
 
    namespace CharacterRecognizerImp
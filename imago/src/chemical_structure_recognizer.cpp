@@ -40,6 +40,10 @@
 #include "pixel_boundings.h"
 #include "weak_segmentator.h"
 #include "platform_tools.h"
+#include "parallel_tools.h"
+#include "stage_timer.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
 
 using namespace imago;
 
@@ -49,9 +53,9 @@ ChemicalStructureRecognizer::ChemicalStructureRecognizer() : _cr()
 
 double maxHeightHelper(const Settings& vars, int lines)
 {
-	double maxHeight = (vars.lab_remover.HeightFactor * vars.dynamic.CapitalHeight 
+	double maxHeight = (vars.lab_remover().HeightFactor * vars.dynamic.CapitalHeight 
 		                    + (lines - 1) * vars.dynamic.CapitalHeight
-						) * vars.separator.capHeightMax;
+						) * vars.separator().capHeightMax;
 	return maxHeight;
 }
 
@@ -63,21 +67,21 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 	
 	getLogExt().append("Symbols height", vars.dynamic.CapitalHeight);
 
-	if (vars.dynamic.CapitalHeight < vars.lab_remover.MinCapitalHeight || 
-		vars.dynamic.CapitalHeight > vars.lab_remover.MaxCapitalHeight)
+	if (vars.dynamic.CapitalHeight < vars.lab_remover().MinCapitalHeight || 
+		vars.dynamic.CapitalHeight > vars.lab_remover().MaxCapitalHeight)
 	{
 		getLogExt().appendText("Unappropriate symbols height");
 		return result;
 	}
 
-	getLogExt().append("Symbols height max", vars.separator.capHeightMax);
+	getLogExt().append("Symbols height max", vars.separator().capHeightMax);
 	getLogExt().appendImage("img", img);
 	
-	const int min_cap_chars = vars.lab_remover.MinLabelChars;
-	double minWidth = min_cap_chars * (vars.estimation.MinSymRatio + vars.estimation.MaxSymRatio) / 2.0 * vars.dynamic.CapitalHeight * vars.estimation.CapitalHeightError;
-	double maxHeight = maxHeightHelper(vars, vars.lab_remover.MaxLabelLines);
-	double minHeight = vars.dynamic.CapitalHeight * vars.separator.capHeightMin;
-	double centerShiftMax = vars.lab_remover.CenterShiftMax;
+	const int min_cap_chars = vars.lab_remover().MinLabelChars;
+	double minWidth = min_cap_chars * (vars.estimation().MinSymRatio + vars.estimation().MaxSymRatio) / 2.0 * vars.dynamic.CapitalHeight * vars.estimation().CapitalHeightError;
+	double maxHeight = maxHeightHelper(vars, vars.lab_remover().MaxLabelLines);
+	double minHeight = vars.dynamic.CapitalHeight * vars.separator().capHeightMin;
+	double centerShiftMax = vars.lab_remover().CenterShiftMax;
 	int borderDistance = round(vars.dynamic.CapitalHeight);
 	getLogExt().append("minWidth", minWidth);
 	getLogExt().append("maxHeight", maxHeight);
@@ -130,7 +134,7 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 				value /= count;
 				getLogExt().append("Average density", value);
 
-				if (value > vars.lab_remover.MinimalDensity)
+				if (value > vars.lab_remover().MinimalDensity)
 				{
 					getLogExt().appendText("Caption bounding is found, filtering segments");
 
@@ -138,20 +142,20 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 					std::vector<Segment*> bad_graphics;
 
 					for (SegmentDeque::iterator it = symbols.begin(); it != symbols.end(); ++it)
-						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover.PixGapX && 
+						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover().PixGapX && 
 							(*it)->getX() < badBounding.x2() &&
-							(*it)->getY() >= badBounding.y1() - vars.lab_remover.PixGapY && 
-							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover.PixGapY)
+							(*it)->getY() >= badBounding.y1() - vars.lab_remover().PixGapY && 
+							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover().PixGapY)
 						{
 							bad_symbols.push_back(*it);
 						}
 			
 
 					for (SegmentDeque::iterator it = graphics.begin(); it != graphics.end(); ++it)
-						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover.PixGapX && 
+						if ((*it)->getX() >= badBounding.x1() - vars.lab_remover().PixGapX && 
 							(*it)->getX() < badBounding.x2() &&
-							(*it)->getY() >= badBounding.y1() - vars.lab_remover.PixGapY && 
-							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover.PixGapY)
+							(*it)->getY() >= badBounding.y1() - vars.lab_remover().PixGapY && 
+							(*it)->getY() + (*it)->getHeight() <= badBounding.y2() + vars.lab_remover().PixGapY)
 						{
 							bad_graphics.push_back(*it);
 						}
@@ -174,17 +178,21 @@ bool ChemicalStructureRecognizer::removeMoleculeCaptions(const Settings& vars, I
 	return result;
 }
 
-void ChemicalStructureRecognizer::segmentate(const Settings& vars, Image& img, SegmentDeque& segments, bool reconnect)
+void ChemicalStructureRecognizer::segmentate(const Settings& vars, Image& img, SegmentDeque& segments,
+                                             memory_budget::Reservation& segmentsMemory, bool reconnect)
 {
 	logEnterFunction();
+	logStageTime("segmentate");
 
 	// extract segments using WeakSegmentator
 	WeakSegmentator ws(img.getWidth(), img.getHeight());
-	ws.appendData(img, WeakSegmentator::getLookupPattern(vars.csr.WeakSegmentatorDist), reconnect);
+	ws.appendData(img, WeakSegmentator::getLookupPattern(vars.csr().WeakSegmentatorDist), reconnect);
 	for (WeakSegmentator::SegMap::iterator it = ws.SegmentPoints.begin(); it != ws.SegmentPoints.end(); ++it)
 	{
 		const Points2i& pts = it->second;
 		RectShapedBounding b(pts);
+		size_t pixels = (size_t)(b.getBounding().width + 1) * (b.getBounding().height + 1);
+		segmentsMemory.resize(segmentsMemory.getBytes() + sizeof(Segment) + pixels);
 		Segment *s = new Segment();		
 		s->init(b.getBounding().width+1, b.getBounding().height+1);
 		s->fillWhite();
@@ -194,6 +202,8 @@ void ChemicalStructureRecognizer::segmentate(const Settings& vars, Image& img, S
 			s->getByte(pts[u].x - b.getBounding().x, pts[u].y - b.getBounding().y) = 0;
 		segments.push_back(s);
 	}	
+
+	pipeline_counters::add(pipeline_counters::SEGMENTS_FOUND, (long long)ws.SegmentPoints.size());
 }
 
 void ChemicalStructureRecognizer::storeSegments(const Settings& vars, SegmentDeque& layer_symbols, SegmentDeque& layer_graphics)
@@ -211,7 +221,7 @@ void ChemicalStructureRecognizer::storeSegments(const Settings& vars, SegmentDeq
 
 		platform::MKDIR("./characters");
 
-		if (dist > vars.characters.PossibleCharacterDistanceWeak)
+		if (dist > vars.characters().PossibleCharacterDistanceWeak)
 		{
 			int digits = (int)std::log10(dist);
 			if(digits > 10)
@@ -222,7 +232,7 @@ void ChemicalStructureRecognizer::storeSegments(const Settings& vars, SegmentDeq
 			platform::MKDIR("./characters/bad");
 			sprintf(filename, "./characters/bad/%c_d%4.2f_q%4.2f.png", res, dist, qual);
 		}
-		else if (qual < vars.characters.PossibleCharacterMinimalQuality)
+		else if (qual < vars.characters().PossibleCharacterMinimalQuality)
 		{
 			platform::MKDIR("./characters/similar");
 			sprintf(filename, "./characters/similar/%c_d%4.2f_q%4.2f.png", res, dist, qual);
@@ -249,7 +259,7 @@ bool ChemicalStructureRecognizer::isReconnectSegmentsRequired(const Settings& va
 {
 	logEnterFunction();
 
-	if (img.getWidth() < vars.csr.SmallImageDim && img.getHeight() < vars.csr.SmallImageDim)
+	if (img.getWidth() < vars.csr().SmallImageDim && img.getHeight() < vars.csr().SmallImageDim)
 	{
 		getLogExt().appendText("Too small image to analyze");
 		return false;
@@ -267,11 +277,11 @@ bool ChemicalStructureRecognizer::isReconnectSegmentsRequired(const Settings& va
 	{
 		size_t count = SegmentTools::getAllFilled((*segments[u])).size();
 		avg_fill += count;
-		if (count < vars.prefilterCV.MinGoodPixelsCount / 2)
+		if (count < vars.prefilterCV().MinGoodPixelsCount / 2)
 			surely_bad++;
-		else if (count < vars.prefilterCV.MinGoodPixelsCount)
+		else if (count < vars.prefilterCV().MinGoodPixelsCount)
 			probably_bad++;
-		else if (count > vars.prefilterCV.MinGoodPixelsCount * 2)
+		else if (count > vars.prefilterCV().MinGoodPixelsCount * 2)
 			surely_good++;
 		else
 			probably_good++;
@@ -284,14 +294,41 @@ bool ChemicalStructureRecognizer::isReconnectSegmentsRequired(const Settings& va
 	getLogExt().append("Probably good", probably_good);
 	getLogExt().append("Surely good", surely_good);
 
-	bool result = (surely_bad > vars.csr.ReconnectMinBads) && 
-		          (vars.csr.ReconnectSurelyBadCoef * surely_bad > 
-				  vars.csr.ReconnectSurelyGoodCoef * surely_good + 
-				  vars.csr.ReconnectProbablyGoodCoef * probably_good );
+	bool result = (surely_bad > vars.csr().ReconnectMinBads) && 
+		          (vars.csr().ReconnectSurelyBadCoef * surely_bad > 
+				  vars.csr().ReconnectSurelyGoodCoef * surely_good + 
+				  vars.csr().ReconnectProbablyGoodCoef * probably_good );
 
 	return result;
 }
 
+void ChemicalStructureRecognizer::recognizeLabels(const Settings& vars, std::deque<Label>& labels)
+{
+	logEnterFunction();
+	logStageTime("recognize labels");
+
+	// labels are independent until mapping, so every task uses its own LabelLogic
+	// and writes only its own label; the log is not thread-safe, so keep serial order then
+	int threads = getLogExt().loggingEnabled() ? 1 : parallel_tools::getThreadsLimit(vars);
+	getLogExt().append("Labels count", labels.size());
+
+	parallel_tools::parallelFor(labels.size(), threads, [&](size_t idx)
+	{
+		if (vars.checkTimeLimit())
+			throw TimeLimitException();
+		LabelLogic ll(_cr);
+		ll.recognizeLabel(vars, labels[idx]);
+	});
+}
+
+static size_t _estimateSegmentsBytes(const SegmentDeque& segments)
+{
+	size_t result = 0;
+	for (SegmentDeque::const_iterator it = segments.begin(); it != segments.end(); ++it)
+		result += sizeof(Segment) + (*it)->total();
+	return result;
+}
+
 void ClearSegments(SegmentDeque& segs, SegmentDeque& segSymbols, SegmentDeque& segGraphics)
 {
 	std::map<std::string, Segment*> all_segs;
@@ -341,6 +378,8 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 
 	bool captions_removed = false;
 
+	pipeline_counters::add(pipeline_counters::RECOGNITIONS);
+
 	restart:
 
 	{
@@ -350,7 +389,7 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 		try
 		{
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			mol.clear();
      		
@@ -363,24 +402,29 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 				throw ImagoException("Empty image, nothing to recognize");
 			}
 
-			vars.dynamic.LineThickness = ImageUtils::estimateLineThickness(_img, vars.routines.LineThick_Grid);
+			vars.dynamic.LineThickness = ImageUtils::estimateLineThickness(_img, vars.routines().LineThick_Grid);
 	  
 			getLogExt().appendImage("Cropped image", _img);		
+
+			memory_budget::Reservation imageMemory(_img.total());
+			memory_budget::Reservation segmentsMemory;
 		
-			segmentate(vars, _img, segments);
+			segmentate(vars, _img, segments, segmentsMemory);
 		
 			bool reconnect = isReconnectSegmentsRequired(vars, _img, segments);
 			if (reconnect)
 			{
 				getLogExt().appendText("Reconnection procedure apply");
+				pipeline_counters::add(pipeline_counters::RESTARTS_RECONNECT);
 			
 				// use filter
+				memory_budget::Reservation tempMemory(_img.total());
 				Image temp_img;
 				temp_img.copy(_img);
 				prefilter_basic::prefilterBasicFullsize(vars, temp_img);
 
 				SegmentDeque temp;
-				segmentate(vars, temp_img, temp);
+				segmentate(vars, temp_img, temp, tempMemory);
 
 				if (temp.size() > 0)
 				{
@@ -389,10 +433,12 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 
 					segments = temp;
 				}			
+				tempMemory.resize(0);
+				segmentsMemory.resize(_estimateSegmentsBytes(segments));
 			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			if (segments.size() == 0)
 			{
@@ -401,19 +447,22 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 
 			WedgeBondExtractor wbe(segments, _img);
 			{
+				logStageTime("wedge detect");
 				int sdb_count = wbe.singleDownFetch(vars, mol);
 				getLogExt().append("Single-down bonds found", sdb_count);
 			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 	  
-			Separator sep(segments, _img);
-		
-			sep.Separate(vars, _cr, layer_symbols, layer_graphics);
+			{
+				logStageTime("separate");
+				Separator sep(segments, _img);
+				sep.Separate(vars, _cr, layer_symbols, layer_graphics);
+			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			getLogExt().append("Symbols", layer_symbols.size());
 			getLogExt().append("Graphics", layer_graphics.size());
@@ -425,13 +474,14 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 					captions_removed = true;					
 					getLogExt().appendText("Restart after molecule captions cleanup");
 					ClearSegments(segments, layer_symbols, layer_graphics);
+					pipeline_counters::add(pipeline_counters::RESTARTS_CAPTIONS);
 					// looks like performance degrade, but actually gives more accurate result (due to capital height re-estimation) at a almost zero-cost in terms of cpu time
 					goto restart;
 				}
 			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			if (layer_graphics.size() == 0 && layer_symbols.size() == 1)
 			{
@@ -471,13 +521,14 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 
 			if (!layer_symbols.empty())
 			{
+				logStageTime("label combine");
 				LabelCombiner lc(vars, layer_symbols, layer_graphics, _cr);
 
 				if (vars.dynamic.CapitalHeight > 0.0)
 					lc.extractLabels(mol.getLabels());
 			
 				if (vars.checkTimeLimit())
-					throw ImagoException("Timelimit exceeded");
+					throw TimeLimitException();
 
 				if (getLogExt().loggingEnabled())
 				{
@@ -502,57 +553,59 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 			getLogExt().appendText("Before line vectorization");
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
+			memory_budget::Reservation graphMemory;
 			{
+				logStageTime("vectorize");
 				BaseApproximator* approximator = NULL;
 
-				if (vars.csr.UseDPApproximator)
+				if (vars.csr().UseDPApproximator)
 					approximator = new DPApproximator();
 				else
 					approximator = new CvApproximator();
 
-				GraphicsDetector gd(approximator, vars.dynamic.LineThickness * vars.csr.LineVectorizationFactor);
+				GraphicsDetector gd(approximator, vars.dynamic.LineThickness * vars.csr().LineVectorizationFactor);
 				gd.extractRingsCenters(vars, layer_graphics, ringCenters);
-				GraphExtractor::extract(vars, gd, layer_graphics, mol);
+				GraphExtractor::extract(vars, gd, layer_graphics, mol, graphMemory);
 
 				delete approximator;
 			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
-			wbe.singleUpFetch(vars, mol);
+			{
+				logStageTime("wedge detect");
+				wbe.singleUpFetch(vars, mol);
+			}
 
-			while (mol._dissolveShortEdges(vars.csr.Dissolve, true))
+			while (mol._dissolveShortEdges(vars.csr().Dissolve, true))
 			{
 				if (vars.checkTimeLimit())
-					throw ImagoException("Timelimit exceeded");
+					throw TimeLimitException();
 			}
 
-			mol.deleteBadTriangles(vars.csr.DeleteBadTriangles);
+			mol.deleteBadTriangles(vars.csr().DeleteBadTriangles);
       
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			if (!layer_symbols.empty())
 			{         
-				LabelLogic ll(_cr);
 				std::deque<Label> unmapped_labels;
                  
-				for(Label &l: mol.getLabels())
-				{
-					if (vars.checkTimeLimit())
-						throw ImagoException("Timelimit exceeded");
-					ll.recognizeLabel(vars, l);				
-				}
+				recognizeLabels(vars, mol.getLabels());
          
 				getLogExt().appendText("Label recognizing");
          
-				mol.mapLabels(vars, unmapped_labels);
+				{
+					logStageTime("map labels");
+					mol.mapLabels(vars, unmapped_labels);
+				}
 
 				if (vars.checkTimeLimit())
-					throw ImagoException("Timelimit exceeded");
+					throw TimeLimitException();
 
 				GraphicsDetector().analyzeUnmappedLabels(unmapped_labels, ringCenters);
 				getLogExt().append("Found rings", ringCenters.size());
@@ -563,21 +616,24 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 			}
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 			
 			
 			mol.aromatize(ringCenters);
 
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
-			wbe.fixStereoCenters(mol);
+			{
+				logStageTime("wedge detect");
+				wbe.fixStereoCenters(mol);
+			}
 
 			mol.calcShortBondsPenalty(vars);			
 			//mol.calcCloseVerticiesPenalty(vars);
 		
 			if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 			ClearSegments(segments, layer_symbols, layer_graphics);
 
@@ -586,6 +642,9 @@ void ChemicalStructureRecognizer::recognize(Settings& vars, Molecule &mol)
 		catch (ImagoException&)
 		{
 			ClearSegments(segments, layer_symbols, layer_graphics);
+			// the aborting check may be deep inside any stage, so count it once here
+			if (vars.checkTimeLimit())
+				pipeline_counters::add(pipeline_counters::TIMELIMIT_ABORTS);
 			throw;
 		}
 	}
@@ -613,6 +672,12 @@ void ChemicalStructureRecognizer::setImage( Image &img )
    _origImage.copy(img);
 }
 
+void ChemicalStructureRecognizer::trimBuffers( size_t maxPixels )
+{
+   if (_origImage.total() > maxPixels)
+      _origImage.release();
+}
+
 ChemicalStructureRecognizer::~ChemicalStructureRecognizer()
 {
 }
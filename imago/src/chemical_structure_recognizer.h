@@ -20,12 +20,14 @@
 #include "character_recognizer.h"
 #include "stl_fwd.h"
 #include "settings.h"
+#include "memory_budget.h"
 
 namespace imago
 {
    class Molecule;
    class Segment;
    class CharacterRecognizer;
+   struct Label;
    
    class ChemicalStructureRecognizer
    {
@@ -38,6 +40,10 @@ namespace imago
 	  void extractCharacters (Settings& vars, Image& img);
       const CharacterRecognizer &getCharacterRecognizer() { return  _cr; };
 
+      // drops the working image buffer if it is larger than maxPixels,
+      // smaller ones are kept to be reused by images of the same size
+      void trimBuffers( size_t maxPixels );
+
       ~ChemicalStructureRecognizer();
 
    private:
@@ -45,9 +51,12 @@ namespace imago
       Image _origImage;
 
 	  bool removeMoleculeCaptions(const Settings& vars, Image& img, SegmentDeque& layer_symbols, SegmentDeque& layer_graphics);
-	  void segmentate(const Settings& vars, Image& img, SegmentDeque& segments, bool connect_mode = false);
+	  // charges every extracted segment to segmentsMemory before it is allocated
+	  void segmentate(const Settings& vars, Image& img, SegmentDeque& segments,
+	                  memory_budget::Reservation& segmentsMemory, bool connect_mode = false);
 	  void storeSegments(const Settings& vars, SegmentDeque& layer_symbols, SegmentDeque& layer_graphics);
 	  bool isReconnectSegmentsRequired(const Settings& vars, const Image& img, const SegmentDeque& segments);
+	  void recognizeLabels(const Settings& vars, std::deque<Label>& labels);
       
       ChemicalStructureRecognizer( const ChemicalStructureRecognizer &csr );
    };
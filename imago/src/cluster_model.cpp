@@ -0,0 +1,233 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+
+#include "cluster_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "comdef.h"
+#include "exception.h"
+#include "output.h"
+#include "scanner.h"
+#include "platform_tools.h"
+
+namespace imago
+{
+	int ClusterModel::select(const ImageFeatures& features) const
+	{
+		std::vector<double> v;
+		features.getVector(v);
+
+		int best = -1;
+		double best_distance = 0.0;
+		for (size_t c = 0; c < _clusters.size(); c++)
+		{
+			const std::vector<double>& centroid = _clusters[c].centroid;
+			double distance = 0.0;
+			for (size_t u = 0; u < v.size() && u < centroid.size(); u++)
+			{
+				double d = (v[u] - centroid[u]) * _scale[u];
+				distance += d * d;
+			}
+			if (best < 0 || distance < best_distance)
+			{
+				best = (int)c;
+				best_distance = distance;
+			}
+		}
+		return best;
+	}
+
+	size_t ClusterModel::size() const
+	{
+		return _clusters.size();
+	}
+
+	const std::string& ClusterModel::getConfigFile(int cluster) const
+	{
+		return _clusters[cluster].configFile;
+	}
+
+	void ClusterModel::train(const std::vector<std::string>& configFiles, const std::vector<ImageFeatures>& images,
+	                         const std::vector<int>& assignment)
+	{
+		_clusters.clear();
+		_scale.assign(ImageFeatures::VECTOR_SIZE, 1.0);
+
+		std::vector<double> sum(ImageFeatures::VECTOR_SIZE, 0.0), sum2(ImageFeatures::VECTOR_SIZE, 0.0);
+		std::vector< std::vector<double> > centroids(configFiles.size(), std::vector<double>(ImageFeatures::VECTOR_SIZE, 0.0));
+		std::vector<int> counts(configFiles.size(), 0);
+		int total = 0;
+
+		std::vector<double> v;
+		for (size_t i = 0; i < images.size(); i++)
+		{
+			if (!images[i].Valid)
+				continue;
+			images[i].getVector(v);
+
+			for (int u = 0; u < ImageFeatures::VECTOR_SIZE; u++)
+			{
+				sum[u] += v[u];
+				sum2[u] += v[u] * v[u];
+			}
+			total++;
+
+			int c = assignment[i];
+			if (c < 0 || c >= (int)configFiles.size())
+				continue;
+			for (int u = 0; u < ImageFeatures::VECTOR_SIZE; u++)
+				centroids[c][u] += v[u];
+			counts[c]++;
+		}
+
+		if (total > 1)
+		{
+			for (int u = 0; u < ImageFeatures::VECTOR_SIZE; u++)
+			{
+				double mean = sum[u] / total;
+				double deviation = sqrt(std::max(0.0, sum2[u] / total - mean * mean));
+				if (deviation > EPS)
+					_scale[u] = 1.0 / deviation;
+			}
+		}
+
+		for (size_t c = 0; c < configFiles.size(); c++)
+		{
+			if (counts[c] == 0)
+				continue;
+
+			Cluster cluster;
+			cluster.configFile = configFiles[c];
+			cluster.centroid = centroids[c];
+			for (int u = 0; u < ImageFeatures::VECTOR_SIZE; u++)
+				cluster.centroid[u] /= counts[c];
+			_clusters.push_back(cluster);
+		}
+	}
+
+	static void _parseValues(const std::string& text, std::vector<double>& values)
+	{
+		values.clear();
+		const char* p = text.c_str();
+		for (;;)
+		{
+			char* end;
+			double value = strtod(p, &end);
+			if (end == p)
+				break;
+			values.push_back(value);
+			p = end;
+		}
+	}
+
+	bool ClusterModel::loadFromFile(const std::string& filename)
+	{
+		try
+		{
+			FileScanner fi("%s", filename.c_str());
+			std::string data;
+			fi.readAll(data);
+
+			std::vector<Cluster> clusters;
+			std::vector<double> scale;
+
+			size_t pos = 0;
+			while (pos < data.size())
+			{
+				size_t end = data.find('\n', pos);
+				if (end == std::string::npos)
+					end = data.size();
+				std::string line = data.substr(pos, end - pos);
+				pos = end + 1;
+
+				size_t p = line.find('=');
+				if (p == std::string::npos)
+					continue;
+
+				std::string name = line.substr(0, p);
+				std::string value = line.substr(p + 1);
+				name.erase(name.find_last_not_of(" \t") + 1);
+				value.erase(0, value.find_first_not_of(" \t"));
+				value.erase(value.find_last_not_of(" \t\r") + 1);
+
+				if (name == "scale")
+				{
+					_parseValues(value, scale);
+				}
+				else if (name == "cluster")
+				{
+					clusters.push_back(Cluster());
+					clusters.back().configFile = value;
+				}
+				else if (name == "centroid" && !clusters.empty())
+				{
+					_parseValues(value, clusters.back().centroid);
+				}
+			}
+
+			if (scale.size() != ImageFeatures::VECTOR_SIZE)
+				throw ImagoException("Wrong cluster model scale");
+			for (size_t c = 0; c < clusters.size(); c++)
+				if (clusters[c].centroid.size() != ImageFeatures::VECTOR_SIZE)
+					throw ImagoException("Wrong cluster model centroid");
+
+			_clusters = clusters;
+			_scale = scale;
+			return true;
+		}
+		catch (ImagoException&)
+		{
+			return false;
+		}
+	}
+
+	bool ClusterModel::storeToFile(const std::string& filename) const
+	{
+		try
+		{
+			std::string data = "scale =";
+			char buf[MAX_TEXT_LINE];
+			for (size_t u = 0; u < _scale.size(); u++)
+			{
+				sprintf(buf, " %.9g", _scale[u]);
+				data += buf;
+			}
+			data += platform::getLineEndings();
+
+			for (size_t c = 0; c < _clusters.size(); c++)
+			{
+				data += "cluster = " + _clusters[c].configFile + platform::getLineEndings();
+				data += "centroid =";
+				for (size_t u = 0; u < _clusters[c].centroid.size(); u++)
+				{
+					sprintf(buf, " %.9g", _clusters[c].centroid[u]);
+					data += buf;
+				}
+				data += platform::getLineEndings();
+			}
+
+			FileOutput fo("%s", filename.c_str());
+			fo.writeString(data.c_str());
+			return true;
+		}
+		catch (ImagoException&)
+		{
+			return false;
+		}
+	}
+}
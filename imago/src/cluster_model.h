@@ -0,0 +1,59 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+
+#pragma once
+#ifndef _cluster_model_h
+#define _cluster_model_h
+
+#include <string>
+#include <vector>
+#include "image_features.h"
+
+namespace imago
+{
+	// nearest-centroid model selecting the config cluster by the image features,
+	// trained on a collection with reference molfiles by the console (-trainclusters)
+	class ClusterModel
+	{
+	public:
+		// returns index of the nearest cluster or -1 if the model is empty
+		int select(const ImageFeatures& features) const;
+
+		size_t size() const;
+		const std::string& getConfigFile(int cluster) const;
+
+		// assignment[i] is the index of the best config for images[i] or -1;
+		// configs without images are not included into the model
+		void train(const std::vector<std::string>& configFiles, const std::vector<ImageFeatures>& images,
+		           const std::vector<int>& assignment);
+
+		// text storage: "scale = ..." line, then "cluster = file" and "centroid = ..." lines;
+		// returns false on error
+		bool loadFromFile(const std::string& filename);
+		bool storeToFile(const std::string& filename) const;
+
+	private:
+		struct Cluster
+		{
+			std::string configFile;
+			std::vector<double> centroid;
+		};
+
+		std::vector<Cluster> _clusters;
+		std::vector<double> _scale; // features are divided by their deviation over the training images
+	};
+}
+
+#endif // _cluster_model_h
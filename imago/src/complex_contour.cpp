@@ -305,7 +305,7 @@ ComplexContour ComplexContour::RetrieveContour(const Settings& vars, Image& seg,
 	   for (size_t i = 1; i < lines.size() ; i++)
 	   {
 		   if (vars.checkTimeLimit())
-				throw ImagoException("Timelimit exceeded");
+				throw TimeLimitException();
 
 		   imago::Skeleton::Vertex vEnd = graph.addVertex(lines[i]);
 		   try
@@ -370,7 +370,7 @@ ComplexContour ComplexContour::RetrieveContour(const Settings& vars, Image& seg,
 	do
 	{
 		if (vars.checkTimeLimit())
-			throw ImagoException("Timelimit exceeded");
+			throw TimeLimitException();
 
 		double min_angle = 2*PI;
 		
@@ -395,7 +395,7 @@ ComplexContour ComplexContour::RetrieveContour(const Settings& vars, Image& seg,
 			for(vit2 = neighbours2.begin(); vit2 != neighbours2.end(); ++vit2)
 			{
 				if (vars.checkTimeLimit())
-					throw ImagoException("Timelimit exceeded");
+					throw TimeLimitException();
 
 				Skeleton::Vertex v = *(vit2);
 
@@ -153,8 +153,8 @@ DoubleBondMaker::Result DoubleBondMaker::_hard()
    if (fe != se)
       _g.removeVertex(se);
 
-   bool left = l1 > vars.mbond.DoubleLeftLengthTresh * _avgBondLength;
-   bool right = l2 > vars.mbond.DoubleRightLengthTresh * _avgBondLength;
+   bool left = l1 > vars.mbond().DoubleLeftLengthTresh * _avgBondLength;
+   bool right = l2 > vars.mbond().DoubleRightLengthTresh * _avgBondLength;
 
    if (left && right)
    {
@@ -241,12 +241,12 @@ DoubleBondMaker::Result DoubleBondMaker::operator()(const std::pair<Edge, Edge>
           sl = bs.length;
    double mult;
 
-   if (_avgBondLength > vars.mbond.Case1LengthTresh)
-	   mult = vars.mbond.Case1Factor;
-   else if (_avgBondLength > vars.mbond.Case2LengthTresh)
-	   mult = vars.mbond.Case2Factor;
+   if (_avgBondLength > vars.mbond().Case1LengthTresh)
+	   mult = vars.mbond().Case1Factor;
+   else if (_avgBondLength > vars.mbond().Case2LengthTresh)
+	   mult = vars.mbond().Case2Factor;
    else
-	   mult = vars.mbond.Case3Factor;
+	   mult = vars.mbond().Case3Factor;
 
    if (fl - sl < mult * _avgBondLength)
       return _simple();
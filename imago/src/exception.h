@@ -71,6 +71,12 @@ namespace imago
 		FileNotFoundException(const std::string& error) : ImagoException(error) { }
 	};
 
+	class TimeLimitException : public ImagoException
+	{
+	public: 
+		TimeLimitException() : ImagoException("Timelimit exceeded") { }
+	};
+
 	class LogicException : public ImagoException
 	{
 	public: 
@@ -1,7 +1,10 @@
 #include "failsafe_png.h"
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <zlib.h>
 #include "log_ext.h"
 
 int decodePNG(std::vector<unsigned char>& out_image, unsigned long& image_width, unsigned long& image_height, const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true)
@@ -175,7 +178,7 @@ int decodePNG(std::vector<unsigned char>& out_image, unsigned long& image_width,
       {
         if(btype == 1) { generateFixedTrees(codetree, codetreeD); }
         else if(btype == 2) { getTreeInflateDynamic(codetree, codetreeD, in, bp, inlength); if(error) return; }
-        while(!BFINAL)
+        for(;;) //the final block is decoded too, until the end code
         {
           unsigned long code = huffmanDecodeSymbol(in, bp, codetree, inlength); if(error) break; //sic!
           if(code == 256) return; //end code
@@ -481,7 +484,7 @@ int decodePNG(std::vector<unsigned char>& out_image, unsigned long& image_width,
       for(size_t i = 0; i < numpixels; i++)
       {
         out_[4 * i + 0] = out_[4 * i + 1] = out_[4 * i + 2] = in[2 * i];
-        out_[4 * i + 3] = (infoIn.key_defined && 256U * in[i] + in[i + 1] == infoIn.key_r) ? 0 : 255;
+        out_[4 * i + 3] = (infoIn.key_defined && 256U * in[2 * i] + in[2 * i + 1] == infoIn.key_r) ? 0 : 255;
       }
       else if(infoIn.bitDepth == 16 && infoIn.colorType == 2) //RGB color
       for(size_t i = 0; i < numpixels; i++)
@@ -499,9 +502,10 @@ int decodePNG(std::vector<unsigned char>& out_image, unsigned long& image_width,
       else if(infoIn.bitDepth < 8 && infoIn.colorType == 0) //greyscale
       for(size_t i = 0; i < numpixels; i++)
       {
-        unsigned long value = (readBitsFromReversedStream(bp, in, infoIn.bitDepth) * 255) / ((1 << infoIn.bitDepth) - 1); //scale value from 0 to 255
+        unsigned long sample = readBitsFromReversedStream(bp, in, infoIn.bitDepth);
+        unsigned long value = (sample * 255) / ((1 << infoIn.bitDepth) - 1); //scale value from 0 to 255
         out_[4 * i + 0] = out_[4 * i + 1] = out_[4 * i + 2] = (unsigned char)(value);
-        out_[4 * i + 3] = (infoIn.key_defined && value && ((1U << infoIn.bitDepth) - 1U) == infoIn.key_r && ((1U << infoIn.bitDepth) - 1U)) ? 0 : 255;
+        out_[4 * i + 3] = (infoIn.key_defined && sample == infoIn.key_r) ? 0 : 255;
       }
       else if(infoIn.bitDepth < 8 && infoIn.colorType == 3) //palette
       for(size_t i = 0; i < numpixels; i++)
@@ -558,10 +562,351 @@ void loadFile(std::vector<unsigned char>& buffer, const std::string& filename) /
 
 namespace imago
 {
-	bool failsafePngLoadBuffer(const unsigned char* buffer, size_t buf_size, Image& img)
+	struct PngGrayInfo
+	{
+		unsigned long width, height;
+		int bitDepth, colorType, interlace;
+		byte lut[256]; // gray values of the palette indices or of the low bit depth samples
+		bool keyDefined; // tRNS color key of gray or RGB images, the samples equal to it are transparent
+		unsigned keyR, keyG, keyB;
+	};
+
+	static unsigned long _read32(const unsigned char* p)
+	{
+		return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | p[3];
+	}
+
+	static byte _gray(unsigned r, unsigned g, unsigned b)
+	{
+		// the same weights as for the RGBA conversion
+		return (byte)((30 * r + 59 * g + 11 * b) / 100);
+	}
+
+	// 8 or 16 bit sample
+	static unsigned _sample(const unsigned char* p, size_t s)
+	{
+		return (s == 2) ? ((unsigned)p[0] << 8) | p[1] : p[0];
+	}
+
+	static unsigned char _paeth(short a, short b, short c)
+	{
+		short p = a + b - c, pa = p > a ? (p - a) : (a - p), pb = p > b ? (p - b) : (b - p), pc = p > c ? (p - c) : (c - p);
+		return (unsigned char)((pa <= pb && pa <= pc) ? a : pb <= pc ? b : c);
+	}
+
+	// precon is the previous reconstructed line, zeros for the first one
+	static bool _unfilterScanline(unsigned char* recon, const unsigned char* scanline, const unsigned char* precon,
+	                              size_t bytewidth, int filterType, size_t length)
+	{
+		size_t i = 0;
+		switch (filterType)
+		{
+		case 0:
+			memcpy(recon, scanline, length);
+			break;
+		case 1:
+			for (; i < bytewidth && i < length; i++) recon[i] = scanline[i];
+			for (; i < length; i++) recon[i] = scanline[i] + recon[i - bytewidth];
+			break;
+		case 2:
+			for (; i < length; i++) recon[i] = scanline[i] + precon[i];
+			break;
+		case 3:
+			for (; i < bytewidth && i < length; i++) recon[i] = scanline[i] + precon[i] / 2;
+			for (; i < length; i++) recon[i] = scanline[i] + ((recon[i - bytewidth] + precon[i]) / 2);
+			break;
+		case 4:
+			for (; i < bytewidth && i < length; i++) recon[i] = scanline[i] + _paeth(0, precon[i], 0);
+			for (; i < length; i++) recon[i] = scanline[i] + _paeth(recon[i - bytewidth], precon[i], precon[i - bytewidth]);
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+
+	static void _scanlineToGray(const unsigned char* line, const PngGrayInfo& info, byte* out)
+	{
+		unsigned long w = info.width;
+		if (info.bitDepth < 8)
+		{
+			int bd = info.bitDepth, mask = (1 << bd) - 1;
+			for (unsigned long x = 0; x < w; x++)
+			{
+				size_t bit = x * bd;
+				out[x] = info.lut[(line[bit >> 3] >> (8 - bd - (bit & 7))) & mask];
+			}
+			return;
+		}
+
+		size_t s = info.bitDepth / 8; // only the most significant bytes of 16-bit samples are used
+		switch (info.colorType)
+		{
+		case 0:
+			for (unsigned long x = 0; x < w; x++) out[x] = line[x * s];
+			if (info.keyDefined) // transparent pixels are white as in the BGRA conversion
+				for (unsigned long x = 0; x < w; x++)
+					if (_sample(line + x * s, s) == info.keyR)
+						out[x] = 255;
+			break;
+		case 2:
+			for (unsigned long x = 0; x < w; x++) out[x] = _gray(line[3 * s * x], line[3 * s * x + s], line[3 * s * x + 2 * s]);
+			if (info.keyDefined)
+				for (unsigned long x = 0; x < w; x++)
+				{
+					const unsigned char* p = line + 3 * s * x;
+					if (_sample(p, s) == info.keyR && _sample(p + s, s) == info.keyG && _sample(p + 2 * s, s) == info.keyB)
+						out[x] = 255;
+				}
+			break;
+		case 3:
+			for (unsigned long x = 0; x < w; x++) out[x] = info.lut[line[x]];
+			break;
+		case 4: // transparent pixels are white as in the BGRA conversion
+			for (unsigned long x = 0; x < w; x++) out[x] = line[2 * s * x + s] == 0 ? 255 : line[2 * s * x];
+			break;
+		case 6:
+			for (unsigned long x = 0; x < w; x++) out[x] = line[4 * s * x + 3 * s] == 0 ? 255 : _gray(line[4 * s * x], line[4 * s * x + s], line[4 * s * x + 2 * s]);
+			break;
+		}
+	}
+
+	// largest integer factor keeping the longest side not less than maxDimension
+	static int _reductionFactor(unsigned long width, unsigned long height, int maxDimension)
+	{
+		unsigned long side = std::max(width, height);
+		if (maxDimension <= 0 || side <= (unsigned long)maxDimension)
+			return 1;
+		return (int)(side / maxDimension);
+	}
+
+	// writes the source rows given one by one into the image reduced by the factor, each output
+	// pixel is the average of its factor x factor block (edge blocks average the pixels they have);
+	// only one source row and one row of sums are kept besides the output
+	class GrayRowReducer
+	{
+	public:
+		GrayRowReducer(Image& img, unsigned long width, unsigned long height, int factor)
+			: _img(img), _width(width), _factor(factor), _rows(0), _line(factor > 1 ? width : 0), _sums((width + factor - 1) / factor, 0)
+		{
+			img.init((int)_sums.size(), (int)((height + factor - 1) / factor));
+		}
+
+		// buffer for the next source row
+		byte* row()
+		{
+			return (_factor == 1) ? _img.ptr((int)_rows) : &_line[0];
+		}
+
+		void commit()
+		{
+			if (_factor > 1)
+			{
+				for (unsigned long x = 0; x < _width; x++)
+					_sums[x / _factor] += _line[x];
+				if ((_rows + 1) % _factor == 0)
+					_flush(_factor);
+			}
+			_rows++;
+		}
+
+		// crops the image to the rows written, returns the count of the source rows
+		unsigned long finish()
+		{
+			if (_factor > 1 && _rows % _factor != 0)
+				_flush((int)(_rows % _factor));
+
+			int rows = (int)((_rows + _factor - 1) / _factor);
+			if (rows == 0)
+			{
+				_img.clear();
+			}
+			else if (rows < _img.rows)
+			{
+				Image part((int)_sums.size(), rows);
+				for (int y = 0; y < rows; y++)
+					memcpy(part.ptr(y), _img.ptr(y), _sums.size());
+				_img = part;
+			}
+			return _rows;
+		}
+
+	private:
+		void _flush(int rows)
+		{
+			byte* out = _img.ptr((int)(_rows / _factor));
+			for (size_t x = 0; x < _sums.size(); x++)
+			{
+				unsigned long count = std::min((unsigned long)_factor, _width - x * _factor) * rows;
+				out[x] = (byte)((_sums[x] + count / 2) / count);
+				_sums[x] = 0;
+			}
+		}
+
+		Image& _img;
+		unsigned long _width;
+		int _factor;
+		unsigned long _rows;
+		std::vector<byte> _line;
+		std::vector<unsigned long> _sums;
+	};
+
+	// decodes non-interlaced images straight into the grayscale rows: zlib inflates one scanline
+	// at a time, so neither the whole inflated data nor the RGBA copy is kept in memory;
+	// images over maxDimension are reduced row by row while decoding;
+	// returns -1 if the image should be decoded by picoPNG, else the count of the salvaged rows
+	static int _decodePngGrayscale(const unsigned char* in, size_t size, Image& img, int maxDimension)
+	{
+		static const unsigned char SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+		if (size < 33 || memcmp(in, SIGNATURE, 8) != 0 || memcmp(in + 12, "IHDR", 4) != 0)
+			return -1;
+
+		PngGrayInfo info;
+		info.width = _read32(in + 16);
+		info.height = _read32(in + 20);
+		info.bitDepth = in[24];
+		info.colorType = in[25];
+		info.interlace = in[28];
+
+		bool valid = (info.colorType == 0 && (info.bitDepth == 1 || info.bitDepth == 2 || info.bitDepth == 4 || info.bitDepth == 8 || info.bitDepth == 16)) ||
+		             (info.colorType == 3 && (info.bitDepth == 1 || info.bitDepth == 2 || info.bitDepth == 4 || info.bitDepth == 8)) ||
+		             ((info.colorType == 2 || info.colorType == 4 || info.colorType == 6) && (info.bitDepth == 8 || info.bitDepth == 16));
+		if (!valid || info.interlace != 0 || in[26] != 0 || in[27] != 0 || info.width == 0 || info.height == 0)
+			return -1;
+
+		// missing palette entries stay black
+		memset(info.lut, 0, sizeof(info.lut));
+		if (info.colorType == 0 && info.bitDepth < 8)
+			for (int v = 0; v < (1 << info.bitDepth); v++)
+				info.lut[v] = (byte)(v * 255 / ((1 << info.bitDepth) - 1));
+
+		info.keyDefined = false;
+		info.keyR = info.keyG = info.keyB = 0;
+		byte alpha[256]; // of the palette entries
+		memset(alpha, 255, sizeof(alpha));
+
+		// IDAT contents are concatenated, a truncated chunk gives what it has
+		std::vector<unsigned char> idat;
+		size_t pos = 33;
+		while (pos + 8 <= size)
+		{
+			size_t length = _read32(in + pos);
+			const unsigned char* type = in + pos + 4;
+			const unsigned char* data = in + pos + 8;
+			size_t available = std::min(length, size - pos - 8);
+
+			if (memcmp(type, "IDAT", 4) == 0)
+				idat.insert(idat.end(), data, data + available);
+			else if (memcmp(type, "IEND", 4) == 0)
+				break;
+			else if (memcmp(type, "PLTE", 4) == 0)
+				for (size_t u = 0; u + 2 < available && u / 3 < 256; u += 3)
+					info.lut[u / 3] = _gray(data[u], data[u + 1], data[u + 2]);
+			else if (memcmp(type, "tRNS", 4) == 0)
+			{
+				if (info.colorType == 3)
+					memcpy(alpha, data, std::min(available, sizeof(alpha)));
+				else if (info.colorType == 0 && available >= 2)
+				{
+					info.keyDefined = true;
+					info.keyR = _sample(data, 2);
+				}
+				else if (info.colorType == 2 && available >= 6)
+				{
+					info.keyDefined = true;
+					info.keyR = _sample(data, 2);
+					info.keyG = _sample(data + 2, 2);
+					info.keyB = _sample(data + 4, 2);
+				}
+			}
+
+			if (available < length)
+				break;
+			pos += 12 + length;
+		}
+
+		if (idat.empty())
+			return -1;
+
+		// transparent pixels are white as in the BGRA conversion
+		if (info.colorType == 3)
+			for (int v = 0; v < 256; v++)
+				if (alpha[v] == 0)
+					info.lut[v] = 255;
+		if (info.colorType == 0 && info.bitDepth < 8 && info.keyDefined)
+		{
+			if (info.keyR < (1U << info.bitDepth))
+				info.lut[info.keyR] = 255;
+			info.keyDefined = false; // applied to the lut
+		}
+
+		size_t bpp = (info.colorType == 2 ? 3 : info.colorType == 4 ? 2 : info.colorType == 6 ? 4 : 1) * info.bitDepth;
+		size_t bytewidth = (bpp + 7) / 8;
+		size_t linelength = (info.width * bpp + 7) / 8;
+
+		std::vector<unsigned char> scanline(1 + linelength), recon(linelength), precon(linelength, 0);
+
+		z_stream zs;
+		memset(&zs, 0, sizeof(zs));
+		if (inflateInit(&zs) != Z_OK)
+			return -1;
+		zs.next_in = &idat[0];
+		zs.avail_in = (uInt)idat.size();
+
+		GrayRowReducer reducer(img, info.width, info.height, _reductionFactor(info.width, info.height, maxDimension));
+
+		bool ended = false;
+		for (unsigned long rows = 0; rows < info.height; rows++)
+		{
+			zs.next_out = &scanline[0];
+			zs.avail_out = (uInt)scanline.size();
+			while (zs.avail_out > 0 && !ended)
+			{
+				// the data error or the end of truncated input keep the rows inflated before
+				int ret = inflate(&zs, Z_SYNC_FLUSH);
+				if (ret != Z_OK)
+					ended = true;
+			}
+
+			if (zs.avail_out > 0 || !_unfilterScanline(&recon[0], &scanline[1], &precon[0], bytewidth, scanline[0], linelength))
+				break;
+
+			_scanlineToGray(&recon[0], info, reducer.row());
+			reducer.commit();
+			recon.swap(precon);
+		}
+		inflateEnd(&zs);
+
+		return (int)reducer.finish();
+	}
+
+	bool failsafePngLoadBuffer(const unsigned char* buffer, size_t buf_size, Image& img, int maxDimension)
 	{
 		logEnterFunction();
 
+		try
+		{
+			int rows = _decodePngGrayscale(buffer, buf_size, img, maxDimension);
+			if (rows >= 0)
+			{
+				getLogExt().append("Grayscale rows decoded", rows);
+				if (rows == 0)
+				{
+					getLogExt().appendText("No image rows are decoded, exit");
+					return false;
+				}
+				getLogExt().appendText("Image recovery load done");
+				return true;
+			}
+		}
+		catch (std::exception &e)
+		{
+			getLogExt().append("Image load exception", e.what());
+			return false;
+		}
+
+		// interlaced images are decoded by picoPNG through the RGBA buffer
 		std::vector<unsigned char> image;
 
 		unsigned long width, height;
@@ -582,26 +927,29 @@ namespace imago
 			return false;
 		}
 
-		img.init(width, height);
+		GrayRowReducer reducer(img, width, height, _reductionFactor(width, height, maxDimension));
 		for (unsigned int y = 0; y < height; y++)
 		{
+			byte* row = reducer.row();
 			for (unsigned int x = 0; x < width; x++)
 			{
 				size_t idx = 4 * (x + y * width);
 				byte v = 255;
-				if (v < image.size())
+				if (idx + 3 < image.size() && image[idx+3] != 0)
 				{
-					v = (30 * image[idx] + 59 * image[idx+1] + 11 * image[idx+2]) / 100;
+					v = _gray(image[idx], image[idx+1], image[idx+2]);
 				}
-				img.getByte(x,y) = v;
+				row[x] = v;
 			}
+			reducer.commit();
 		}
+		reducer.finish();
 
 		getLogExt().appendText("Image recovery load done");
 		return true;
 	}
 
-	bool failsafePngLoadFile(const std::string& fname, Image& img)
+	bool failsafePngLoadFile(const std::string& fname, Image& img, int maxDimension)
 	{
 		logEnterFunction();
 
@@ -614,6 +962,6 @@ namespace imago
 			return false;
 		}
 
-		return failsafePngLoadBuffer(&buffer[0], buffer.size(), img);
+		return failsafePngLoadBuffer(&buffer[0], buffer.size(), img, maxDimension);
 	}
 }
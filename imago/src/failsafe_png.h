@@ -21,8 +21,10 @@
 
 namespace imago
 {
-	bool failsafePngLoadBuffer(const unsigned char* buffer, size_t buf_size, Image& img);
-	bool failsafePngLoadFile(const std::string& fname, Image& img);
+	// images with the longest side over maxDimension (if > 0) are reduced while decoding
+	// by the largest integer factor keeping that side not less than maxDimension
+	bool failsafePngLoadBuffer(const unsigned char* buffer, size_t buf_size, Image& img, int maxDimension = 0);
+	bool failsafePngLoadFile(const std::string& fname, Image& img, int maxDimension = 0);
 }
 
 #endif // _failsafe_png_h
@@ -11,6 +11,7 @@ namespace imago
 		routine = _f;
 		condition = _c;
 		update_config_string = _config;
+		update_config.parse(_config);
 	}
 
 	FilterEntries::FilterEntries()
@@ -25,7 +26,7 @@ namespace imago
 		push_back(FilterEntryDefinition("prefilter_basic",     4,   prefilter_basic::prefilterBasicFullsize));
 	}
 
-	FilterEntries getFiltersList()
+	const FilterEntries& getFiltersList()
 	{
 		static FilterEntries result;
 		return result;
@@ -20,6 +20,7 @@
 #include <vector>
 #include "image.h"
 #include "settings.h"
+#include "settings_schema.h"
 
 namespace imago
 {
@@ -30,6 +31,7 @@ namespace imago
 
 		std::string name;
 		std::string update_config_string;
+		SettingsDelta update_config; // compiled update_config_string
 		int priority;
 		ConditionFunction condition;
 		FilterFunction routine;
@@ -44,7 +46,7 @@ namespace imago
 		FilterEntries();
 	};
 
-	FilterEntries getFiltersList();
+	const FilterEntries& getFiltersList();
 }
 
 #endif // _filters_list_h
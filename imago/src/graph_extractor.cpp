@@ -22,10 +22,13 @@
 #include "image_draw_utils.h"
 #include "segment.h"
 #include "skeleton.h"
+#include "stage_timer.h"
+#include "pipeline_counters.h"
 
 using namespace imago;
 
-void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const SegmentDeque &segments, Skeleton &graph )
+void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const SegmentDeque &segments, Skeleton &graph,
+                             memory_budget::Reservation &graphMemory )
 {
 	logEnterFunction();
 
@@ -41,6 +44,7 @@ void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const S
          h = s->getY() + s->getHeight();
    }
 
+   memory_budget::Reservation tmpMemory((size_t)(w + 10) * (h + 10));
    tmp.init(w + 10, h + 10);
    tmp.fillWhite();
 
@@ -51,10 +55,11 @@ void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const S
 
    getLogExt().appendImage("Working image", tmp);
 
-   extract(vars, gd, tmp, graph);
+   extract(vars, gd, tmp, graph, graphMemory);
 }
 
-void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const Image &img, Skeleton &graph )
+void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const Image &img, Skeleton &graph,
+                             memory_budget::Reservation &graphMemory )
 {
 	logEnterFunction();
 
@@ -87,13 +92,26 @@ void GraphExtractor::extract(Settings& vars, const GraphicsDetector &gd, const I
 
 		  double dist = Vec2d::distance(p1, p2);
 
-		  if (dist > vars.graph.MinimalDistTresh)
-			 graph.addBond(p1, p2);      
+		  if (dist > vars.graph().MinimalDistTresh)
+		  {
+			 graph.addBond(p1, p2);
+			 graphMemory.resize(graph.estimateBytes());
+		  }
 	   }
 
 	   getLogExt().appendSkeleton(vars, "Source skeleton", (Skeleton::SkeletonGraph)graph);	   
 
-	   graph.modifyGraph(vars);
+	   pipeline_counters::add(pipeline_counters::SKELETON_VERTICES_BEFORE, graph.getVerticesCount());
+	   pipeline_counters::add(pipeline_counters::SKELETON_EDGES_BEFORE, graph.getEdgesCount());
+
+	   {
+		  logStageTime("modifyGraph");
+		  graph.modifyGraph(vars);
+		  graphMemory.resize(graph.estimateBytes());
+	   }
+
+	   pipeline_counters::add(pipeline_counters::SKELETON_VERTICES_AFTER, graph.getVerticesCount());
+	   pipeline_counters::add(pipeline_counters::SKELETON_EDGES_AFTER, graph.getEdgesCount());
 
 	   getLogExt().appendSkeleton(vars, "Modified skeleton", (Skeleton::SkeletonGraph)graph);
    }
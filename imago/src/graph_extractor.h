@@ -18,6 +18,7 @@
 
 #include "stl_fwd.h"
 #include "settings.h"
+#include "memory_budget.h"
 
 namespace imago
 {
@@ -28,11 +29,14 @@ namespace imago
    
    struct GraphExtractor
    {
+      // graphMemory is resized to the graph estimate while the bonds are added
       static void extract( Settings& vars, const GraphicsDetector &gd,
-                           const SegmentDeque &segments, Skeleton &graph );
+                           const SegmentDeque &segments, Skeleton &graph,
+                           memory_budget::Reservation &graphMemory );
 
       static void extract( Settings& vars, const GraphicsDetector &gd,
-                           const Image &img, Skeleton &graph );
+                           const Image &img, Skeleton &graph,
+                           memory_budget::Reservation &graphMemory );
    };
 }
 
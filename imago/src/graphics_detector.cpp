@@ -223,7 +223,7 @@ void GraphicsDetector::extractRingsCenters(const Settings& vars, SegmentDeque &s
 
 	for (SegmentDeque::iterator it = segments.begin(); it != segments.end();)
 	{      
-		if (absolute((*it)->getRatio() - vars.graph.RatioSub) < vars.graph.RatioTresh)
+		if (absolute((*it)->getRatio() - vars.graph().RatioSub) < vars.graph().RatioTresh)
 		{
 			Segment tmp;
 
@@ -334,7 +334,7 @@ void GraphicsDetector::detect(const Settings& vars, const Image &img, Points2d &
    ThinFilter2 tf2(tmp);
    tf2.apply();
      
-   if (vars.csr.StableDecorner)
+   if (vars.csr().StableDecorner)
    {
 	   // less accurate, but more stable
 	   _decorner(tmp);   
@@ -35,6 +35,9 @@ namespace imago
 
 		Image( int width, int height ) : cv::Mat1b(height, width) { }
 
+		// wraps external memory without copying; the memory is not owned and must outlive the image
+		Image( int width, int height, byte *data, size_t stride ) : cv::Mat1b(height, width, data, stride) { }
+
 		Image( const Image &other)
 		{
 			copy(other);
@@ -91,6 +94,11 @@ namespace imago
 
 		inline void copy( const Image &other )
 		{
+			if (this == &other)
+				return;
+			// never write into a buffer shared with the source (e.g. borrowed caller memory)
+			if (datastart != NULL && datastart == other.datastart)
+				release();
 			other.copyTo(*this);
 		}
 
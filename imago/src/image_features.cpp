@@ -0,0 +1,118 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+
+#include "image_features.h"
+
+#include <algorithm>
+#include <cmath>
+#include "image.h"
+
+namespace imago
+{
+	static const int FEATURES_MAX_SAMPLES = 512 * 512;
+	static const int FEATURES_SCAN_LINES = 32;
+	static const int FEATURES_INK_THRESHOLD = 128;
+
+	ImageFeatures::ImageFeatures()
+	{
+		Valid = Binarized = false;
+		Width = Height = 0;
+		InkRatio = LineThickness = 0.0;
+		for (int u = 0; u < HISTOGRAM_BINS; u++)
+			Histogram[u] = 0.0;
+	}
+
+	static void _collectRuns(const byte* pixels, int count, int step, std::vector<int>& runs)
+	{
+		int run = 0;
+		for (int u = 0; u < count; u++)
+		{
+			if (pixels[u * step] < FEATURES_INK_THRESHOLD)
+				run++;
+			else if (run > 0)
+			{
+				runs.push_back(run);
+				run = 0;
+			}
+		}
+		if (run > 0)
+			runs.push_back(run);
+	}
+
+	void ImageFeatures::compute(const Image& img)
+	{
+		*this = ImageFeatures();
+		if (img.empty())
+			return;
+
+		Width = img.cols;
+		Height = img.rows;
+
+		// every 'step'-th pixel of every 'step'-th row
+		int step = 1;
+		while ((long long)(Width / step) * (Height / step) > FEATURES_MAX_SAMPLES)
+			step++;
+
+		long long counts[256] = {0};
+		long long total = 0;
+		for (int y = 0; y < Height; y += step)
+		{
+			const byte* row = img.ptr(y);
+			for (int x = 0; x < Width; x += step)
+				counts[row[x]]++;
+			total += (Width + step - 1) / step;
+		}
+
+		long long ink = 0, extremes = counts[0] + counts[255];
+		for (int v = 0; v < 256; v++)
+		{
+			Histogram[v * HISTOGRAM_BINS / 256] += (double)counts[v] / total;
+			if (v < FEATURES_INK_THRESHOLD)
+				ink += counts[v];
+		}
+		InkRatio = (double)ink / total;
+		Binarized = (extremes == total);
+
+		// runs are measured at the full resolution on the few scan lines
+		std::vector<int> runs;
+		for (int u = 0; u < FEATURES_SCAN_LINES; u++)
+		{
+			int y = (int)((u + 0.5) * Height / FEATURES_SCAN_LINES);
+			int x = (int)((u + 0.5) * Width / FEATURES_SCAN_LINES);
+			_collectRuns(img.ptr(y), Width, 1, runs);
+			_collectRuns(img.ptr(0) + x, Height, (int)(size_t)img.step, runs);
+		}
+		if (!runs.empty())
+		{
+			std::nth_element(runs.begin(), runs.begin() + runs.size() / 2, runs.end());
+			LineThickness = runs[runs.size() / 2];
+		}
+
+		Valid = true;
+	}
+
+	void ImageFeatures::getVector(std::vector<double>& result) const
+	{
+		// sizes are compared in the log scale, so only their ratios matter
+		result.clear();
+		result.push_back(log(1.0 + std::max(Width, Height)));
+		result.push_back(log((1.0 + Width) / (1.0 + Height)));
+		result.push_back(InkRatio);
+		result.push_back(log(1.0 + LineThickness));
+		result.push_back(Binarized ? 1.0 : 0.0);
+		for (int u = 0; u < HISTOGRAM_BINS; u++)
+			result.push_back(Histogram[u]);
+	}
+}
@@ -0,0 +1,49 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+
+#pragma once
+#ifndef _image_features_h
+#define _image_features_h
+
+#include <vector>
+
+namespace imago
+{
+	class Image;
+
+	// cheap global features of the source image used to select the config cluster
+	struct ImageFeatures
+	{
+		enum { HISTOGRAM_BINS = 8, VECTOR_SIZE = 5 + HISTOGRAM_BINS };
+
+		bool   Valid;
+		int    Width;
+		int    Height;
+		double InkRatio;      // part of the dark pixels
+		double LineThickness; // median length of the dark runs along the scan lines
+		bool   Binarized;     // only black and white pixels
+		double Histogram[HISTOGRAM_BINS]; // gray levels, sums to 1
+
+		ImageFeatures();
+
+		// one pass over the pixels, large images are sampled
+		void compute(const Image& img);
+
+		// values in the order of the model vectors
+		void getVector(std::vector<double>& result) const;
+	};
+}
+
+#endif // _image_features_h
@@ -12,11 +12,19 @@
  * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
  ***************************************************************************/
 
+#include <cctype>
 #include <cmath>
 #include <cstdarg>
+#include <cstdio>
+#include <csetjmp>
 #include <algorithm>
 #include <string>
 
+extern "C"
+{
+#include <jpeglib.h>
+}
+
 #include <opencv2/opencv.hpp>
 //#include <opencv/highgui.h>
 
@@ -31,6 +39,7 @@
 #include "log_ext.h"
 #include "failsafe_png.h"
 #include "stat_utils.h"
+#include "stage_timer.h"
 
 namespace imago
 {
@@ -53,7 +62,7 @@ namespace imago
       ImageDrawUtils::putLine(tmp, thetha, r, eps, 255);
       density = tmp.density() / density;
 
-	  if (density < vars.utils.SlashLineDensity)
+	  if (density < vars.utils().SlashLineDensity)
       {
          if (angle != 0)
             *angle = thetha;
@@ -69,7 +78,7 @@ namespace imago
       ImageDrawUtils::putLine(tmp, thetha, r, eps, 255);
       density = tmp.density() / density;
    
-      if (density < vars.utils.SlashLineDensity)
+      if (density < vars.utils().SlashLineDensity)
       {
          if (angle != 0)
             *angle = thetha;
@@ -166,17 +175,131 @@ namespace imago
             img.getByte(i, j) = mat.at<unsigned char>(j, i);*/
    }
 
-   void ImageUtils::loadImageFromBuffer( const std::vector<byte> &buffer, Image &img )
+   static bool _isPngData( const std::vector<byte> &data )
+   {
+      static const byte SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+      return data.size() >= 8 && std::equal(SIGNATURE, SIGNATURE + 8, data.begin());
+   }
+
+   static bool _isJpegData( const std::vector<byte> &data )
+   {
+      return data.size() >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+   }
+
+// jpeg_mem_src appeared in libjpeg 8, libjpeg-turbo has it with any emulated version;
+// older libraries decode JPEG at full size through OpenCV
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+#define IMAGO_JPEG_REDUCED_DECODE
+#endif
+
+#ifdef IMAGO_JPEG_REDUCED_DECODE
+   struct JpegErrorManager
+   {
+      jpeg_error_mgr pub;
+      jmp_buf jump;
+   };
+
+   static void _jpegErrorExit( j_common_ptr cinfo )
+   {
+      longjmp(((JpegErrorManager *)cinfo->err)->jump, 1);
+   }
+
+   static void _jpegOutputMessage( j_common_ptr cinfo )
+   {
+      // corrupt data warnings, the decoder continues
+   }
+
+   // decodes JPEG in grayscale at the smallest of the 1/2, 1/4 and 1/8 DCT scales keeping
+   // the longest side not less than maxDimension; returns false if libjpeg can not decode it
+   static bool _loadJpegReduced( const std::vector<byte> &data, Image &img, int maxDimension )
+   {
+      jpeg_decompress_struct cinfo;
+      JpegErrorManager error;
+      cinfo.err = jpeg_std_error(&error.pub);
+      error.pub.error_exit = _jpegErrorExit;
+      error.pub.output_message = _jpegOutputMessage;
+
+      // no objects with destructors below, longjmp skips them
+      if (setjmp(error.jump))
+      {
+         jpeg_destroy_decompress(&cinfo);
+         return false;
+      }
+
+      jpeg_create_decompress(&cinfo);
+      jpeg_mem_src(&cinfo, (unsigned char *)&data[0], (unsigned long)data.size());
+      jpeg_read_header(&cinfo, TRUE);
+
+      int side = (int)std::max(cinfo.image_width, cinfo.image_height);
+      cinfo.scale_num = 1;
+      cinfo.scale_denom = 1;
+      for (int denom = 8; denom > 1; denom /= 2)
+      {
+         if (side >= denom * maxDimension)
+         {
+            cinfo.scale_denom = denom;
+            break;
+         }
+      }
+      cinfo.out_color_space = JCS_GRAYSCALE;
+
+      jpeg_start_decompress(&cinfo);
+      img.init(cinfo.output_width, cinfo.output_height);
+      while (cinfo.output_scanline < cinfo.output_height)
+      {
+         JSAMPROW row = img.ptr(cinfo.output_scanline);
+         jpeg_read_scanlines(&cinfo, &row, 1);
+      }
+      jpeg_finish_decompress(&cinfo);
+      jpeg_destroy_decompress(&cinfo);
+      return true;
+   }
+#endif
+
+   void ImageUtils::fitMaxDimension( cv::Mat &mat, int maxDimension )
+   {
+      int side = std::max(mat.cols, mat.rows);
+      if (maxDimension <= 0 || side <= maxDimension)
+         return;
+
+      double ratio = (double)maxDimension / side;
+      cv::Size size(std::max(1, (int)(mat.cols * ratio)), std::max(1, (int)(mat.rows * ratio)));
+      cv::resize(mat, mat, size, 0.0, 0.0, cv::INTER_AREA);
+   }
+
+   void ImageUtils::loadImageFromBuffer( const std::vector<byte> &buffer, Image &img, int maxDimension )
    {
-      cv::Mat mat = cv::imdecode(cv::Mat(buffer), 0);
+      if (maxDimension > 0 && _isPngData(buffer))
+      {
+         if (!failsafePngLoadBuffer(&buffer[0], buffer.size(), img, maxDimension))
+            throw ImagoException("Image data is invalid");
+         fitMaxDimension(img, maxDimension);
+         return;
+      }
+
+#ifdef IMAGO_JPEG_REDUCED_DECODE
+      if (maxDimension > 0 && _isJpegData(buffer))
+      {
+         if (_loadJpegReduced(buffer, img, maxDimension))
+         {
+            fitMaxDimension(img, maxDimension);
+            return;
+         }
+         getLogExt().appendText("libjpeg can not decode the image, trying OpenCV"); // CMYK, etc.
+      }
+#endif
+
+      cv::Mat mat = cv::imdecode(cv::Mat(buffer), 0 /*Grayscale*/);
       if (mat.empty())
          throw ImagoException("Image data is invalid");
+      fitMaxDimension(mat, maxDimension);
       copyMatToImage(mat, img);
    }
 
    void ImageUtils::loadImageFromFile( Image &img, const char *format, ... )
    {
 	   logEnterFunction();
+	   logStageTime("load");
 
       char str[MAX_TEXT_LINE];
       va_list args;
@@ -214,30 +337,7 @@ namespace imago
 	  }
 	  else
 	  {
-		  if (mat.type() == CV_8UC4)
-		  {
-			  getLogExt().append("Image type", "CV_8UC4 / BGRA");
-			  for (int row = 0; row < mat.rows; row++)
-				  for (int col = 0; col < mat.cols; col++)
-				  {
-					  cv::Vec4b& v = mat.at<cv::Vec4b>(row, col);
-					  if (v[3] == 0) // transparent
-					  {
-						  v[0] = v[1] = v[2] = 255; // to white
-					  }
-				  }
-			  cv::cvtColor(mat, mat, cv::COLOR_BGRA2GRAY);
-		  }
-		  else if (mat.type() == CV_8UC3)
-		  {
-			  getLogExt().append("Image type", "CV_8UC3 / BGR");
-			  cv::cvtColor(mat, mat, cv::COLOR_BGR2GRAY);
-		  }
-		  else if (mat.type() == CV_8UC1)
-		  {
-			  getLogExt().append("Image type", "CV_8UC1 / GRAY");
-		  }
-		  else
+		  if (!_convertToGrayscale(mat))
 		  {
 			  getLogExt().appendText("Unknown image type, attempt to reload as grayscale");
 			  mat = cv::imread(fname, 0 /*Grayscale*/);
@@ -246,6 +346,88 @@ namespace imago
 	  }
    }
 
+   void ImageUtils::loadImageFromFile( Image &img, const std::string &fname, int maxDimension )
+   {
+      if (maxDimension <= 0)
+      {
+         loadImageFromFile(img, "%s", fname.c_str());
+         return;
+      }
+
+      logEnterFunction();
+      getLogExt().append("Max dimension", maxDimension);
+
+      std::vector<byte> buffer;
+      FILE *f = fopen(fname.c_str(), "rb");
+      if (f == 0)
+         throw FileNotFoundException(fname.c_str());
+      fseek(f, 0, SEEK_END);
+      long size = ftell(f);
+      fseek(f, 0, SEEK_SET);
+      if (size > 0)
+      {
+         buffer.resize(size);
+         buffer.resize(fread(&buffer[0], 1, size, f));
+      }
+      fclose(f);
+
+      if (_isPngData(buffer) || _isJpegData(buffer))
+      {
+         logStageTime("load");
+         loadImageFromBuffer(buffer, img, maxDimension);
+      }
+      else
+      {
+         // other formats are decoded at full size
+         buffer.clear();
+         loadImageFromFile(img, "%s", fname.c_str());
+         fitMaxDimension(img, maxDimension);
+      }
+   }
+
+   bool ImageUtils::_convertToGrayscale( cv::Mat &mat )
+   {
+	  if (mat.type() == CV_8UC4)
+	  {
+		  getLogExt().append("Image type", "CV_8UC4 / BGRA");
+		  for (int row = 0; row < mat.rows; row++)
+			  for (int col = 0; col < mat.cols; col++)
+			  {
+				  cv::Vec4b& v = mat.at<cv::Vec4b>(row, col);
+				  if (v[3] == 0) // transparent
+				  {
+					  v[0] = v[1] = v[2] = 255; // to white
+				  }
+			  }
+		  cv::cvtColor(mat, mat, cv::COLOR_BGRA2GRAY);
+	  }
+	  else if (mat.type() == CV_8UC3)
+	  {
+		  getLogExt().append("Image type", "CV_8UC3 / BGR");
+		  cv::cvtColor(mat, mat, cv::COLOR_BGR2GRAY);
+	  }
+	  else if (mat.type() == CV_8UC1)
+	  {
+		  getLogExt().append("Image type", "CV_8UC1 / GRAY");
+	  }
+	  else
+	  {
+		  return false;
+	  }
+	  return true;
+   }
+
+   bool ImageUtils::isMultiPageFile( const std::string &fname )
+   {
+      std::string ext;
+      size_t dot = fname.rfind('.');
+      if (dot != std::string::npos)
+         ext = fname.substr(dot + 1);
+      for (size_t u = 0; u < ext.size(); u++)
+         ext[u] = tolower(ext[u]);
+      return ext == "tif" || ext == "tiff";
+   }
+
    void ImageUtils::saveImageToFile( const Image &img, const char *format, ... )
    {
       char str[MAX_TEXT_LINE];
@@ -353,16 +535,16 @@ namespace imago
 		  else if (r2 < r1 && r1 > EPS)
 			 gapr = r2 / r1;
 
-		  double c = asChar ? vars.routines.Circle_AsCharFactor : 1.0;
+		  double c = asChar ? vars.routines().Circle_AsCharFactor : 1.0;
 
-		  if (gapr > vars.routines.Circle_GapRadiusMax * c)
+		  if (gapr > vars.routines().Circle_GapRadiusMax * c)
 		  {
 			  getLogExt().append("Radius gap", gapr);
 			 delete[] points;
 			 return false;
 		  }
 
-		  if (gap > vars.routines.Circle_GapAngleMax * c && gap < 2 * PI - vars.routines.Circle_GapAngleMax * c)
+		  if (gap > vars.routines().Circle_GapAngleMax * c && gap < 2 * PI - vars.routines().Circle_GapAngleMax * c)
 		  {
 			  getLogExt().append("C-like gap", gap);
 			 delete[] points;
@@ -372,7 +554,7 @@ namespace imago
 
 	   avg_radius /= npoints;
 
-	   if (avg_radius < vars.routines.Circle_MinRadius)
+	   if (avg_radius < vars.routines().Circle_MinRadius)
 	   {
 		   getLogExt().append("Degenerated circle", avg_radius);
 		  delete[] points;
@@ -397,7 +579,7 @@ namespace imago
 	   getLogExt().append("Ratio", ratio);
 
 	   delete[] points;
-	   if (ratio > vars.routines.Circle_MaxDeviation)
+	   if (ratio > vars.routines().Circle_MaxDeviation)
 		  return false; // not a circle
 	   return true;
 	}
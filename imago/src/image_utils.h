@@ -36,9 +36,17 @@ namespace imago
       static void copyMatToImage( const cv::Mat &mat, Image &img );
 
       static void loadImageFromFile( Image &img, const char *FileName, ... );
+      // images with the longest side over maxDimension (if > 0) are reduced to it; JPEG is decoded
+      // at 1/2, 1/4 or 1/8 scale and PNG is area-averaged row by row, so they are never kept at full size
+      static void loadImageFromFile( Image &img, const std::string &FileName, int maxDimension );
+
+      // true for formats which may contain several pages (TIFF), see TiffDocument
+      static bool isMultiPageFile( const std::string &FileName );
       static void saveImageToFile( const Image &img, const char *FileName, ... );
 
-      static void loadImageFromBuffer( const std::vector<byte> &buffer, Image &img);
+      static void loadImageFromBuffer( const std::vector<byte> &buffer, Image &img, int maxDimension = 0 );
+      // area-resizes the mat so that its longest side is not over maxDimension (if > 0)
+      static void fitMaxDimension( cv::Mat &mat, int maxDimension );
       static void saveImageToBuffer( const Image &img, const std::string &format, std::vector<byte> &buffer );
 
       static void putSegment( Image &img, const Segment &seg, bool careful = true );
@@ -47,6 +55,10 @@ namespace imago
       static bool testSlashLine(const Settings& vars, Segment &img, double *angle, double eps );
       static bool isThinCircle(const Settings& vars, Image &seg, double &radius, bool asChar = false);
 	  static double estimateLineThickness(Image &bwimg, int grid);
+
+   private:
+      // converts BGRA, BGR or grayscale 8-bit mat to grayscale, returns false for other types
+      static bool _convertToGrayscale( cv::Mat &mat );
    };
 }
 
@@ -29,7 +29,7 @@
 
 using namespace imago;
 
-LabelCombiner::LabelCombiner(Settings& vars, SegmentDeque &symbols_layer, SegmentDeque &other_layer, const CharacterRecognizer &cr ) :
+LabelCombiner::LabelCombiner(const Settings& vars, SegmentDeque &symbols_layer, SegmentDeque &other_layer, const CharacterRecognizer &cr ) :
    _symbols_layer(symbols_layer), _cr(cr), _graphic_layer(other_layer)
    
 {
@@ -90,8 +90,8 @@ void LabelCombiner::_locateLabels(const Settings& vars)
    ei = seg_graph.edgeBegin();
    ei_end = seg_graph.edgeEnd();
 
-   double distance_constraint = vars.dynamic.CapitalHeight * vars.lcomb.MaximalDistanceFactor;
-   double distance_constraint_y = vars.dynamic.CapitalHeight * vars.lcomb.MaximalYDistanceFactor;
+   double distance_constraint = vars.dynamic.CapitalHeight * vars.lcomb().MaximalDistanceFactor;
+   double distance_constraint_y = vars.dynamic.CapitalHeight * vars.lcomb().MaximalYDistanceFactor;
 
    for (next = ei; ei != ei_end; ei = next)
    {
@@ -58,7 +58,7 @@ namespace imago
    class LabelCombiner
    {
    public:
-      LabelCombiner(Settings& vars, SegmentDeque &symbols_layer, SegmentDeque &other_layer, const CharacterRecognizer &cr );
+      LabelCombiner(const Settings& vars, SegmentDeque &symbols_layer, SegmentDeque &other_layer, const CharacterRecognizer &cr );
       ~LabelCombiner();
       
 	  void extractLabels( std::deque<Label> &labels );
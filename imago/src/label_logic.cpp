@@ -64,23 +64,23 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 		{
 			double underline = SegmentTools::getPercentageUnderLine(*seg, line_y);
 			getLogExt().append("Percentage under baseline", underline);
-			pr.adjust(1.0 - vars.labels.weightUnderline * (underline - vars.labels.underlinePos), CharacterRecognizer::digits);		
+			pr.adjust(1.0 - vars.labels().weightUnderline * (underline - vars.labels().underlinePos), CharacterRecognizer::digits);		
 		}
 	
 		if (vars.dynamic.CapitalHeight > 0)
 		{
 			double ratio = (double)SegmentTools::getRealHeight(*seg) / (vars.dynamic.CapitalHeight - 1);
 			getLogExt().append("Height ratio", ratio);
-			double base = 1.0 - vars.labels.ratioWeight * 1.0;
-			pr.adjust(base + vars.labels.ratioWeight * ratio , CharacterRecognizer::lower + CharacterRecognizer::digits);	
+			double base = 1.0 - vars.labels().ratioWeight * 1.0;
+			pr.adjust(base + vars.labels().ratioWeight * ratio , CharacterRecognizer::lower + CharacterRecognizer::digits);	
 		
 			// complicated cases: there are some symbols with exactly the same representation in lower and upper cases
-			if (ratio > vars.labels.ratioCapital)
+			if (ratio > vars.labels().ratioCapital)
 			{				
 				std::string lower_em = lower(exact_as_lower);
 				if (lower_em.find(pr.getBest()) != std::string::npos)
 				{
-					pr.adjust(vars.labels.capitalAdjustFactor, exact_as_lower);
+					pr.adjust(vars.labels().capitalAdjustFactor, exact_as_lower);
 				}
 			}
 		}
@@ -95,16 +95,16 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 			if (idx >= 0 && idx < 26)
 			{
 				if (_cur_atom->getLabelFirst() == 'C')
-					pr.adjust(vars.labels.adjustInc, "l");
+					pr.adjust(vars.labels().adjustInc, "l");
 				// decrease probability of unallowed characters
 				// TODO: not implemented
-				//pr.adjust(vars.labels.adjustDec, substract(CharacterRecognizer::lower, comb[idx]));		
+				//pr.adjust(vars.labels().adjustDec, substract(CharacterRecognizer::lower, comb[idx]));		
 			}
 		} 
 		else if (_cur_atom->getLabelFirst() == 0)
 		{
 			// should be a capital letter, increase probability of allowed characters			
-			pr.adjust(vars.labels.adjustInc, substract(CharacterRecognizer::upper, can_not_be_capital));
+			pr.adjust(vars.labels().adjustInc, substract(CharacterRecognizer::upper, can_not_be_capital));
 		}
 	}
 
@@ -112,7 +112,7 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 
 	retry:
 
-	if (attempts_count++ > vars.labels.adjustAttemptsCount)
+	if (attempts_count++ > vars.labels().adjustAttemptsCount)
 	{
 		getLogExt().append("Probably unrecognizable. Attempts count reached", attempts_count);
 		return;
@@ -140,13 +140,13 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 		if (_cur_atom->getLabelSecond() != 0)
 		{
 			getLogExt().appendText("Small letter comes after another small, fixup & retry");
-			pr.adjust(vars.labels.adjustDec, CharacterRecognizer::lower);
+			pr.adjust(vars.labels().adjustDec, CharacterRecognizer::lower);
 			goto retry;
 		}
 		else if (_cur_atom->getLabelFirst() == 0)
 		{
 			getLogExt().appendText("Small specified for non-set captial, fixup & retry");
-			pr.adjust(vars.labels.adjustDec, CharacterRecognizer::lower);
+			pr.adjust(vars.labels().adjustDec, CharacterRecognizer::lower);
 			goto retry;
 		}
 		else
@@ -160,13 +160,13 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 		if (_cur_atom->count != 0)
 		{
 			getLogExt().appendText("Count specified twice, fixup & retry");
-			pr.adjust(vars.labels.adjustDec, CharacterRecognizer::digits);
+			pr.adjust(vars.labels().adjustDec, CharacterRecognizer::digits);
 			goto retry;
 		}
 		else if (_cur_atom->getLabelFirst() == 0)
 		{
 			getLogExt().appendText("Count specified for non-set atom, fixup & retry");
-			pr.adjust(vars.labels.adjustDec, CharacterRecognizer::digits);
+			pr.adjust(vars.labels().adjustDec, CharacterRecognizer::digits);
 			goto retry;
 		}
 		else
@@ -199,7 +199,7 @@ void LabelLogic::process_ext(const Settings& vars, Segment *seg, int line_y )
 	else 
 	{
 		getLogExt().append("Current char not in supported set, increase probability of supported ones", ch);
-		pr.adjust(vars.labels.adjustInc, CharacterRecognizer::all);
+		pr.adjust(vars.labels().adjustInc, CharacterRecognizer::all);
 		goto retry;
 	}
 }
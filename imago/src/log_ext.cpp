@@ -101,6 +101,8 @@ namespace imago
 			}
 		}
 
+		flushImages();
+
 		if (UseVirtualFS)
 		{
 			// do nothing
@@ -121,6 +123,21 @@ namespace imago
 		enabled = value;
 	}
 
+	void log_ext::flushImages()
+	{
+		std::vector<std::string> failures = ImageWriter.flush();
+		if (UseVirtualFS && pVFS != NULL)
+			ImageWriter.collectEncoded(*pVFS);
+
+		for (size_t u = 0; u < failures.size(); u++)
+			dump(getStringPrefix() + "<b>Image is not written: " + filterHtml(failures[u]) + "</b>");
+	}
+
+	void log_ext::setImageQueueLimit(size_t maxQueued, bool dropWhenFull)
+	{
+		ImageWriter.setQueueLimit(maxQueued, dropWhenFull);
+	}
+
 	void log_ext::appendText(const std::string& text)
 	{
 		if(!loggingEnabled()) return;
@@ -148,14 +165,15 @@ namespace imago
 		dump(getStringPrefix() + table);
 	}
 
-	void log_ext::appendImageInternal(const std::string& caption, const Image& img)
+	void log_ext::appendImageInternal(const std::string& caption, const Image& img, bool temporary)
 	{		
 		std::string htmlName;
 		std::string imageName = generateImageName(&htmlName);
 		
-		dumpImage(imageName, img);
-
-		appendImageFile(caption, htmlName);		
+		if (dumpImage(imageName, img, temporary))
+			appendImageFile(caption, htmlName);
+		else
+			dump(getStringPrefix() + "<i>" + filterHtml(caption) + "</i>: image dropped (log queue is full)");
 	}
    
 	void log_ext::appendGraph(const Settings& vars, const std::string& name, const segments_graph::SegmentsGraph& g)
@@ -166,7 +184,7 @@ namespace imago
 		Image output(vars.general.ImageWidth, vars.general.ImageHeight);
 		output.fillWhite();
 		ImageDrawUtils::putGraph(output, g);
-		appendImageInternal(name, output);
+		appendImageInternal(name, output, true);
 		LOG_TIME_END;
 	}
 
@@ -177,7 +195,7 @@ namespace imago
 		LOG_TIME_START;
 		Image output;
 		ImageUtils::copyMatToImage(mat, output);
-		appendImageInternal(caption, output);
+		appendImageInternal(caption, output, true);
 		LOG_TIME_END;
 	}
    
@@ -189,7 +207,7 @@ namespace imago
 		Image output(vars.general.ImageWidth, vars.general.ImageHeight);
 		output.fillWhite();
 		ImageDrawUtils::putGraph(output, g);
-		appendImageInternal(name, output);
+		appendImageInternal(name, output, true);
 		LOG_TIME_END;
 	}
    
@@ -205,7 +223,7 @@ namespace imago
       
 		Image output(shifted.getWidth(), shifted.getHeight());
 		ImageUtils::putSegment(output, shifted, false);
-		appendImageInternal(name, output);
+		appendImageInternal(name, output, true);
 		LOG_TIME_END;
 	}	  
 
@@ -219,7 +237,7 @@ namespace imago
 		output.fillWhite();
 		for (size_t u = 0; u < pts.size(); u++)
 			output.getByte(pts[u].x - b.getBounding().x, pts[u].y - b.getBounding().y) = 0;
-		appendImageInternal(name, output);
+		appendImageInternal(name, output, true);
 		LOG_TIME_END;
 	}
 
@@ -233,7 +251,7 @@ namespace imago
 		ImageUtils::putSegment(output, seg, false);
 		ImageDrawUtils::putLineSegment(output, Vec2i(0, line_y), Vec2i(output.getWidth(), line_y), 64);
 
-		appendImageInternal(name, output);
+		appendImageInternal(name, output, true);
 		LOG_TIME_END;
 	}
 
@@ -314,23 +332,20 @@ namespace imago
 		return paragraph ? "<p>" : "<br>";
 	}
 
-	void log_ext::dumpImage(const std::string& filename, const Image& data)
+	bool log_ext::dumpImage(const std::string& filename, const Image& data, bool temporary)
 	{
+		if (UseVirtualFS && pVFS == NULL)
+			return true;
+
+		// PNG encoding is the most expensive part of logging, it is done by the writer thread
+		cv::Mat1b pixels = temporary ? cv::Mat1b(data) : cv::Mat1b(data.clone());
+		bool queued = ImageWriter.enqueue(filename, pixels, UseVirtualFS);
+
+		// VirtualFS is not thread-safe, the encoded images are moved into it here
 		if (UseVirtualFS)
-		{
-			if (pVFS)
-			{
-            std::vector<byte> bin_data;
-            std::string buf;
-            ImageUtils::saveImageToBuffer(data, ".png", bin_data);
-            buf.assign(bin_data.begin(), bin_data.end());
-            pVFS->createNewFile(filename, buf);
-			}
-		}
-		else
-		{
-			ImageUtils::saveImageToFile(data, filename.c_str());
-		}
+			ImageWriter.collectEncoded(*pVFS);
+
+		return queued;
 	}
 
 	void log_ext::dump(const std::string& data)
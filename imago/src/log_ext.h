@@ -28,7 +28,9 @@
 #include "image_utils.h"
 #include "image_draw_utils.h"
 #include "virtual_fs.h"
+#include "log_image_writer.h"
 #include "settings.h"
+#include "trace_sink.h"
 
 #define logEnterFunction imago::log_ext_service::LogEnterFunction _entry(__FUNCTION__, imago::getLogExt()); _entry._logEnterFunction
 
@@ -70,12 +72,14 @@ namespace imago
 
 		void SetVirtualFS(VirtualFS& vfs)
 		{
+			flushImages();
 			pVFS = &vfs;
 			UseVirtualFS = true;
 		}
 
       void SetNoVirtualFS()
       {
+         flushImages();
          pVFS = NULL;
          UseVirtualFS = false;
       }
@@ -83,6 +87,13 @@ namespace imago
 		bool loggingEnabled() const;
 		void setLoggingEnabled(bool value);
 
+		// images are encoded in background, so wait for them before reading the log files
+		void flushImages();
+
+		// by default the logging thread waits when maxQueued images are pending,
+		// with dropWhenFull such images are skipped instead
+		void setImageQueueLimit(size_t maxQueued, bool dropWhenFull);
+
 		template <class t> void append(const std::string& name, const t& value)
 		{
 			if(!loggingEnabled()) return;
@@ -141,13 +152,15 @@ namespace imago
 		size_t ImgIdent, CallIdent;
 		std::vector<FunctionRecord> Stack;
 		std::map<std::string, ProfilingInformation> Profile;
+		LogImageWriter ImageWriter;
 
-		void appendImageInternal(const std::string& caption, const Image& img);   
+		// 'temporary' images are not used after the call, their pixels are not copied
+		void appendImageInternal(const std::string& caption, const Image& img, bool temporary = false);   
 		std::string generateAnchor(const std::string& name);		
 		std::string getStringPrefix(bool paragraph = false) const;
 		std::string filterHtml(const std::string source) const;
 		void dump(const std::string& data);
-		void dumpImage(const std::string& filename, const Image& data);
+		bool dumpImage(const std::string& filename, const Image& data, bool temporary);
 
 		template <class t1, class t2> std::string constructTable(const std::string& caption, 
 			                                                     const std::vector<t1>& row1, 
@@ -198,19 +211,27 @@ namespace imago
 		class LogEnterFunction
 		{
 		public:
-			LogEnterFunction(const std::string& name, log_ext& log) : Log(log)
+			// 'name' is stored for the trace sink without copying, so it should be a literal
+			LogEnterFunction(const char* name, log_ext& log) : Log(log), Name(name), Trace(trace_sink::current())
 			{
+				if (Trace != NULL)
+					TraceStart = trace_sink::now();
 				Log.enterFunction(name);
 			}
 			~LogEnterFunction()
 			{
 				Log.leaveFunction();
+				if (Trace != NULL)
+					Trace->addScope(Name, TraceStart, trace_sink::now());
 			}
 			void _logEnterFunction() // fake stub method for macros calling decoration
 			{
 			}
 		private:
 			log_ext& Log;
+			const char* Name;
+			trace_sink::Recorder* Trace;
+			unsigned long long TraceStart;
 		};
 	}
 	
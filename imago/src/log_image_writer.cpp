@@ -0,0 +1,155 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "log_image_writer.h"
+
+namespace imago
+{
+	LogImageWriter::LogImageWriter()
+	{
+		_maxQueued = 64;
+		_dropWhenFull = false;
+		_busy = _stop = false;
+		_dropped = 0;
+	}
+
+	LogImageWriter::~LogImageWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		if (_thread.joinable())
+			_thread.join();
+	}
+
+	void LogImageWriter::setQueueLimit(size_t maxQueued, bool dropWhenFull)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_maxQueued = (maxQueued > 0) ? maxQueued : 1;
+		_dropWhenFull = dropWhenFull;
+	}
+
+	bool LogImageWriter::enqueue(const std::string& filename, const cv::Mat1b& pixels, bool inMemory)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		// started on the first image, so the writer costs nothing while the log is off
+		if (!_thread.joinable())
+			_thread = std::thread(&LogImageWriter::_run, this);
+
+		if (_queue.size() >= _maxQueued)
+		{
+			if (_dropWhenFull)
+			{
+				_dropped++;
+				return false;
+			}
+			_done.wait(lock, [this]() { return _queue.size() < _maxQueued; });
+		}
+
+		Task task;
+		task.filename = filename;
+		task.pixels = pixels;
+		task.inMemory = inMemory;
+		_queue.push_back(task);
+
+		lock.unlock();
+		_wake.notify_one();
+		return true;
+	}
+
+	void LogImageWriter::collectEncoded(VirtualFS& output)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (size_t u = 0; u < _encoded.size(); u++)
+		{
+			const Encoded& image = _encoded[u];
+			output.createNewFile(image.filename, image.data.empty() ? NULL : &image.data[0], image.data.size());
+		}
+		_encoded.clear();
+	}
+
+	std::vector<std::string> LogImageWriter::flush()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [this]() { return _queue.empty() && !_busy; });
+
+		std::vector<std::string> failures;
+		failures.swap(_failures);
+		return failures;
+	}
+
+	size_t LogImageWriter::droppedCount() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _dropped;
+	}
+
+	void LogImageWriter::_run()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		for (;;)
+		{
+			_wake.wait(lock, [this]() { return _stop || !_queue.empty(); });
+			if (_queue.empty())
+				break; // stopped and nothing left
+
+			Task task = _queue.front();
+			_queue.pop_front();
+			_busy = true;
+			lock.unlock();
+			_done.notify_all(); // there is space in the queue
+
+			// the thread must survive a failed image, the failure is reported by flush()
+			Encoded rec;
+			std::string error;
+			try
+			{
+				bool written;
+				if (task.inMemory)
+				{
+					rec.filename = task.filename;
+					written = cv::imencode(".png", task.pixels, rec.data);
+				}
+				else
+				{
+					written = cv::imwrite(task.filename, task.pixels);
+				}
+				if (!written)
+					error = "encoder failed";
+			}
+			catch (std::exception& e)
+			{
+				error = e.what();
+			}
+			task.pixels.release();
+
+			lock.lock();
+			if (!error.empty())
+			{
+				_failures.push_back(task.filename + ": " + error);
+			}
+			else if (task.inMemory)
+			{
+				_encoded.push_back(Encoded());
+				_encoded.back().filename.swap(rec.filename);
+				_encoded.back().data.swap(rec.data);
+			}
+			_busy = false;
+			_done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,88 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _log_image_writer_h
+#define _log_image_writer_h
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "virtual_fs.h"
+
+namespace imago
+{
+	// encodes the debug log images to PNG on a background thread;
+	// files are written to disk by the thread, the in-memory ones are returned
+	// through collectEncoded() since VirtualFS is owned by the logging thread
+	class LogImageWriter
+	{
+	public:
+		LogImageWriter();
+		~LogImageWriter();
+
+		// maxQueued images may wait for encoding; when the queue is full the caller
+		// is blocked until there is space, or the image is dropped if dropWhenFull is set
+		void setQueueLimit(size_t maxQueued, bool dropWhenFull);
+
+		// takes a reference to the pixels, the caller should not modify them afterwards;
+		// returns false if the image was dropped
+		bool enqueue(const std::string& filename, const cv::Mat1b& pixels, bool inMemory);
+
+		// moves the in-memory images encoded so far to 'output'
+		void collectEncoded(VirtualFS& output);
+
+		// waits until all the queued images are encoded, returns the images failed
+		// since the previous call as "filename: reason"
+		std::vector<std::string> flush();
+
+		size_t droppedCount() const;
+
+	private:
+		struct Task
+		{
+			std::string filename;
+			cv::Mat1b pixels;
+			bool inMemory;
+		};
+
+		struct Encoded
+		{
+			std::string filename;
+			std::vector<unsigned char> data;
+		};
+
+		void _run();
+
+		std::deque<Task> _queue;
+		std::vector<Encoded> _encoded;
+		std::vector<std::string> _failures;
+		size_t _maxQueued;
+		bool _dropWhenFull;
+		bool _busy, _stop;
+		size_t _dropped;
+		std::thread _thread;
+		mutable std::mutex _mutex;
+		std::condition_variable _wake, _done;
+
+		LogImageWriter(const LogImageWriter&);
+		LogImageWriter& operator=(const LogImageWriter&);
+	};
+}
+
+#endif // _log_image_writer_h
@@ -0,0 +1,175 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "memory_budget.h"
+
+#include <cstdio>
+#include "exception.h"
+#include "pipeline_counters.h"
+
+namespace imago
+{
+	namespace memory_budget
+	{
+		static std::atomic<size_t> _defaultLimit(0);
+#if (_MSC_VER >= 1800)
+		static __declspec(thread) Account* _current = NULL;
+#else
+		static thread_local Account* _current = NULL;
+#endif
+
+		Account::Account() : _current(0), _peak(0), _limit(_defaultLimit.load())
+		{
+		}
+
+		void Account::charge(size_t bytes)
+		{
+			size_t now = _current.fetch_add(bytes) + bytes;
+
+			size_t limit = _limit.load();
+			if (limit > 0 && now > limit)
+			{
+				_current.fetch_sub(bytes);
+				pipeline_counters::add(pipeline_counters::MEMORY_BUDGET_ABORTS);
+
+				char buf[128];
+				sprintf(buf, "Memory budget exceeded (%lu Kb required, %lu Kb allowed)",
+				        (unsigned long)(now >> 10), (unsigned long)(limit >> 10));
+				throw ImagoException(buf);
+			}
+
+			size_t peak = _peak.load();
+			while (now > peak && !_peak.compare_exchange_weak(peak, now))
+			{
+				// peak is reloaded by the failed exchange
+			}
+		}
+
+		void Account::release(size_t bytes)
+		{
+			_current.fetch_sub(bytes);
+		}
+
+		void Account::setLimit(size_t bytes)
+		{
+			_limit = bytes;
+		}
+
+		size_t Account::getLimit() const
+		{
+			return _limit.load();
+		}
+
+		size_t Account::getCurrent() const
+		{
+			return _current.load();
+		}
+
+		size_t Account::getPeak() const
+		{
+			return _peak.load();
+		}
+
+		void Account::resetPeak()
+		{
+			_peak = _current.load();
+		}
+
+		void Account::writeText(std::string& out) const
+		{
+			char buf[128];
+			sprintf(buf, "memory_current=%llu\nmemory_peak=%llu\nmemory_limit=%llu\n",
+			        (unsigned long long)getCurrent(), (unsigned long long)getPeak(), (unsigned long long)getLimit());
+			out += buf;
+		}
+
+		void setDefaultLimit(size_t bytes)
+		{
+			_defaultLimit = bytes;
+		}
+
+		size_t getDefaultLimit()
+		{
+			return _defaultLimit.load();
+		}
+
+		static Account* _createProcessAccount()
+		{
+			Account* account = new Account();
+			account->setLimit(0); // whatever the default limit is
+			return account;
+		}
+
+		Account& getProcessAccount()
+		{
+			static Account* account = _createProcessAccount();
+			return *account;
+		}
+
+		Account* current()
+		{
+			return _current;
+		}
+
+		ScopedAccount::ScopedAccount(Account* account)
+		{
+			_previous = _current;
+			_current = account;
+		}
+
+		ScopedAccount::~ScopedAccount()
+		{
+			_current = _previous;
+		}
+
+		Reservation::Reservation(size_t bytes)
+		{
+			// released from the same account even if the thread attachment changes meanwhile
+			_account = _current;
+			_bytes = 0;
+			resize(bytes);
+		}
+
+		Reservation::Reservation(Account* account, size_t bytes)
+		{
+			_account = account;
+			_bytes = 0;
+			resize(bytes);
+		}
+
+		Reservation::~Reservation()
+		{
+			resize(0);
+		}
+
+		void Reservation::resize(size_t bytes)
+		{
+			if (bytes > _bytes)
+			{
+				size_t delta = bytes - _bytes;
+				if (_account != NULL)
+					_account->charge(delta); // throws over the budget
+				getProcessAccount().charge(delta);
+			}
+			else if (bytes < _bytes)
+			{
+				size_t delta = _bytes - bytes;
+				if (_account != NULL)
+					_account->release(delta);
+				getProcessAccount().release(delta);
+			}
+			_bytes = bytes;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _memory_budget_h
+#define _memory_budget_h
+
+#include <atomic>
+#include <string>
+
+namespace imago
+{
+	namespace memory_budget
+	{
+		// current and peak bytes of the large buffers (images, segments, graph, retinex planes)
+		// of one session; charging over the limit throws ImagoException
+		class Account
+		{
+		public:
+			// the limit is getDefaultLimit()
+			Account();
+
+			void charge(size_t bytes);
+			void release(size_t bytes);
+
+			// 0 means unlimited
+			void setLimit(size_t bytes);
+			size_t getLimit() const;
+
+			size_t getCurrent() const;
+			size_t getPeak() const;
+
+			// peak := current
+			void resetPeak();
+
+			// "memory_current", "memory_peak" and "memory_limit" lines
+			void writeText(std::string& out) const;
+
+		private:
+			std::atomic<size_t> _current, _peak, _limit;
+
+			Account(const Account&);
+			Account& operator=(const Account&);
+		};
+
+		// limit of the accounts created from now on, 0 (default) means unlimited
+		void setDefaultLimit(size_t bytes);
+		size_t getDefaultLimit();
+
+		// all the charges of the process, never limited
+		Account& getProcessAccount();
+
+		// session account attached to the calling thread or NULL
+		Account* current();
+
+		// attaches the session account (may be NULL) to the calling thread until the scope ends
+		class ScopedAccount
+		{
+		public:
+			ScopedAccount(Account* account);
+			~ScopedAccount();
+		private:
+			Account* _previous;
+		};
+
+		// charges the process account and the session account of the calling thread
+		// on construction and releases the bytes on destruction
+		class Reservation
+		{
+		public:
+			explicit Reservation(size_t bytes = 0);
+			// charges the given session account (may be NULL, e.g. for the caches
+			// shared by the sessions) instead of the attached one
+			Reservation(Account* account, size_t bytes);
+			~Reservation();
+
+			// charges or releases the difference
+			void resize(size_t bytes);
+			size_t getBytes() const { return _bytes; }
+
+		private:
+			Account* _account;
+			size_t _bytes;
+
+			Reservation(const Reservation&);
+			Reservation& operator=(const Reservation&);
+		};
+	}
+}
+
+#endif // _memory_budget_h
@@ -109,12 +109,12 @@ void Molecule::mapLabels(const Settings& vars, std::deque<Label> &unmapped_label
 {
    double space, space2;
    double bl = bondLength();
-   if (bl > vars.molecule.LengthValue_long)
-	   space = vars.molecule.LengthFactor_long;
-   else if (bl > vars.molecule.LengthValue_medium)
-	   space = vars.molecule.LengthFactor_medium; 
+   if (bl > vars.molecule().LengthValue_long)
+	   space = vars.molecule().LengthFactor_long;
+   else if (bl > vars.molecule().LengthValue_medium)
+	   space = vars.molecule().LengthFactor_medium; 
    else
-	   space = vars.molecule.LengthFactor_default; 
+	   space = vars.molecule().LengthFactor_default; 
 
 //   printf("****: %lf %lf\n", bl, space);
 
@@ -131,14 +131,14 @@ void Molecule::mapLabels(const Settings& vars, std::deque<Label> &unmapped_label
 
 
       nearest.clear();
-	  space = l.MaxSymbolWidth() * vars.molecule.SpaceMultiply;
+	  space = l.MaxSymbolWidth() * vars.molecule().SpaceMultiply;
 	  space2 = l.rect.width < l.rect.height ? l.rect.width : l.rect.height;
 	   
       for (SkeletonGraph::edge_iterator begin = _g.edgeBegin(), end = _g.edgeEnd(); begin != end; ++begin)
       {
          SkeletonGraph::edge_descriptor e = *begin;
          if (vars.checkTimeLimit())
-			  throw ImagoException("Timelimit exceeded");
+			  throw TimeLimitException();
 
          double d1, d2;
          d1 = d2 = DIST_INF;
@@ -232,7 +232,7 @@ void Molecule::mapLabels(const Settings& vars, std::deque<Label> &unmapped_label
          for (int k = j + 1; k < s; k++)
          {
 			   if (vars.checkTimeLimit())
-			      throw ImagoException("Timelimit exceeded");
+			      throw TimeLimitException();
             Skeleton::Vertex a, b;
             Skeleton::Vertex c, d;
             a = nearest[j];
@@ -252,8 +252,8 @@ void Molecule::mapLabels(const Settings& vars, std::deque<Label> &unmapped_label
             Vec2d m;
 
             double ang = Vec2d::angle(n1, n2);
-            if (fabs(ang) < vars.molecule.AngleTreshold ||
-                fabs(ang - PI) < vars.molecule.AngleTreshold )
+            if (fabs(ang) < vars.molecule().AngleTreshold ||
+                fabs(ang - PI) < vars.molecule().AngleTreshold )
             {
                m.middle(v_a, v_b);
             }
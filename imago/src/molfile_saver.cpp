@@ -12,9 +12,13 @@
  * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
  ***************************************************************************/
 
+#include <cctype>
 #include <cstdio>
 #include <ctime>
+#include <algorithm>
 #include <map>
+#include <string>
+#include <vector>
 
 #include "label_combiner.h"
 #include "molecule.h"
@@ -22,6 +26,7 @@
 #include "output.h"
 #include "skeleton.h"
 #include "superatom.h"
+#include "structure_export.h"
 #include "settings.h"
 #include "log_ext.h"
 
@@ -40,10 +45,25 @@ void MolfileSaver::saveMolecule(const Settings& vars, const Molecule &mol )
    _mol = &mol;
 
    _writeHeader();
+   _writeV3000Counts();
    _writeCtab(vars);
    _out.writeStringCR("M  END");
 }
 
+void MolfileSaver::saveStructure( const ExportedStructure &structure )
+{
+   _writeHeader();
+   // V2000 unless the counts do not fit, as Indigo saves in the auto mode
+   if (structure.atoms.size() <= 999 && structure.bonds.size() <= 999)
+      _writeStructureV2000(structure);
+   else
+   {
+      _writeV3000Counts();
+      _writeStructureCtab(structure);
+   }
+   _out.writeStringCR("M  END");
+}
+
 void MolfileSaver::_writeHeader()
 {
    time_t tm = time(NULL);
@@ -53,6 +73,10 @@ void MolfileSaver::_writeHeader()
    _out.printf("  -IMAGO- %02d%02d%02d%02d%02d2D\n", lt->tm_mon + 1, lt->tm_mday,
       lt->tm_year % 100, lt->tm_hour, lt->tm_min);
    _out.writeCR();
+}
+
+void MolfileSaver::_writeV3000Counts()
+{
    _out.printf("%3d%3d%3d%3d%3d%3d%3d%3d%3d%3d%3d V3000\n", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
 }
 
@@ -221,3 +245,106 @@ void MolfileSaver::_writeCtab(const Settings& vars)
    _out.writeStringCR("M  V30 END BOND");
    _out.writeStringCR("M  V30 END CTAB");
 }
+
+void MolfileSaver::_writeStructureCtab(const ExportedStructure &structure)
+{
+   logEnterFunction();
+
+   _out.writeStringCR("M  V30 BEGIN CTAB");
+   _out.printf("M  V30 COUNTS %d %d 0 0 0\n", (int)structure.atoms.size(), (int)structure.bonds.size());
+   _out.writeStringCR("M  V30 BEGIN ATOM");
+
+   for (size_t i = 0; i < structure.atoms.size(); i++)
+   {
+      const ExportedAtom &atom = structure.atoms[i];
+      bool rgroup = atom.label[0] == 'R' && (atom.label.size() == 1 || isdigit(atom.label[1]));
+
+      _out.printf("M  V30 %d %s", (int)i + 1, atom.label.c_str());
+      if (rgroup && atom.label.size() == 1)
+         _out.printf("#");
+      _out.printf(" %lf %lf 0 0", atom.x, atom.y);
+
+      if (atom.charge != 0 && !rgroup)
+         _out.printf(" CHG=%d", atom.charge);
+      if (atom.isotope > 0)
+         _out.printf(" MASS=%d", atom.isotope);
+      _out.writeCR();
+   }
+
+   _out.writeStringCR("M  V30 END ATOM");
+   _out.writeStringCR("M  V30 BEGIN BOND");
+
+   for (size_t j = 0; j < structure.bonds.size(); j++)
+   {
+      const ExportedBond &bond = structure.bonds[j];
+      _out.printf("M  V30 %d %d %d %d", (int)j + 1, bond.order, bond.begin + 1, bond.end + 1);
+      if (bond.stereo != 0)
+         _out.printf(" CFG=%d", bond.stereo);
+      _out.printf("\n");
+   }
+
+   _out.writeStringCR("M  V30 END BOND");
+   _out.writeStringCR("M  V30 END CTAB");
+}
+
+// writes the property lines like "M  CHG", at most 8 atoms per line
+static void _writePropertyLines( Output &out, const char *name, const std::vector<std::pair<int, int> > &values )
+{
+   for (size_t i = 0; i < values.size(); i += 8)
+   {
+      size_t n = std::min<size_t>(8, values.size() - i);
+      out.printf("M  %s%3d", name, (int)n);
+      for (size_t k = i; k < i + n; k++)
+         out.printf(" %3d %3d", values[k].first, values[k].second);
+      out.writeCR();
+   }
+}
+
+void MolfileSaver::_writeStructureV2000(const ExportedStructure &structure)
+{
+   logEnterFunction();
+
+   _out.printf("%3d%3d  0  0  0  0  0  0  0  0999 V2000\n", (int)structure.atoms.size(), (int)structure.bonds.size());
+
+   std::vector<std::pair<int, int> > charges, isotopes;
+   std::vector<int> aliases;
+
+   for (size_t i = 0; i < structure.atoms.size(); i++)
+   {
+      const ExportedAtom &atom = structure.atoms[i];
+      bool rgroup = atom.label[0] == 'R' && (atom.label.size() == 1 || isdigit(atom.label[1]));
+
+      std::string symbol = atom.label;
+      if (rgroup && atom.label.size() == 1)
+         symbol = "R#";
+      else if (symbol.size() > 3)
+      {
+         // the text is given by the alias
+         symbol = "A";
+         aliases.push_back((int)i);
+      }
+
+      _out.printf("%10.4f%10.4f%10.4f %-3s 0  0  0  0  0  0  0  0  0  0  0  0\n", atom.x, atom.y, 0.0, symbol.c_str());
+
+      if (atom.charge != 0 && !rgroup)
+         charges.push_back(std::make_pair((int)i + 1, atom.charge));
+      if (atom.isotope > 0)
+         isotopes.push_back(std::make_pair((int)i + 1, atom.isotope));
+   }
+
+   for (size_t j = 0; j < structure.bonds.size(); j++)
+   {
+      const ExportedBond &bond = structure.bonds[j];
+      int stereo = (bond.stereo == 3) ? 6 : bond.stereo; // V3000 CFG=3 is V2000 down
+      _out.printf("%3d%3d%3d%3d  0  0  0\n", bond.begin + 1, bond.end + 1, bond.order, stereo);
+   }
+
+   for (size_t k = 0; k < aliases.size(); k++)
+   {
+      _out.printf("A  %3d\n", aliases[k] + 1);
+      _out.writeStringCR(structure.atoms[aliases[k]].label.c_str());
+   }
+
+   _writePropertyLines(_out, "CHG", charges);
+   _writePropertyLines(_out, "ISO", isotopes);
+}
@@ -23,17 +23,24 @@ namespace imago
 {
     class Molecule;
     class Output;
+    struct ExportedStructure;
 
     class MolfileSaver
     {
     public:
         MolfileSaver( Output &out );
         void saveMolecule(const Settings& vars, const Molecule &mol );
+        // saves already exported (e.g. expanded) structure, in V2000 if it fits
+        // as Indigo does by default, else in V3000
+        void saveStructure( const ExportedStructure &structure );
         ~MolfileSaver();
     private:
         MolfileSaver( const MolfileSaver &);
         void _writeHeader();
+        void _writeV3000Counts();
         void _writeCtab(const Settings& vars);
+        void _writeStructureCtab(const ExportedStructure &structure);
+        void _writeStructureV2000(const ExportedStructure &structure);
         const Molecule *_mol;
         Output &_out;
     };
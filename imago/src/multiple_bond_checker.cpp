@@ -22,14 +22,14 @@ MultipleBondChecker::MultipleBondChecker(const Settings& vars, Skeleton &s ) : _
 {
    _avgBondLength = _s.bondLength();
 
-   if (_avgBondLength > vars.mbond.LongBond)
-	   _multiBondErr = vars.mbond.LongErr; 
-   else if (_avgBondLength > vars.mbond.MediumBond)
-	   _multiBondErr = vars.mbond.MediumErr;
+   if (_avgBondLength > vars.mbond().LongBond)
+	   _multiBondErr = vars.mbond().LongErr; 
+   else if (_avgBondLength > vars.mbond().MediumBond)
+	   _multiBondErr = vars.mbond().MediumErr;
    else
-	   _multiBondErr = vars.mbond.DefaultErr; 
+	   _multiBondErr = vars.mbond().DefaultErr; 
    
-   _parLinesEps = vars.mbond.ParBondsEps;
+   _parLinesEps = vars.mbond().ParBondsEps;
 }
 
 MultipleBondChecker::~MultipleBondChecker()
@@ -83,7 +83,7 @@ bool MultipleBondChecker::checkDouble(const Settings& vars, Edge frst, Edge scnd
       ratio = bs.length / bf.length;
    }
 
-   if (ratio > vars.mbond.DoubleRatioTresh)
+   if (ratio > vars.mbond().DoubleRatioTresh)
       return false;
 
    double dbb = Vec2d::distance(fb_pos, sb_pos) + Vec2d::distance(fe_pos, se_pos),
@@ -105,7 +105,7 @@ bool MultipleBondChecker::checkDouble(const Settings& vars, Edge frst, Edge scnd
          return false;
 
       dd = Vec2d::distance(m1, m2); 
-	  if (dd < vars.mbond.DoubleCoef * _avgBondLength)      
+	  if (dd < vars.mbond().DoubleCoef * _avgBondLength)      
          return false;
    }
 
@@ -120,7 +120,7 @@ bool MultipleBondChecker::checkDouble(const Settings& vars, Edge frst, Edge scnd
                  Algebra::distance2segment(se_pos, fb_pos, fe_pos));
 
    
-   if (!(dm < vars.mbond.DoubleMagic1 * de && dm < vars.mbond.DoubleMagic2 * db))
+   if (!(dm < vars.mbond().DoubleMagic1 * de && dm < vars.mbond().DoubleMagic2 * db))
    {
       return false;
    }
@@ -144,7 +144,7 @@ bool MultipleBondChecker::checkDouble(const Settings& vars, Edge frst, Edge scnd
       if (d1 > d || d2 > d)
          continue;
       
-	  if (coef > vars.mbond.DoubleTreshMin && coef < vars.mbond.DoubleTreshMax)
+	  if (coef > vars.mbond().DoubleTreshMin && coef < vars.mbond().DoubleTreshMax)
       {
          return false;
       }
@@ -164,28 +164,28 @@ bool MultipleBondChecker::checkDouble(const Settings& vars, Edge frst, Edge scnd
 
    // TODO: depends on hard-set constants (something more adaptive required here)
 
-   if (maxLength > vars.mbond.MaxLen1)
-	   _multiBondErr = vars.mbond.mbe1;
-   else if (maxLength > vars.mbond.MaxLen2)
+   if (maxLength > vars.mbond().MaxLen1)
+	   _multiBondErr = vars.mbond().mbe1;
+   else if (maxLength > vars.mbond().MaxLen2)
    {
-	   if (minLength > vars.mbond.MinLen1)
-         _multiBondErr = vars.mbond.mbe2;
+	   if (minLength > vars.mbond().MinLen1)
+         _multiBondErr = vars.mbond().mbe2;
       else
-         _multiBondErr = vars.mbond.mbe3;
+         _multiBondErr = vars.mbond().mbe3;
    }
-   else if (maxLength > vars.mbond.MaxLen3)
-      _multiBondErr = vars.mbond.mbe4;
-   else if (maxLength > vars.mbond.MaxLen4)
+   else if (maxLength > vars.mbond().MaxLen3)
+      _multiBondErr = vars.mbond().mbe4;
+   else if (maxLength > vars.mbond().MaxLen4)
    {
-	   if (minLength > vars.mbond.MinLen2)
-         _multiBondErr = vars.mbond.mbe5;
+	   if (minLength > vars.mbond().MinLen2)
+         _multiBondErr = vars.mbond().mbe5;
       else
-         _multiBondErr = vars.mbond.mbe6;
+         _multiBondErr = vars.mbond().mbe6;
    }
-   else if (maxLength > vars.mbond.MaxLen5)
-      _multiBondErr = vars.mbond.mbe7;
+   else if (maxLength > vars.mbond().MaxLen5)
+      _multiBondErr = vars.mbond().mbe7;
    else
-	   _multiBondErr = vars.mbond.mbe_def;
+	   _multiBondErr = vars.mbond().mbe_def;
 
 #ifdef DEBUG
    printf("DC:%d; %lf\nDC: %lf < %lf\n", maxLength, _multiBondErr, d, _multiBondErr * maxLength);
@@ -0,0 +1,146 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "parallel_tools.h"
+#include "thread_pool.h"
+#include "trace_sink.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace imago
+{
+	namespace parallel_tools
+	{
+		int getHardwareThreads()
+		{
+			int result = (int)std::thread::hardware_concurrency();
+			return (result > 0) ? result : 1;
+		}
+
+		int getThreadsLimit(const Settings& vars)
+		{
+			if (vars.general.MaxThreads > 0)
+				return vars.general.MaxThreads;
+			return getHardwareThreads();
+		}
+
+		// helpers of all the parallelFor calls, so the threads are not created per call
+		static ThreadPool& _getHelpers()
+		{
+			static ThreadPool pool(getHardwareThreads());
+			return pool;
+		}
+
+		// one parallelFor call; the helpers may start after the call has returned,
+		// so the state is shared and they join only while it is open
+		struct ParallelLoop
+		{
+			const std::function<void(size_t)>* task;
+			size_t count;
+			std::atomic<size_t> next;
+			std::exception_ptr error;
+			bool closed;
+			int active;
+			std::mutex mutex;
+			std::condition_variable finished;
+
+			// the scopes, the counters and the memory of the tasks belong to the calling thread
+			trace_sink::Recorder* trace;
+			pipeline_counters::Counters* counters;
+			memory_budget::Account* account;
+
+			ParallelLoop() : task(NULL), count(0), next(0), closed(false), active(0),
+			                 trace(NULL), counters(NULL), account(NULL) { }
+
+			void run()
+			{
+				trace_sink::ScopedRecording recording(trace);
+				pipeline_counters::ScopedCounters counting(counters);
+				memory_budget::ScopedAccount accounting(account);
+				for (size_t u = next++; u < count; u = next++)
+				{
+					try
+					{
+						(*task)(u);
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						if (!error)
+							error = std::current_exception();
+						next = count; // skip the rest of the tasks
+					}
+				}
+			}
+
+			void help()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					if (closed)
+						return;
+					active++;
+				}
+				run();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					active--;
+				}
+				finished.notify_all();
+			}
+		};
+
+		void parallelFor(size_t count, int threads, const std::function<void(size_t)>& task)
+		{
+			if (threads > (int)count)
+				threads = (int)count;
+
+			if (threads <= 1)
+			{
+				for (size_t u = 0; u < count; u++)
+					task(u);
+				return;
+			}
+
+			std::shared_ptr<ParallelLoop> loop = std::make_shared<ParallelLoop>();
+			loop->task = &task;
+			loop->count = count;
+			loop->trace = trace_sink::current();
+			loop->counters = pipeline_counters::current();
+			loop->account = memory_budget::current();
+
+			// the calling thread runs the tasks too and never waits for the helpers which
+			// have not started, so nested calls from the pool threads do not deadlock
+			ThreadPool& helpers = _getHelpers();
+			for (int t = 1; t < threads; t++)
+				helpers.enqueue([loop](int) { loop->help(); });
+
+			loop->run();
+
+			std::unique_lock<std::mutex> lock(loop->mutex);
+			loop->closed = true;
+			loop->finished.wait(lock, [&loop]() { return loop->active == 0; });
+
+			if (loop->error)
+				std::rethrow_exception(loop->error);
+		}
+	}
+}
@@ -0,0 +1,39 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _parallel_tools_h
+#define _parallel_tools_h
+
+#include <functional>
+#include "settings.h"
+
+namespace imago
+{
+	namespace parallel_tools
+	{
+		// returns count of hardware threads (at least 1)
+		int getHardwareThreads();
+
+		// returns count of threads allowed by general.MaxThreads (0 means all hardware threads)
+		int getThreadsLimit(const Settings& vars);
+
+		// calls task(0) .. task(count-1) using up to 'threads' threads including the calling one,
+		// the others are taken from a process-wide ThreadPool; the first exception thrown
+		// by any task is rethrown after all the threads are done with the tasks
+		void parallelFor(size_t count, int threads, const std::function<void(size_t)>& task);
+	}
+}
+
+#endif // _parallel_tools_h
@@ -0,0 +1,102 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "pipeline_counters.h"
+
+#include <cstdio>
+
+namespace imago
+{
+	namespace pipeline_counters
+	{
+		static const char* const _names[COUNTERS_COUNT] =
+		{
+			"recognitions",
+			"segments_found",
+			"templates_compared",
+			"character_cache_hits",
+			"character_cache_misses",
+			"prefilters_tried",
+			"restarts_captions",
+			"restarts_reconnect",
+			"skeleton_vertices_before",
+			"skeleton_edges_before",
+			"skeleton_vertices_after",
+			"skeleton_edges_after",
+			"timelimit_aborts",
+			"memory_budget_aborts"
+		};
+
+#if (_MSC_VER >= 1800)
+		static __declspec(thread) Counters* _current = NULL;
+#else
+		static thread_local Counters* _current = NULL;
+#endif
+
+		const char* getName(Counter counter)
+		{
+			return _names[counter];
+		}
+
+		Counters::Counters()
+		{
+			reset();
+		}
+
+		void Counters::reset()
+		{
+			for (int u = 0; u < COUNTERS_COUNT; u++)
+				_values[u].store(0, std::memory_order_relaxed);
+		}
+
+		void Counters::writeText(std::string& out) const
+		{
+			char buf[128];
+			for (int u = 0; u < COUNTERS_COUNT; u++)
+			{
+				sprintf(buf, "%s=%lld\n", _names[u], get((Counter)u));
+				out += buf;
+			}
+		}
+
+		Counters& getProcessCounters()
+		{
+			static Counters counters;
+			return counters;
+		}
+
+		Counters* current()
+		{
+			return _current;
+		}
+
+		ScopedCounters::ScopedCounters(Counters* counters)
+		{
+			_previous = _current;
+			_current = counters;
+		}
+
+		ScopedCounters::~ScopedCounters()
+		{
+			_current = _previous;
+		}
+
+		void add(Counter counter, long long value)
+		{
+			getProcessCounters().add(counter, value);
+			if (_current != NULL)
+				_current->add(counter, value);
+		}
+	}
+}
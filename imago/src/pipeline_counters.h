@@ -0,0 +1,97 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _pipeline_counters_h
+#define _pipeline_counters_h
+
+#include <atomic>
+#include <string>
+
+namespace imago
+{
+	namespace pipeline_counters
+	{
+		enum Counter
+		{
+			RECOGNITIONS = 0,
+			SEGMENTS_FOUND,
+			TEMPLATES_COMPARED,
+			CHARACTER_CACHE_HITS,
+			CHARACTER_CACHE_MISSES,
+			PREFILTERS_TRIED,
+			RESTARTS_CAPTIONS,
+			RESTARTS_RECONNECT,
+			SKELETON_VERTICES_BEFORE,
+			SKELETON_EDGES_BEFORE,
+			SKELETON_VERTICES_AFTER,
+			SKELETON_EDGES_AFTER,
+			TIMELIMIT_ABORTS,
+			MEMORY_BUDGET_ABORTS,
+			COUNTERS_COUNT
+		};
+
+		// key used in the statistics output, e.g. "segments_found"
+		const char* getName(Counter counter);
+
+		// set of counters, safe to update from several threads
+		class Counters
+		{
+		public:
+			Counters();
+
+			void add(Counter counter, long long value)
+			{
+				_values[counter].fetch_add(value, std::memory_order_relaxed);
+			}
+
+			long long get(Counter counter) const
+			{
+				return _values[counter].load(std::memory_order_relaxed);
+			}
+
+			void reset();
+
+			// "name=value" lines in the Counter order
+			void writeText(std::string& out) const;
+
+		private:
+			std::atomic<long long> _values[COUNTERS_COUNT];
+
+			Counters(const Counters&);
+			Counters& operator=(const Counters&);
+		};
+
+		// counters of all the recognitions of the process
+		Counters& getProcessCounters();
+
+		// session counters attached to the calling thread or NULL
+		Counters* current();
+
+		// attaches the session counters (may be NULL) to the calling thread until the scope ends
+		class ScopedCounters
+		{
+		public:
+			ScopedCounters(Counters* counters);
+			~ScopedCounters();
+		private:
+			Counters* _previous;
+		};
+
+		// updates the process counters and the session counters of the calling thread
+		void add(Counter counter, long long value = 1);
+	}
+}
+
+#endif // _pipeline_counters_h
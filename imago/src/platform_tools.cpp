@@ -36,6 +36,8 @@ bool platform::checkMemoryFail(int amount)
 #ifdef _WIN32 // ------------------- Windows -------------------
 #include <direct.h>
 #include <Windows.h>
+#include <Psapi.h>
+#pragma comment(lib, "psapi.lib")
 
 int platform::MKDIR(const std::string& directory)
 {
@@ -60,6 +62,14 @@ unsigned int platform::MEM_AVAIL()
 	return static_cast<unsigned int>(statex.ullAvailVirtual >> 10);
 }
 
+unsigned int platform::PEAK_MEMORY()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return static_cast<unsigned int>(counters.PeakWorkingSetSize >> 10);
+}
+
 std::string platform::getLineEndings()
 {
 	return "\r\n";
@@ -144,6 +154,10 @@ int platform::CALL(const std::string& executable, const std::string& parameters,
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
 
 int platform::MKDIR(const std::string& directory)
 {
@@ -152,12 +166,55 @@ int platform::MKDIR(const std::string& directory)
 
 unsigned int platform::TICKS()
 {
-	return 0; // TODO
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	unsigned long long msecs = (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	return (unsigned int)msecs;
+}
+
+// resident pages of the process, 0 if unknown
+static unsigned long long _residentPages()
+{
+	unsigned long long size = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+		return 0;
+	if (fscanf(f, "%llu %llu", &size, &resident) != 2)
+		resident = 0;
+	fclose(f);
+	return resident;
 }
 
 unsigned int platform::MEM_AVAIL()
 {
-	return 0; // TODO
+	// physical memory not used by the process, so the deltas show its own consumption
+	// like the available virtual memory does on Windows
+	long pageSize = sysconf(_SC_PAGESIZE);
+	long pages = sysconf(_SC_PHYS_PAGES);
+	if (pageSize <= 0 || pages <= 0)
+		return 0;
+
+	unsigned long long resident = _residentPages();
+#ifdef _SC_AVPHYS_PAGES
+	if (resident == 0) // no procfs
+		return (unsigned int)(((unsigned long long)sysconf(_SC_AVPHYS_PAGES) * pageSize) >> 10);
+#endif
+	if (resident > (unsigned long long)pages)
+		return 0;
+	return (unsigned int)((((unsigned long long)pages - resident) * pageSize) >> 10);
+}
+
+unsigned int platform::PEAK_MEMORY()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (unsigned int)(usage.ru_maxrss >> 10); // bytes
+#else
+	return (unsigned int)usage.ru_maxrss; // kilobytes
+#endif
 }
 
 int platform::CALL(const std::string& executable, const std::string& parameters, int timelimit)
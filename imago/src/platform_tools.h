@@ -29,6 +29,9 @@ namespace platform
 	// current available memory in kilobytes
 	unsigned int MEM_AVAIL(); 
 
+	// peak resident memory of the process in kilobytes
+	unsigned int PEAK_MEMORY(); 
+
 	// platform-depent line ending string
 	std::string getLineEndings(); 
 
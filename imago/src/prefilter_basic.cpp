@@ -48,12 +48,12 @@ namespace imago
 			getLogExt().append("black_count", black_count);
 			getLogExt().append("others_count", others_count);
 
-			if (vars.prefilterCV.MaxNonBWPixelsProportion * others_count < black_count + white_count)
+			if (vars.prefilterCV().MaxNonBWPixelsProportion * others_count < black_count + white_count)
 			{	
 				getLogExt().appendText("image is binarized");
 				if (others_count > 0)
 				{
-					int gap = vars.prefilterCV.BinarizerFrameGap;
+					int gap = vars.prefilterCV().BinarizerFrameGap;
 					getLogExt().appendText("Fixup other colors");
 					for (int y = 0; y < image.getHeight(); y++)
 					{
@@ -62,7 +62,7 @@ namespace imago
 							if (image.getByte(x,y) != 0 && image.getByte(x,y) != 255)
 							{
 								if (x > gap && y > gap && x + gap < image.getWidth() && y + gap < image.getHeight() &&
-									image.getByte(x, y) < vars.prefilterCV.BinarizerThreshold )
+									image.getByte(x, y) < vars.prefilterCV().BinarizerThreshold )
 								{
 									image.getByte(x, y) = 0;
 								}
@@ -105,14 +105,14 @@ namespace imago
 				// this code allows to crop image in rectangular border
 				// useful only for 1 image from Image2Structure set
 				// but works quite fast.
-				if (image.getWidth() > vars.csr.SmallImageDim && image.getHeight() > vars.csr.SmallImageDim)
+				if (image.getWidth() > vars.csr().SmallImageDim && image.getHeight() > vars.csr().SmallImageDim)
 				{
 					WeakSegmentator ws(image.getWidth(), image.getHeight());
 					ws.appendData(image);
 
 					Rectangle viewport;
-					if (ws.needCrop(vars, viewport, vars.prefilterCV.MaxRectangleCropLineWidthAlreadyBinarized) 
-						&& viewport.height > vars.csr.SmallImageDim && viewport.width > vars.csr.SmallImageDim)
+					if (ws.needCrop(vars, viewport, vars.prefilterCV().MaxRectangleCropLineWidthAlreadyBinarized) 
+						&& viewport.height > vars.csr().SmallImageDim && viewport.width > vars.csr().SmallImageDim)
 					{
 						getLogExt().appendText("Crop appended");
 						image.crop(viewport.x1(), viewport.y1(), viewport.x2(), viewport.y2());
@@ -138,7 +138,7 @@ namespace imago
 			double rescale_ratio = 1.0;
 
 			{
-				double remp_rescale_ratio = std::max(image.cols, image.rows) / vars.csr.RescaleImageDimensions;
+				double remp_rescale_ratio = std::max(image.cols, image.rows) / vars.csr().RescaleImageDimensions;
 				if (remp_rescale_ratio > rescale_ratio)
 					rescale_ratio = remp_rescale_ratio;
 			}
@@ -181,17 +181,17 @@ namespace imago
 			cv::pyrUp(reduced2x, smoothed2x);		
 
 			cv::Mat strong;
-			cv::adaptiveThreshold(smoothed2x, strong, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV.StrongBinarizeSize) + (vars.prefilterCV.StrongBinarizeSize) % 2 + 1, vars.prefilterCV.StrongBinarizeTresh);
+			cv::adaptiveThreshold(smoothed2x, strong, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV().StrongBinarizeSize) + (vars.prefilterCV().StrongBinarizeSize) % 2 + 1, vars.prefilterCV().StrongBinarizeTresh);
 			getLogExt().appendMat("strong", strong);
 
 			cv::Mat weak;
-			cv::adaptiveThreshold(smoothed2x, weak,   255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV.WeakBinarizeSize)   + (vars.prefilterCV.WeakBinarizeSize) % 2 + 1,   vars.prefilterCV.WeakBinarizeTresh);	
+			cv::adaptiveThreshold(smoothed2x, weak,   255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, CV_THRESH_BINARY, (vars.prefilterCV().WeakBinarizeSize)   + (vars.prefilterCV().WeakBinarizeSize) % 2 + 1,   vars.prefilterCV().WeakBinarizeTresh);	
 			getLogExt().appendMat("weak",   weak);
 
 			cv::Mat otsu;
-			if (vars.prefilterCV.UseOtsuPixelsAddition)
+			if (vars.prefilterCV().UseOtsuPixelsAddition)
 			{
-				cv::threshold(smoothed2x, otsu, vars.prefilterCV.OtsuThresholdValue, 255, cv::THRESH_OTSU);
+				cv::threshold(smoothed2x, otsu, vars.prefilterCV().OtsuThresholdValue, 255, cv::THRESH_OTSU);
 				getLogExt().appendMat("otsu",   otsu);
 			}
 
@@ -199,10 +199,10 @@ namespace imago
 			Rectangle viewport;
 			int tresholdPassSum = 0, tresholdPassCount = 0;
 
-			int borderX = raw.getWidth()  / vars.prefilterCV.BorderPartProportion + 1;
-			int borderY = raw.getHeight() / vars.prefilterCV.BorderPartProportion + 1;
+			int borderX = raw.getWidth()  / vars.prefilterCV().BorderPartProportion + 1;
+			int borderY = raw.getHeight() / vars.prefilterCV().BorderPartProportion + 1;
 
-			for (int iter = 0; iter <= (vars.prefilterCV.UseOtsuPixelsAddition ? 1 : 0); iter++)
+			for (int iter = 0; iter <= (vars.prefilterCV().UseOtsuPixelsAddition ? 1 : 0); iter++)
 			{
 				Image bin;
 				if (iter == 0)
@@ -218,8 +218,8 @@ namespace imago
 				{
 					viewport = Rectangle(0, 0, raw.getWidth(), raw.getHeight());
 					Rectangle temp;
-					if (ws.needCrop(vars, temp, vars.prefilterCV.MaxRectangleCropLineWidth) &&
-						temp.width > vars.csr.SmallImageDim && temp.height > vars.csr.SmallImageDim)
+					if (ws.needCrop(vars, temp, vars.prefilterCV().MaxRectangleCropLineWidth) &&
+						temp.width > vars.csr().SmallImageDim && temp.height > vars.csr().SmallImageDim)
 					{
 						getLogExt().appendText("Crop appended");
 						viewport = temp;
@@ -244,7 +244,7 @@ namespace imago
 							bad++;
 					}
 
-					if (vars.prefilterCV.MaxBadToGoodRatio * good > bad && good > vars.prefilterCV.MinGoodPixelsCount)
+					if (vars.prefilterCV().MaxBadToGoodRatio * good > bad && good > vars.prefilterCV().MinGoodPixelsCount)
 					{
 						if (getLogExt().loggingEnabled())
 						{
@@ -0,0 +1,247 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "prefilter_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "exception.h"
+#include "filters_list.h"
+#include "output.h"
+#include "scanner.h"
+#include "settings_schema.h"
+
+namespace imago
+{
+	static const int PREFILTER_CACHE_MAGIC = 0x50464331; // "PFC1"
+
+	static std::unique_ptr<PrefilterCache> _instance;
+
+	PrefilterCache::PrefilterCache(size_t maxBytes) : _bytes(0), _maxBytes(maxBytes), _memory(NULL, 0), _hits(0), _misses(0)
+	{
+	}
+
+	PrefilterCache* PrefilterCache::getInstance()
+	{
+		return _instance.get();
+	}
+
+	void PrefilterCache::enable(size_t maxBytes)
+	{
+		_instance.reset(new PrefilterCache(maxBytes));
+	}
+
+	void PrefilterCache::disable()
+	{
+		_instance.reset();
+	}
+
+	// settings read by the prefilters (see prefilter_basic.cpp, prefilter_retinex.cpp, weak_segmentator.cpp)
+	static bool _isPrefilterSetting(const std::string& name)
+	{
+		return name.compare(0, 12, "prefilterCV.") == 0 ||
+		       name.compare(0, 8, "retinex.") == 0 ||
+		       name.compare(0, 9, "weak_seg.") == 0 ||
+		       name == "csr.SmallImageDim" ||
+		       name == "csr.RescaleImageDimensions";
+	}
+
+	std::string PrefilterCache::makeKey(const Settings& vars, const Image& src)
+	{
+		// FNV-1a of the pixels
+		qword hash = 14695981039346656037ULL;
+		for (int y = 0; y < src.rows; y++)
+		{
+			const unsigned char* row = src.ptr(y);
+			for (int x = 0; x < src.cols; x++)
+			{
+				hash ^= row[x];
+				hash *= 1099511628211ULL;
+			}
+		}
+
+		char buf[128];
+		sprintf(buf, "%016llx:%dx%d:%d:%.17g", (unsigned long long)hash, src.cols, src.rows,
+		        vars.general.FilterIndex, vars.dynamic.CapitalHeight);
+		std::string key = buf;
+
+		const SettingsSchema& schema = SettingsSchema::getInstance();
+		for (size_t u = 0; u < schema.size(); u++)
+		{
+			const std::string& name = schema.getField(u).name;
+			if (!_isPrefilterSetting(name))
+				continue;
+
+			DataTypeReference ref = schema.getReference(vars, u);
+			switch (ref.getType())
+			{
+			case DataTypeReference::otBool:
+				sprintf(buf, "%d", *(ref.getBool()) ? 1 : 0);
+				break;
+			case DataTypeReference::otInt:
+				sprintf(buf, "%d", *(ref.getInt()));
+				break;
+			case DataTypeReference::otDouble:
+				sprintf(buf, "%.17g", *(ref.getDouble()));
+				break;
+			default:
+				buf[0] = 0;
+				break;
+			}
+			key += ";" + name + "=" + buf;
+		}
+
+		return key;
+	}
+
+	bool PrefilterCache::lookup(const std::string& key, Settings& vars, Image& output, bool& result)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			Entries::iterator it = _entries.find(key);
+			if (it == _entries.end())
+			{
+				_misses++;
+				return false;
+			}
+
+			_hits++;
+			_order.splice(_order.begin(), _order, it->second.order);
+			result = it->second.result;
+			vars.general.FilterIndex = it->second.filterIndex;
+			output.copy(it->second.output);
+		}
+
+		// the same settings update as applyNextPrefilter does after the successful filter
+		const FilterEntries& filters = getFiltersList();
+		if (result && vars.general.FilterIndex < (int)filters.size())
+			filters[vars.general.FilterIndex].update_config.apply(vars);
+
+		return true;
+	}
+
+	void PrefilterCache::store(const std::string& key, const Settings& vars, const Image& output, bool result)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_insert(key, result, vars.general.FilterIndex, output);
+	}
+
+	void PrefilterCache::_insert(const std::string& key, bool result, int filterIndex, const Image& output)
+	{
+		size_t size = (size_t)output.cols * output.rows + key.size();
+		if (size > _maxBytes || _entries.find(key) != _entries.end())
+			return;
+
+		Entry& entry = _entries[key];
+		entry.result = result;
+		entry.filterIndex = filterIndex;
+		entry.output.copy(output);
+		_order.push_front(key);
+		entry.order = _order.begin();
+		_bytes += size;
+
+		_evict();
+		_memory.resize(_bytes);
+	}
+
+	void PrefilterCache::_evict()
+	{
+		while (_bytes > _maxBytes && !_order.empty())
+		{
+			Entries::iterator it = _entries.find(_order.back());
+			_bytes -= (size_t)it->second.output.cols * it->second.output.rows + it->first.size();
+			_entries.erase(it);
+			_order.pop_back();
+		}
+	}
+
+	bool PrefilterCache::loadFromFile(const std::string& filename)
+	{
+		try
+		{
+			FileScanner fi("%s", filename.c_str());
+			if (fi.readBinaryInt() != PREFILTER_CACHE_MAGIC)
+				throw ImagoException("Wrong prefilter cache header");
+
+			int count = fi.readBinaryInt();
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (int u = 0; u < count; u++)
+			{
+				// sizes are checked against the rest of the file before allocating
+				int keySize = fi.readBinaryInt();
+				if (keySize < 0 || keySize > fi.length() - fi.tell())
+					throw ImagoException("Prefilter cache is damaged");
+				std::string key(keySize, 0);
+				if (keySize > 0)
+					fi.read(keySize, &key[0]);
+
+				bool result = fi.readBinaryInt() != 0;
+				int filterIndex = fi.readBinaryInt();
+				int width = fi.readBinaryInt();
+				int height = fi.readBinaryInt();
+				if (width < 0 || height < 0 || (long long)width * height > fi.length() - fi.tell())
+					throw ImagoException("Prefilter cache is damaged");
+
+				Image output;
+				if (width > 0 && height > 0)
+				{
+					output.init(width, height);
+					for (int y = 0; y < height; y++)
+						fi.read(width, output.ptr(y));
+				}
+				_insert(key, result, filterIndex, output);
+			}
+			return true;
+		}
+		catch (std::exception&)
+		{
+			// any damage (including a failed allocation) is a cache miss
+			return false;
+		}
+	}
+
+	bool PrefilterCache::storeToFile(const std::string& filename)
+	{
+		try
+		{
+			FileOutput fo("%s", filename.c_str());
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			fo.writeBinaryInt(PREFILTER_CACHE_MAGIC);
+			fo.writeBinaryInt((int)_entries.size());
+
+			// least recently used first, so the loading keeps the recent ones
+			for (std::list<std::string>::reverse_iterator key = _order.rbegin(); key != _order.rend(); ++key)
+			{
+				const Entry& entry = _entries[*key];
+				fo.writeBinaryInt((int)key->size());
+				fo.write(key->data(), (int)key->size());
+				fo.writeBinaryInt(entry.result ? 1 : 0);
+				fo.writeBinaryInt(entry.filterIndex);
+				fo.writeBinaryInt(entry.output.cols);
+				fo.writeBinaryInt(entry.output.rows);
+				for (int y = 0; y < entry.output.rows; y++)
+					fo.write(entry.output.ptr(y), entry.output.cols);
+			}
+			return true;
+		}
+		catch (ImagoException&)
+		{
+			return false;
+		}
+	}
+}
@@ -0,0 +1,84 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _prefilter_cache_h
+#define _prefilter_cache_h
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include "image.h"
+#include "settings.h"
+#include "memory_budget.h"
+
+namespace imago
+{
+	// content-addressed cache of the prefilters output: the key is the source image hash plus
+	// the values of all settings read by the prefilters, so the results are reused when only
+	// downstream constants (separator, skeleton, labels, etc) are changed
+	class PrefilterCache
+	{
+	public:
+		// least recently used entries are dropped when the images exceed maxBytes
+		PrefilterCache(size_t maxBytes);
+
+		// the process-wide cache used by applyNextPrefilter, NULL if disabled (default);
+		// should be enabled before the recognition threads are started
+		static PrefilterCache* getInstance();
+		static void enable(size_t maxBytes);
+		static void disable();
+
+		// builds the key for prefilters applied to 'src' starting from vars.general.FilterIndex
+		static std::string makeKey(const Settings& vars, const Image& src);
+
+		// on hit restores output, filter index and the filter settings update, returns true
+		bool lookup(const std::string& key, Settings& vars, Image& output, bool& result);
+		void store(const std::string& key, const Settings& vars, const Image& output, bool result);
+
+		// packed on-disk storage for repeated runs, returns false on error
+		bool loadFromFile(const std::string& filename);
+		bool storeToFile(const std::string& filename);
+
+		size_t hits() const { return _hits; }
+		size_t misses() const { return _misses; }
+
+	private:
+		struct Entry
+		{
+			bool result;
+			int filterIndex;
+			Image output;
+			std::list<std::string>::iterator order;
+		};
+
+		typedef std::map<std::string, Entry> Entries;
+
+		void _insert(const std::string& key, bool result, int filterIndex, const Image& output);
+		void _evict();
+
+		Entries _entries;
+		std::list<std::string> _order; // most recently used first
+		size_t _bytes, _maxBytes;
+		memory_budget::Reservation _memory; // _bytes, charged to the process account only
+		size_t _hits, _misses;
+		std::mutex _mutex;
+
+		PrefilterCache(const PrefilterCache&);
+		PrefilterCache& operator=(const PrefilterCache&);
+	};
+}
+
+#endif // _prefilter_cache_h
@@ -3,6 +3,9 @@
 #include "log_ext.h"
 #include "prefilter_basic.h"
 #include "filters_list.h"
+#include "stage_timer.h"
+#include "prefilter_cache.h"
+#include "pipeline_counters.h"
 
 namespace imago
 {
@@ -37,11 +40,11 @@ namespace imago
 			logEnterFunction();
 			
 			int dim = std::max(image.getWidth(), image.getHeight());
-			if (dim > vars.csr.RescaleImageDimensions) 
+			if (dim > vars.csr().RescaleImageDimensions) 
 			{
 				cv::Mat mat;
 				ImageUtils::copyImageToMat(image, mat);
-				if (downscale(mat, vars.csr.RescaleImageDimensions))
+				if (downscale(mat, vars.csr().RescaleImageDimensions))
 				{
 					image.clear();
 					ImageUtils::copyMatToImage(mat, image);
@@ -56,30 +59,28 @@ namespace imago
 	{
 		logEnterFunction();
 
-		bool result = false;
+		// estimates of the previous image must not leak into this one
+		vars.resetRecognitionState();
 
-		output.copy(src);
-		
 		vars.general.ImageWidth = vars.general.OriginalImageWidth = src.getWidth();
 		vars.general.ImageHeight = vars.general.OriginalImageHeight = src.getHeight();
 
-		vars.general.ImageAlreadyBinarized = false;
-		vars.general.FilterIndex = 0;
+		// the cluster is selected once per image, before the first pass, so every
+		// prefilter pass and the recognition use the same config
+		if (vars.getClusterModel())
+		{
+			vars.features.compute(src);
+			vars.selectBestCluster();
+		}
 		
 		return applyNextPrefilter(vars, output, src, false);
 	}
 
-	bool applyNextPrefilter(Settings& vars, Image& output, const Image& src, bool iterateNext)
+	static bool _applyPrefilters(Settings& vars, Image& output, const Image& src)
 	{
-		logEnterFunction();
 		bool result = false;
 
-		if (iterateNext)
-		{
-			vars.general.FilterIndex++;
-		}
-
-		FilterEntries filters = getFiltersList();
+		const FilterEntries& filters = getFiltersList();
 
 		for (; vars.general.FilterIndex < (int)filters.size(); vars.general.FilterIndex++)
 		{
@@ -87,7 +88,10 @@ namespace imago
 
 			int& u = vars.general.FilterIndex;
 
+			logStageTime("prefilter " + filters[u].name);
+
 			getLogExt().append("use filter", filters[u].name);
+			pipeline_counters::add(pipeline_counters::PREFILTERS_TRIED);
 
 			if (filters[u].condition != NULL &&
 				filters[u].condition(output) == false)
@@ -99,10 +103,7 @@ namespace imago
 			if (filters[u].routine(vars, output))
 			{
 				getLogExt().append("filter success", filters[u].name);
-				if (!filters[u].update_config_string.empty())
-				{
-					vars.fillFromDataStream(filters[u].update_config_string);
-				}
+				filters[u].update_config.apply(vars);
 				result = true;
 				break;
 			}
@@ -114,4 +115,31 @@ namespace imago
 
 		return result;
 	}
+
+	bool applyNextPrefilter(Settings& vars, Image& output, const Image& src, bool iterateNext)
+	{
+		logEnterFunction();
+
+		if (iterateNext)
+		{
+			vars.general.FilterIndex++;
+		}
+
+		// the cache is skipped while logging, so the log shows the filters work
+		PrefilterCache* cache = PrefilterCache::getInstance();
+		if (cache == NULL || getLogExt().loggingEnabled())
+			return _applyPrefilters(vars, output, src);
+
+		bool result = false;
+		std::string key = PrefilterCache::makeKey(vars, src);
+		if (cache->lookup(key, vars, output, result))
+		{
+			getLogExt().append("prefilter cache hit, filter", vars.general.FilterIndex);
+			return result;
+		}
+
+		result = _applyPrefilters(vars, output, src);
+		cache->store(key, vars, output, result);
+		return result;
+	}
 }
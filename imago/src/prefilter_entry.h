@@ -21,7 +21,9 @@
 
 namespace imago
 {
-	// selects first OK prefilter
+	// selects the config cluster by the source image if there is a cluster model,
+	// then the first OK prefilter; output is owned by the caller,
+	// which keeps it charged to the memory budget while it is used
 	bool prefilterEntrypoint(Settings& vars, Image& output, const Image& src);
 	
 	// iterates trough next filters
@@ -4,6 +4,7 @@
 #include "image_utils.h"
 #include "prefilter_basic.h"
 #include "prefilter_entry.h"
+#include "memory_budget.h"
 
 namespace imago
 {
@@ -259,6 +260,10 @@ namespace imago
 			int height = (raw.getHeight() / 2) * 2;
 
 			typedef std::vector<float> Array;
+
+			// result, input and the iteration planes plus the retinexProcess temporaries
+			size_t pixels = (size_t)width * height;
+			memory_budget::Reservation planesMemory(pixels * (4 * sizeof(float) + sizeof(double)));
 			
 			Array result(width * height);
 
@@ -270,9 +275,9 @@ namespace imago
 					for (int x = 0; x < width; x++)
 						input[y * width + x] = raw.getByte(x, y);
 
-				for (int iteration =  vars.retinex.StartIteration; 
-					     iteration <  vars.retinex.EndIteration; 
-						 iteration += vars.retinex.IterationStep)
+				for (int iteration =  vars.retinex().StartIteration; 
+					     iteration <  vars.retinex().EndIteration; 
+						 iteration += vars.retinex().IterationStep)
 				{
 					getLogExt().append("Iteration", iteration);
 
@@ -285,7 +290,7 @@ namespace imago
 			}
 
 			// normalize contrast
-			contrastNormalize(result, vars.retinex.ContrastNominal, vars.retinex.ContrastDropPercentage);
+			contrastNormalize(result, vars.retinex().ContrastNominal, vars.retinex().ContrastDropPercentage);
 
 			// store result back
 			getLogExt().appendText("Store image data");
@@ -124,7 +124,7 @@ void ProbabilitySeparator::CalculateProbabilities(const Settings& vars,
 {
 	ComplexContour contour  = ComplexContour::RetrieveContour(vars, seg);
 	
-	if(vars.p_estimator.UsePerimeterNormalization)
+	if(vars.p_estimator().UsePerimeterNormalization)
 		contour.NormalizeByPerimeter();
 	else
 		contour.Normalize();
@@ -139,7 +139,7 @@ void ProbabilitySeparator::CalculateProbabilities(const Settings& vars,
 		int binD = getAngleDirection(cn);
 		int binS = ((int)(cn.getRadius() * 10)) % 10;
 		int binD2 = getAngleDirection(contour.getContour(i+1));
-		if(vars.p_estimator.UsePerimeterNormalization)
+		if(vars.p_estimator().UsePerimeterNormalization)
 		{
 			bond_prob *= jointPG[binD][binS];
 			char_prob *= jointPS[binD][binS];
@@ -70,9 +70,9 @@ int Separator::HuClassifier(const Settings& vars, Image &im)
 	double hu[7];
 	_getHuMomentsC(im, hu);
 
-	if (hu[1] > vars.separator.hu_1_1 || (hu[1] < vars.separator.hu_1_2 && hu[0] < vars.separator.hu_0_1))
+	if (hu[1] > vars.separator().hu_1_1 || (hu[1] < vars.separator().hu_1_2 && hu[0] < vars.separator().hu_0_1))
 		return SEP_BOND;
-	if (hu[1] < vars.separator.hu_1_3 && hu[0] > vars.separator.hu_0_2)
+	if (hu[1] < vars.separator().hu_1_3 && hu[0] > vars.separator().hu_0_2)
 		return SEP_SYMBOL;
 
 	return SEP_SUSPICIOUS;
@@ -119,9 +119,9 @@ bool Separator::_bIsTextContext(const Settings& vars, SegmentDeque &layer_symbol
 		return true;
 
 	if(xfirstSeparable  && !yfirstSeparable &&
-		rec.height < vars.dynamic.CapitalHeight + vars.separator.ltFactor1 * vars.dynamic.LineThickness && 
-		rec.height > vars.dynamic.CapitalHeight * vars.separator.capHeightMin &&
-		dist1 < vars.separator.capHeightMax * vars.dynamic.CapitalHeight && vars.separator.extRatioMin > ((double)rec.width / (double)rec.height))
+		rec.height < vars.dynamic.CapitalHeight + vars.separator().ltFactor1 * vars.dynamic.LineThickness && 
+		rec.height > vars.dynamic.CapitalHeight * vars.separator().capHeightMin &&
+		dist1 < vars.separator().capHeightMax * vars.dynamic.CapitalHeight && vars.separator().extRatioMin > ((double)rec.width / (double)rec.height))
 		return true;
 	return false;
 }
@@ -239,7 +239,7 @@ int Separator::ClusterLines(const Settings& vars,Points2d& inputLines, IntVector
 		  double dc1 = fabs(dist - c1);
 		  double dc2 = fabs(dist - c2);
 		  if(dc1 < dc2 && (dist < vars.dynamic.CapitalHeight || 
-			  (dist < vars.dynamic.CapitalHeight * vars.separator.getRatio2 && ratio < vars.estimation.MinSymRatio)))
+			  (dist < vars.dynamic.CapitalHeight * vars.separator().getRatio2 && ratio < vars.estimation().MinSymRatio)))
 			  outClasses[i] = 0;
 		  else
 			  outClasses[i] = 1;
@@ -283,7 +283,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 	double line_thick = vars.dynamic.LineThickness;
     CvApproximator cvApprox;
 	
-    GraphicsDetector gd(&cvApprox, line_thick * vars.separator.gdConst);
+    GraphicsDetector gd(&cvApprox, line_thick * vars.separator().gdConst);
 
 	Image timg(_img.getWidth(), _img.getHeight());
 	timg.fillWhite();
@@ -361,7 +361,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 
 	do
 	{
-		if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+		if (vars.checkTimeLimit()) throw TimeLimitException();
 
 		i++;
 		if(i == symInds.size())
@@ -394,7 +394,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		int j = 0;
 		
 		do{
-			if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+			if (vars.checkTimeLimit()) throw TimeLimitException();
 
 			added = false;
 			if(pq.empty())
@@ -463,11 +463,11 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 
 	bool found_symbol = false;
 		
-	double adequate_ratio_min = vars.estimation.MinSymRatio;
+	double adequate_ratio_min = vars.estimation().MinSymRatio;
 
 	for(size_t i=0;i< symbRects.size(); i++)
 	{
-		if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+		if (vars.checkTimeLimit()) throw TimeLimitException();
 
 		bool isTextContext = _bIsTextContext(vars, layer_symbols, symbRects[i]);
 
@@ -526,7 +526,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		{
 			for(size_t n = 0; n < RectPoints[i].size(); n++)
 			{
-				if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+				if (vars.checkTimeLimit()) throw TimeLimitException();
 
 				Vec2d pt = RectPoints[i][n];
 				int dx = round(pt.x - left);
@@ -570,7 +570,7 @@ void Separator::SeparateStuckedSymbols(const Settings& vars, SegmentDeque &layer
 		{
 			for(size_t k = 0; k < linesegs.size() / 2; k++)
 			{
-				if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+				if (vars.checkTimeLimit()) throw TimeLimitException();
 
 				Vec2d p1 = linesegs[2 * k];
 				Vec2d p2 = linesegs[2 * k + 1];
@@ -677,7 +677,7 @@ int Separator::PredictGroup(const Settings& vars, Segment *seg, int mark,  Segme
 	logEnterFunction();
 	int retVal = mark;
 	double bond_prob, sym_prob;
-	double aprior = vars.p_estimator.DefaultApriority; //0.5
+	double aprior = vars.p_estimator().DefaultApriority; //0.5
 
 	double capital_height = 0;
 	if( layer_symbols.size() > 0 )
@@ -692,17 +692,17 @@ int Separator::PredictGroup(const Settings& vars, Segment *seg, int mark,  Segme
 
 
 	if(mark == SEP_SYMBOL)
-		aprior = vars.p_estimator.ApriorProb4SymbolCase;// 0.8;
+		aprior = vars.p_estimator().ApriorProb4SymbolCase;// 0.8;
 	else
 	{
 		double maxEdge = seg->getHeight() > seg ->getWidth() ? seg->getHeight() : seg->getWidth();
 		double surfaceRatio =  maxEdge / capital_height;
 
-		if(surfaceRatio < vars.p_estimator.MinRatio2ConsiderGrPr) //0.25)
+		if(surfaceRatio < vars.p_estimator().MinRatio2ConsiderGrPr) //0.25)
 			surfaceRatio = 1.0 / surfaceRatio;
 				
 		aprior = 1.0 - 1.0 / 
-			( 1 + std::exp( - ( surfaceRatio - vars.p_estimator.LogisticLocation )/vars.p_estimator.LogisticScale ) );
+			( 1 + std::exp( - ( surfaceRatio - vars.p_estimator().LogisticLocation )/vars.p_estimator().LogisticScale ) );
 	}
 
 	try
@@ -736,13 +736,13 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 {
 	logEnterFunction();
 
-	if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	if (vars.checkTimeLimit()) throw TimeLimitException();
 
 	int cap_height = (int)vars.dynamic.CapitalHeight;
 
-	int sym_height_err = (int)vars.estimation.SymHeightErr;
-	double adequate_ratio_max = vars.estimation.MaxSymRatio;
-	double adequate_ratio_min = vars.estimation.MinSymRatio;
+	int sym_height_err = (int)vars.estimation().SymHeightErr;
+	double adequate_ratio_max = vars.estimation().MaxSymRatio;
+	double adequate_ratio_min = vars.estimation().MinSymRatio;
     
     /* Classification procedure */
 	
@@ -766,7 +766,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 
 	if(mark == SEP_SYMBOL && 
 		(!(s->getHeight() >= cap_height - sym_height_err && s->getHeight() <= cap_height + sym_height_err && s->getHeight() <= cap_height * 2 && s->getWidth() <= cap_height)
-		|| s->getHeight() < vars.separator.capHeightRatio *cap_height)
+		|| s->getHeight() < vars.separator().capHeightRatio *cap_height)
 		)
 		mark = SEP_SUSPICIOUS;
 	cresults.KNNRatios = mark;
@@ -785,9 +785,9 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 		if (s->getHeight() >= cap_height - sym_height_err && 
 			s->getHeight() <= cap_height + sym_height_err &&
 			s->getHeight() <= cap_height * 2 &&
-			s->getWidth() <= vars.separator.capHeightRatio2 * cap_height) 
+			s->getWidth() <= vars.separator().capHeightRatio2 * cap_height) 
 		{
-			if (thinseg->getRatio() > vars.separator.getRatio1 && thinseg->getRatio() < vars.separator.getRatio2)
+			if (thinseg->getRatio() > vars.separator().getRatio1 && thinseg->getRatio() < vars.separator().getRatio2)
 			{
 				if (_analyzeSpecialSegment(vars, thinseg))
 				{
@@ -796,7 +796,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 			}
 
 			if (thinseg->getRatio() > adequate_ratio_max)
-				if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator.testSlashLine1))
+				if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator().testSlashLine1))
 					mark = SEP_BOND;
 				else
 					mark = SEP_SPECIAL;
@@ -807,7 +807,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 					else
 						mark = SEP_SUSPICIOUS;
 				else
-					if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator.testSlashLine2))
+					if (ImageUtils::testSlashLine(vars, *thinseg, 0, vars.separator().testSlashLine2))
 						mark = SEP_BOND;
 					else 
 						mark = SEP_SYMBOL;
@@ -826,7 +826,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 
 	int segs = _getApproximationSegmentsCount(vars, s) - 1;
 
-	if (segs > vars.separator.minApproxSegsStrong)
+	if (segs > vars.separator().minApproxSegsStrong)
 	{		
 		getLogExt().append("cap_height", cap_height);
 		getLogExt().append("Height", s->getHeight());
@@ -834,13 +834,13 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 		getLogExt().append("Width/height", wh);
 
 		bool two_chars_probably = 
-			wh > vars.separator.extRatioMax &&
-			wh < vars.separator.ext2charRatio * vars.separator.extRatioMax;
+			wh > vars.separator().extRatioMax &&
+			wh < vars.separator().ext2charRatio * vars.separator().extRatioMax;
 		
-		if (s->getHeight() > vars.separator.extCapHeightMin * cap_height && 
-			s->getHeight() < vars.separator.extCapHeightMax * cap_height &&
-									wh > vars.separator.extRatioMin && 
-			(two_chars_probably || wh < vars.separator.extRatioMax) )
+		if (s->getHeight() > vars.separator().extCapHeightMin * cap_height && 
+			s->getHeight() < vars.separator().extCapHeightMax * cap_height &&
+									wh > vars.separator().extRatioMin && 
+			(two_chars_probably || wh < vars.separator().extRatioMax) )
 		{				
 			char ch;
 
@@ -909,7 +909,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 						rec.isPossibleCharacter(vars, *s2, true, &ch))
 					{
 						getLogExt().appendText("Both are symbols");
-						if (segs > vars.separator.minApproxSegsWeak)
+						if (segs > vars.separator().minApproxSegsWeak)
 						{							
 							getLogExt().appendText("Segments criteria passed");
 							layer_symbols.push_back(s1);
@@ -931,7 +931,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 			{
 				int segs = _getApproximationSegmentsCount(vars, s) - 1;
 				getLogExt().append("Approx segs", segs);
-				if (segs > (strict ? vars.separator.minApproxSegsStrong : vars.separator.minApproxSegsWeak))
+				if (segs > (strict ? vars.separator().minApproxSegsStrong : vars.separator().minApproxSegsWeak))
 				{
 					getLogExt().appendText("Segment marked as symbol");
 					mark = SEP_SYMBOL;
@@ -956,7 +956,7 @@ void Separator::ClassifySegment(const Settings& vars, SegmentDeque &layer_symbol
 		cresults.Probability = mark;
 	}
 
-	if (vars.separator.UseVoteArray)
+	if (vars.separator().UseVoteArray)
 	{
 		mark = votes[SEP_SYMBOL] > votes[SEP_BOND] ? SEP_SYMBOL : SEP_BOND;
 	}
@@ -1016,17 +1016,17 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 	   RecognitionDistance rd = rec.recognize(vars, *s, CharacterRecognizer::all + CharacterRecognizer::graphics);
 	   double dist;
 	   char c = rd.getBest(&dist);
-	   if (CharacterRecognizer::graphics.find(c) != std::string::npos && dist < vars.characters.DistanceAbsolutelySure)
+	   if (CharacterRecognizer::graphics.find(c) != std::string::npos && dist < vars.characters().DistanceAbsolutelySure)
 	   {
 		   layer_graphics.push_back(s);
 		   getLogExt().appendText("Classified as graphics on first stage");
 	   }
 	   else if (CharacterRecognizer::like_bonds.find(c) == std::string::npos
 		        && (vars.dynamic.CapitalHeight < 0 ||
-				s->getHeight() > vars.characters.HeightMinBound * vars.dynamic.CapitalHeight  
-				&& s->getHeight() < vars.characters.HeightMaxBound * vars.dynamic.CapitalHeight ) )
+				s->getHeight() > vars.characters().HeightMinBound * vars.dynamic.CapitalHeight  
+				&& s->getHeight() < vars.characters().HeightMaxBound * vars.dynamic.CapitalHeight ) )
 		{
-			if (dist < vars.characters.DistanceAbsolutelySure)
+			if (dist < vars.characters().DistanceAbsolutelySure)
 			{
 				if (CharacterRecognizer::upper.find(c) != std::string::npos)
 				{
@@ -1049,7 +1049,7 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 	   }	   
    }
 
-   if (height_count >= vars.characters.ReestimateMinimalCharacters || (height_count > 0 && vars.dynamic.CapitalHeight < 0)) 
+   if (height_count >= vars.characters().ReestimateMinimalCharacters || (height_count > 0 && vars.dynamic.CapitalHeight < 0)) 
 	{
 		getLogExt().appendText("Re-estimate cap height");
 		double height = height_sum / height_count;
@@ -1085,7 +1085,7 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 		   continue;
 
 		  if (vars.checkTimeLimit())
-			  throw ImagoException("Timelimit exceeded");
+			  throw TimeLimitException();
 
 		  Segment *s = *it;
 		  ClassifierResults cres;
@@ -1122,14 +1122,14 @@ void Separator::Separate(Settings& vars, CharacterRecognizer &rec, SegmentDeque
 
 bool Separator::_analyzeSpecialSegment(const Settings& vars, Segment *cur_seg)
 {
-	return _getApproximationSegmentsCount(vars, cur_seg) <= vars.separator.specialSegmentsTreat;
+	return _getApproximationSegmentsCount(vars, cur_seg) <= vars.separator().specialSegmentsTreat;
 }
 
 int Separator::_getApproximationSegmentsCount(const Settings& vars, Segment *seg)
 {
    Image tmp;
    CvApproximator cvApprox;
-   GraphicsDetector gd(&cvApprox, vars.dynamic.LineThickness * vars.separator.gdConst);
+   GraphicsDetector gd(&cvApprox, vars.dynamic.LineThickness * vars.separator().gdConst);
    Points2d lsegments;
    tmp.copy(*seg);
    gd.detect(vars, tmp, lsegments);
@@ -1147,7 +1147,7 @@ int Separator::_estimateCapHeight(const Settings& vars, bool &restrictedHeight)
 
    for(Segment *s: _segs)
    {
-	   if (s->getHeight() >= vars.characters.MinimalRecognizableHeight)
+	   if (s->getHeight() >= vars.characters().MinimalRecognizableHeight)
 	   {
 		   heights.push_back(s->getHeight());
 	   }
@@ -1163,7 +1163,7 @@ int Separator::_estimateCapHeight(const Settings& vars, bool &restrictedHeight)
    puts("");
 #endif
 
-   int seg_ver_eps = vars.estimation.SegmentVerEps;
+   int seg_ver_eps = vars.estimation().SegmentVerEps;
    getLogExt().append("Seg_ver_eps", seg_ver_eps);
 
    for (size_t i = 0; i < heights.size(); )
@@ -1275,7 +1275,7 @@ int Separator::_estimateCapHeight(const Settings& vars, bool &restrictedHeight)
 
    getLogExt().append("Return", cap_height);
 
-   double cap_height_limit = std::max(vars.general.ImageWidth, vars.general.ImageHeight) * vars.estimation.MaxSymbolHeightPercentsOfImage;
+   double cap_height_limit = std::max(vars.general.ImageWidth, vars.general.ImageHeight) * vars.estimation().MaxSymbolHeightPercentsOfImage;
    if (cap_height > cap_height_limit)
    {
 	   cap_height = round(cap_height_limit);
@@ -1292,7 +1292,7 @@ bool Separator::_checkSequence(const Settings& vars, IntPair &checking, IntPair
 {
    if (checking.second - checking.first == 1)
    {
-	   if (_segs[checking.first]->getDensity() < vars.separator.minDensity)
+	   if (_segs[checking.first]->getDensity() < vars.separator().minDensity)
       {
          symbols_graphics.first = 1;
          symbols_graphics.second = 0;
@@ -1302,12 +1302,12 @@ bool Separator::_checkSequence(const Settings& vars, IntPair &checking, IntPair
       }
    }
 
-   double adequate_ratio_max = vars.estimation.MaxSymRatio;
-   double adequate_ratio_min = vars.estimation.MinSymRatio;
+   double adequate_ratio_max = vars.estimation().MaxSymRatio;
+   double adequate_ratio_min = vars.estimation().MinSymRatio;
 
    for (int i = checking.first; i < checking.second; i++)
    {
-	   if (_segs[i]->getDensity() > vars.separator.maxDensity && (_segs[i]->getHeight() > _segs[i]->getWidth()))
+	   if (_segs[i]->getDensity() > vars.separator().maxDensity && (_segs[i]->getHeight() > _segs[i]->getWidth()))
       {
          if (!_testDoubleBondV(vars, *_segs[i]))
          {
@@ -1370,8 +1370,8 @@ bool Separator::_testDoubleBondV(const Settings& vars, Segment &segment )
 
    for(Segment *s: segs)
    {
-	   if (s->getRatio() <= vars.estimation.MinSymRatio)
-		   if (absolute(s->getX() - segment.getX()) < vars.estimation.DoubleBondDist) 
+	   if (s->getRatio() <= vars.estimation().MinSymRatio)
+		   if (absolute(s->getX() - segment.getX()) < vars.estimation().DoubleBondDist) 
          {
             ret = true;
             break;
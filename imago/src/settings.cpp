@@ -13,12 +13,14 @@
  ***************************************************************************/
 
 #include "settings.h"
+#include "settings_schema.h"
+#include "cluster_model.h"
 #include "platform_tools.h"
 #include "log_ext.h"
-#include "scanner.h"
 #include <stdio.h>
 #include <string.h> // memset
 #include <algorithm>
+#include <vector>
 
 namespace imago
 {
@@ -35,11 +37,16 @@ namespace imago
 		OriginalImageWidth = OriginalImageHeight = ImageWidth = ImageHeight = 0;
 		ImageAlreadyBinarized = false; // we don't know yet
 		ClusterIndex = 0; // default
+		FilterIndex = 0;
 		StartTime = TimeLimit = 0;
+		MaxThreads = 0; // auto
+		LoadMaxDimension = 0; // full size
+		CancelFlag = NULL;
 		ExpandAbbreviations = true;
+		ValidateAbbreviations = false;
 	}
 
-	imago::Settings::Settings()
+	imago::SettingsConfig::SettingsConfig(GeneralSettings& general)
 	{
 		const char pattern = 0x6F;
 
@@ -104,16 +111,70 @@ namespace imago
 			#undef APPLY
 		}
 	}
-	
+
+	// the defaults are built once, all the default settings share them
+	struct SettingsDefaults
+	{
+		GeneralSettings general;
+		std::shared_ptr<SettingsConfig> config;
+
+		SettingsDefaults()
+		{
+			config = std::make_shared<SettingsConfig>(general);
+		}
+	};
+
+	static const SettingsDefaults& _getDefaults()
+	{
+		static const SettingsDefaults defaults;
+		return defaults;
+	}
+
+	imago::Settings::Settings() : general(_getDefaults().general), _config(_getDefaults().config)
+	{
+	}
+
+	// the config under the clusters and the cluster configs built on top of it,
+	// shared by the copies of Settings, so every cluster config is built once
+	struct ClusterConfigs
+	{
+		std::shared_ptr<SettingsConfig> base; // not changed after the cluster configs are shared
+		std::mutex lock;
+		std::vector<SharedSettingsDelta> files; // the config files the configs are built from
+		std::vector<std::shared_ptr<SettingsConfig> > configs;
+	};
+
+	SettingsConfig& imago::Settings::editConfig()
+	{
+		if (_clusterConfigs)
+		{
+			// the cluster configs are built again from the changed config
+			_restoreBaseConfig();
+			_clusterConfigs.reset();
+		}
+
+		// the other owners may read it from other threads
+		if (_config.use_count() != 1)
+			_config = std::make_shared<SettingsConfig>(*_config);
+		return *_config;
+	}
+
+	#define STRINGIZE_NX(A)   #A
+	#define STRINGIZE(A)      STRINGIZE_NX(A)
+	#define ASSIGN_REF(X)     entries[ (std::string)STRINGIZE(X) ] = DataTypeReference(X);
+
 	void imago::Settings::_fillReferenceMap(ReferenceAssignmentMap& entries)
 	{
-		#define STRINGIZE_NX(A)   #A
-		#define STRINGIZE(A)      STRINGIZE_NX(A)
-		#define ASSIGN_REF(X)     entries[ (std::string)STRINGIZE(X) ] = DataTypeReference(X);
+		editConfig()._fillReferenceMap(entries);
 
-		ASSIGN_REF(_configVersion);
 		ASSIGN_REF(general.ClusterIndex);
 		ASSIGN_REF(general.ImageAlreadyBinarized);
+		ASSIGN_REF(general.ValidateAbbreviations);
+	}
+
+	void imago::SettingsConfig::_fillReferenceMap(ReferenceAssignmentMap& entries)
+	{
+		ASSIGN_REF(_configVersion);
 
 		// DO NOT FORGET TO ADD REFERENCES TO ALL NEW VARIABLES HERE!
 
@@ -342,144 +403,78 @@ namespace imago
 		ASSIGN_REF(retinex.StartIteration);
 	}
 
+	#undef ASSIGN_REF
+	#undef STRINGIZE
+	#undef STRINGIZE_NX
+
 	bool imago::Settings::fillFromDataStream(const std::string& data)
 	{
 		logEnterFunction();
 
-		int ok_vars = 0, bad_vars = 0;
-
-		ReferenceAssignmentMap entries;
-		_fillReferenceMap(entries);
-
-		std::vector<std::string> lines;
-		std::string buffer;
-		for (size_t u = 0; u < data.size(); u++)
-		{
-			char c = data[u];
-			if (c == 10) // LF
-			{
-				lines.push_back(buffer);
-				buffer = "";
-			}
-			else if (c > 32)
-			{
-				buffer += c;
-			}
-		}
-		if (!buffer.empty())
-			lines.push_back(buffer);
-
-		for (size_t u = 0; u < lines.size(); u++)
-		{
-			std::string line = lines[u];
-
-			// cut lines after ';'
-			{
-				size_t p1 = line.find(';');
-				if (p1 != std::string::npos)
-					line = line.substr(0, p1);				
-			}
-
-			size_t p = line.find('=');
-			if (p != std::string::npos)
-			{
-				std::string variable = line.substr(0, p);
-				std::string value = line.substr(p+1);
-
-				// printf("[%s][%s]\n", variable.c_str(), value.c_str());
-
-				if (entries.find(variable) != entries.end())
-				{
-					// parse value
-					if (value.find('.') != std::string::npos) // double?
-					{
-						if (entries[variable].getType() == DataTypeReference::otDouble)
-						{
-							*entries[variable].getDouble() = atof(value.c_str());
-							ok_vars++;
-						}
-						else
-						{
-							getLogExt().append("Double value not expected for " + variable, value);
-							bad_vars++;
-						}
-					}
-					else
-					{
-						int v = atoi(value.c_str());
-						if (entries[variable].getType() == DataTypeReference::otInt)
-						{
-							*entries[variable].getInt() = v;
-							ok_vars++;
-						}
-						else if (entries[variable].getType() == DataTypeReference::otBool)
-						{
-							*entries[variable].getBool() = (v != 0);
-							ok_vars++;
-						}
-						else
-						{
-							getLogExt().append("Value not expected for " + variable, value);
-							bad_vars++;
-						}
-					}
-				}
-				else
-				{
-					getLogExt().append("Unknown variable from config", variable);
-					bad_vars++;
-				}
-			}
-		}
+		// the field table is compiled once, the text is parsed in one pass
+		SettingsDelta delta;
+		int bad_vars = delta.parse(data);
+		delta.apply(*this);
 
+		int ok_vars = (int)delta.size();
 		getLogExt().append("Loaded ok", ok_vars);
 		getLogExt().append("Errors", bad_vars);
 
 		return ok_vars > 0; // ? (bad_vars == 0)?
 	}
 
-	void imago::Settings::saveToDataStream(std::string& data)
+	void imago::Settings::saveToDataStream(std::string& data) const
 	{
 		logEnterFunction();
 
 		data = "";
 
-		ReferenceAssignmentMap entries;
-		_fillReferenceMap(entries);		
+		const SettingsSchema& schema = SettingsSchema::getInstance();
 		
-		for (ReferenceAssignmentMap::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		for (size_t u = 0; u < schema.size(); u++)
 		{			
 			char buffer[MAX_TEXT_LINE];
+			const char* name = schema.getField(u).name.c_str();
+			DataTypeReference ref = schema.getReference(*this, u);
 
-			switch (it->second.getType())
+			switch (ref.getType())
 			{
 			case DataTypeReference::otBool:
-				sprintf(buffer, "%s = %d;", it->first.c_str(), *(it->second.getBool()));
+				sprintf(buffer, "%s = %d;", name, *(ref.getBool()));
 				break;
 			case DataTypeReference::otInt:
-				sprintf(buffer, "%s = %i;", it->first.c_str(), *(it->second.getInt()));
+				sprintf(buffer, "%s = %i;", name, *(ref.getInt()));
 				break;
 			case DataTypeReference::otDouble:
-				sprintf(buffer, "%s = %f;", it->first.c_str(), *(it->second.getDouble()));
+				sprintf(buffer, "%s = %f;", name, *(ref.getDouble()));
 				break;
+			default:
+				continue;
 			}
 
 			data += buffer + platform::getLineEndings();
 		}
 	}
 
+	void imago::Settings::saveSnapshot(std::string& data) const
+	{
+		SettingsSchema::getInstance().saveSnapshot(*this, data);
+	}
+
+	bool imago::Settings::loadSnapshot(const std::string& data)
+	{
+		return SettingsSchema::getInstance().loadSnapshot(*this, data);
+	}
+
 	imago::RecognitionCaches::RecognitionCaches()
 	{
-		PCacheSymbolsRecognition = new RecognitionDistanceCacheType();
+		PCacheSymbolsRecognition = std::make_shared<RecognitionDistanceCacheType>();
+		PCacheLock = std::make_shared<std::mutex>();
+		PCacheMemory = std::shared_ptr<memory_budget::Reservation>(new memory_budget::Reservation(NULL, 0));
 	}
 
 	imago::RecognitionCaches::~RecognitionCaches()
 	{
-		if (PCacheSymbolsRecognition)
-		{
-			delete PCacheSymbolsRecognition;
-			PCacheSymbolsRecognition = NULL;
-		}
 	}
 
 	bool imago::Settings::forceSelectCluster(const std::string& clusterFileName)
@@ -487,25 +482,26 @@ namespace imago
 		logEnterFunction();
 		getLogExt().append("File", clusterFileName);
 
-		try
-		{
-			FileScanner input("%s", clusterFileName.c_str());
-
-			std::string stream;
-			input.readAll(stream);
-
-			return fillFromDataStream(stream);
-		}
-		catch(FileNotFoundException&)
+		// the file is parsed once and shared by all the recognitions
+		SharedSettingsDelta config = loadConfigFile(clusterFileName);
+		if (!config)
 		{
 			getLogExt().append("Can not open config file", clusterFileName);
+			return false;
 		}
 
-		return false;
+		config->apply(*this);
+
+		getLogExt().append("Loaded ok", (int)config->size());
+		getLogExt().append("Errors", config->errors());
+
+		return !config->empty();
 	}
 
 	bool imago::Settings::checkTimeLimit() const
 	{
+		if (general.CancelFlag && general.CancelFlag->load())
+			return true;
 		if (!general.TimeLimit || !general.StartTime)
 			return false;
 		else
@@ -514,6 +510,8 @@ namespace imago
 
 	bool imago::Settings::checkTimeLimit()
 	{
+		if (general.CancelFlag && general.CancelFlag->load())
+			return true;
 		if (general.TimeLimit)
 		{
 			if (!general.StartTime)
@@ -523,15 +521,114 @@ namespace imago
 		return false;
 	}
 
+	void imago::Settings::resetRecognitionState()
+	{
+		general.FilterIndex = 0;
+		general.OriginalImageWidth = general.OriginalImageHeight = 0;
+		general.ImageWidth = general.ImageHeight = 0;
+		general.ImageAlreadyBinarized = false;
+		dynamic = DynamicEstimationSettings();
+		features = ImageFeatures();
+
+		if (_clusterModel)
+		{
+			// the cluster of the previous image must not affect the filters of this one
+			_restoreBaseConfig();
+			general.ClusterIndex = 0;
+		}
+	}
+
+	void imago::Settings::_restoreBaseConfig()
+	{
+		if (_clusterConfigs)
+			_config = _clusterConfigs->base;
+	}
+
+	void imago::Settings::setClusterModel(const std::shared_ptr<const ClusterModel>& model)
+	{
+		_restoreBaseConfig();
+		_clusterConfigs.reset();
+		_clusterModel = model;
+
+		if (_clusterModel)
+		{
+			// created before the settings are copied to the threads, so they share the cluster configs
+			_clusterConfigs = std::make_shared<ClusterConfigs>();
+			_clusterConfigs->base = _config;
+		}
+	}
+
+	const std::shared_ptr<const ClusterModel>& imago::Settings::getClusterModel() const
+	{
+		return _clusterModel;
+	}
+
+	// returns the base config with the cluster config file applied, NULL if the file is empty or missing
+	static std::shared_ptr<SettingsConfig> _getClusterConfig(ClusterConfigs& clusters, int cluster, const std::string& fileName)
+	{
+		getLogExt().append("File", fileName);
+
+		SharedSettingsDelta file = loadConfigFile(fileName);
+		if (!file)
+		{
+			getLogExt().append("Can not open config file", fileName);
+			return std::shared_ptr<SettingsConfig>();
+		}
+		if (file->empty())
+			return std::shared_ptr<SettingsConfig>();
+
+		std::lock_guard<std::mutex> lock(clusters.lock);
+
+		if ((int)clusters.configs.size() <= cluster)
+		{
+			clusters.files.resize(cluster + 1);
+			clusters.configs.resize(cluster + 1);
+		}
+
+		// built again if the file is changed
+		if (clusters.files[cluster] != file)
+		{
+			std::shared_ptr<SettingsConfig> config = std::make_shared<SettingsConfig>(*clusters.base);
+			file->apply(*config);
+			clusters.files[cluster] = file;
+			clusters.configs[cluster] = config;
+		}
+
+		return clusters.configs[cluster];
+	}
+
 	void imago::Settings::selectBestCluster()
 	{
 		logEnterFunction();
 
-		/* TODO: clusters auto-detection logic
-			int longestSide = std::max(general.OriginalImageWidth, general.OriginalImageHeight);
-			...
-			general.ClusterIndex = ct;
-		}*/
+		if (!_clusterModel)
+			return; // the current constants
+
+		// every image starts from the same config, whatever was selected for the previous one
+		_restoreBaseConfig();
+		general.ClusterIndex = 0; // 0 is the default constants
+
+		if (!features.Valid)
+			return;
+
+		int cluster = _clusterModel->select(features);
+		if (cluster < 0)
+			return;
 
+		getLogExt().append("Selected cluster", cluster);
+
+		if (!_clusterConfigs)
+		{
+			_clusterConfigs = std::make_shared<ClusterConfigs>();
+			_clusterConfigs->base = _config;
+		}
+
+		// the state fields of the cluster file are skipped, the binarization flag belongs to the image
+		std::shared_ptr<SettingsConfig> config = _getClusterConfig(*_clusterConfigs, cluster, _clusterModel->getConfigFile(cluster));
+		if (config)
+		{
+			_config = config;
+			general.ClusterIndex = cluster + 1;
+		}
 	}
 }
@@ -16,11 +16,18 @@
 #ifndef _settings_h
 #define _settings_h
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "recognition_distance.h"
 #include "reference_object.h"
+#include "image_features.h"
+#include "memory_budget.h"
 
 namespace imago
 {
+	class ClusterModel;
+
 	/// ------------------ cluster-independ settings ------------------ ///
 
 	struct GeneralSettings
@@ -33,12 +40,16 @@ namespace imago
 		int    ImageHeight;
 		int    StartTime;
 		int    TimeLimit;		
+		int    MaxThreads; // 0 - use all hardware threads
+		int    LoadMaxDimension; // larger images are reduced while decoding, 0 - load at full size
+		const std::atomic<bool>* CancelFlag; // recognition is aborted at time limit checkpoints when set
 		bool   LogEnabled;
 		bool   LogVFSEnabled;		
 		bool   ExtractCharactersOnly;
 		bool   UseProbablistics;		
 		bool   ImageAlreadyBinarized;
 		bool   ExpandAbbreviations;
+		bool   ValidateAbbreviations; // compare native abbreviations expansion with Indigo
 		GeneralSettings();
 	};
 
@@ -50,9 +61,12 @@ namespace imago
 		DynamicEstimationSettings();
 	};
 
-	struct RecognitionCaches // caches for character recognizer, etc
+	struct RecognitionCaches // caches for character recognizer, etc; shared between settings copies
 	{
-		RecognitionDistanceCacheType* PCacheSymbolsRecognition;
+		std::shared_ptr<RecognitionDistanceCacheType> PCacheSymbolsRecognition;
+		std::shared_ptr<std::mutex> PCacheLock;
+		// the cache entries, charged to the process account only as the cache is shared by the sessions
+		std::shared_ptr<memory_budget::Reservation> PCacheMemory;
 		
 		RecognitionCaches();
 		virtual ~RecognitionCaches();
@@ -349,33 +363,15 @@ namespace imago
 
 	/// ------------------ end of cluster-depending settings ------------------ ///
 
-	struct Settings
+	// constants of the recognition: defaults, cluster configs and overrides;
+	// shared by all the copies of Settings and by all the threads, never changed after it is built
+	struct SettingsConfig
 	{
-		Settings(); // default constructor
-
-		// loads settings from file, etc.
-		bool fillFromDataStream(const std::string& data);
-
-		// stores settings into file, etc.
-		void saveToDataStream(std::string& data);
-
-		// should be called after general settings are filled
-		void selectBestCluster();
-
-		// loads configuration from file
-		bool forceSelectCluster(const std::string& clusterFileName);
-
-		// returns true if timelimit occures
-		bool checkTimeLimit();
-		bool checkTimeLimit() const;
+		// fills the defaults, the general fields of the defaults are assigned to 'general'
+		explicit SettingsConfig(GeneralSettings& general);
 
-		// general settings and caches - shouldn't be loaded from config
 		int _configVersion;
-		GeneralSettings general;
-		DynamicEstimationSettings dynamic;
-		RecognitionCaches caches;
 
-		// other settings, should be updated
 		PrefilterCVSettings prefilterCV;
 		MoleculeSettings molecule;
 		EstimationSettings estimation;
@@ -398,6 +394,90 @@ namespace imago
 
 		void _fillReferenceMap(ReferenceAssignmentMap& result);
 	};
+
+	typedef std::shared_ptr<const SettingsConfig> SharedSettingsConfig;
+
+	struct ClusterConfigs;
+
+	// per-recognition state plus the shared config, copying it does not copy the config
+	struct Settings
+	{
+		Settings(); // default constructor, shares the default config
+
+		// loads settings from file, etc.
+		bool fillFromDataStream(const std::string& data);
+
+		// stores settings into file, etc.
+		void saveToDataStream(std::string& data) const;
+
+		// binary copy of the config fields, restored without parsing;
+		// loading fails for snapshots of other versions
+		void saveSnapshot(std::string& data) const;
+		bool loadSnapshot(const std::string& data);
+
+		// sets the model used by selectBestCluster, NULL - no clusters;
+		// the cluster configs are applied on top of the current config
+		void setClusterModel(const std::shared_ptr<const ClusterModel>& model);
+		const std::shared_ptr<const ClusterModel>& getClusterModel() const;
+
+		// switches to the config of the cluster nearest to the image features,
+		// keeps the current constants if there is no cluster model
+		void selectBestCluster();
+
+		// resets the state left by the previous recognition: image sizes, filter index,
+		// features, dynamic estimates and the selected cluster; the deadline is kept
+		void resetRecognitionState();
+
+		// loads configuration from file
+		bool forceSelectCluster(const std::string& clusterFileName);
+
+		// returns true if timelimit occures
+		bool checkTimeLimit();
+		bool checkTimeLimit() const;
+
+		// general settings and caches - shouldn't be loaded from config
+		GeneralSettings general;
+		DynamicEstimationSettings dynamic;
+		RecognitionCaches caches;
+		ImageFeatures features; // of the source image, filled by prefilterEntrypoint if there is a cluster model
+
+		// the config constants, read-only
+		const SettingsConfig& config() const { return *_config; }
+		const PrefilterCVSettings& prefilterCV() const { return _config->prefilterCV; }
+		const MoleculeSettings& molecule() const { return _config->molecule; }
+		const EstimationSettings& estimation() const { return _config->estimation; }
+		const MainSettings& main() const { return _config->main; }
+		const MultipleBondSettings& mbond() const { return _config->mbond; }
+		const SkeletonSettings& skeleton() const { return _config->skeleton; }
+		const RoutinesSettings& routines() const { return _config->routines; }
+		const WeakSegmentatorSettings& weak_seg() const { return _config->weak_seg; }
+		const WedgeBondExtractorSettings& wbe() const { return _config->wbe; }
+		const CharactersRecognitionSettings& characters() const { return _config->characters; }
+		const ChemicalStructureRecognizerSettings& csr() const { return _config->csr; }
+		const GraphExtractorSettings& graph() const { return _config->graph; }
+		const ImageUtilsSettings& utils() const { return _config->utils; }
+		const SeparatorSettings& separator() const { return _config->separator; }
+		const LabelLogicSettings& labels() const { return _config->labels; }
+		const LabelCombinerSettings& lcomb() const { return _config->lcomb; }
+		const ProbabilitySettings& p_estimator() const { return _config->p_estimator; }
+		const LabelRemoverSettings& lab_remover() const { return _config->lab_remover; }
+		const RetinexFilterSettings& retinex() const { return _config->retinex; }
+
+		// the config of this copy for changing, it is copied first if it is shared;
+		// if a cluster is selected the changes go to the config under it
+		SettingsConfig& editConfig();
+
+		// references to the config fields and to the general fields loaded from config
+		void _fillReferenceMap(ReferenceAssignmentMap& result);
+
+	private:
+		// switches back from the selected cluster to the config under it
+		void _restoreBaseConfig();
+
+		std::shared_ptr<SettingsConfig> _config; // shared copies are not changed
+		std::shared_ptr<const ClusterModel> _clusterModel; // shared between settings copies, NULL by default
+		std::shared_ptr<ClusterConfigs> _clusterConfigs; // built from the config under the clusters, NULL if it is changed
+	};
 }
 
 #endif //_settings_h
@@ -0,0 +1,377 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "settings_schema.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include "settings.h"
+#include "scanner.h"
+#include "exception.h"
+#include "log_ext.h"
+
+namespace imago
+{
+	static const char SNAPSHOT_MAGIC[4] = { 'I', 'S', 'S', '1' };
+
+	static size_t _valueSize(DataTypeReference::ObjectType type)
+	{
+		switch (type)
+		{
+		case DataTypeReference::otBool:
+			return sizeof(bool);
+		case DataTypeReference::otInt:
+			return sizeof(int);
+		case DataTypeReference::otDouble:
+			return sizeof(double);
+		default:
+			return 0;
+		}
+	}
+
+	SettingsSchema::SettingsSchema()
+	{
+		Settings defaults;
+		ReferenceAssignmentMap entries;
+		defaults._fillReferenceMap(entries);
+
+		const char* base = (const char*)&defaults;
+		const char* config = (const char*)&defaults.config();
+		_signature = 14695981039346656037ULL; // FNV-1a
+		for (ReferenceAssignmentMap::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		{
+			const char* ptr = (const char*)it->second.getBool(); // the pointers share the union
+
+			Field field;
+			field.name = it->first;
+			field.type = it->second.getType();
+			field.state = (ptr >= base && ptr < base + sizeof(Settings));
+			field.offset = ptr - (field.state ? base : config);
+
+			_index[field.name] = (int)_fields.size();
+			_fields.push_back(field);
+
+			std::string key = field.name + (char)('0' + field.type);
+			for (size_t u = 0; u < key.size(); u++)
+			{
+				_signature ^= (unsigned char)key[u];
+				_signature *= 1099511628211ULL;
+			}
+		}
+	}
+
+	const SettingsSchema& SettingsSchema::getInstance()
+	{
+		static const SettingsSchema schema;
+		return schema;
+	}
+
+	size_t SettingsSchema::size() const
+	{
+		return _fields.size();
+	}
+
+	const SettingsSchema::Field& SettingsSchema::getField(size_t index) const
+	{
+		return _fields[index];
+	}
+
+	int SettingsSchema::find(const std::string& name) const
+	{
+		std::unordered_map<std::string, int>::const_iterator it = _index.find(name);
+		return (it != _index.end()) ? it->second : -1;
+	}
+
+	static char* _fieldPointer(const SettingsSchema::Field& field, Settings& vars)
+	{
+		if (field.state)
+			return (char*)&vars + field.offset;
+		return (char*)&vars.editConfig() + field.offset;
+	}
+
+	static const char* _fieldPointer(const SettingsSchema::Field& field, const Settings& vars)
+	{
+		if (field.state)
+			return (const char*)&vars + field.offset;
+		return (const char*)&vars.config() + field.offset;
+	}
+
+	static DataTypeReference _makeReference(DataTypeReference::ObjectType type, char* ptr)
+	{
+		switch (type)
+		{
+		case DataTypeReference::otBool:
+			return DataTypeReference(*(bool*)ptr);
+		case DataTypeReference::otInt:
+			return DataTypeReference(*(int*)ptr);
+		case DataTypeReference::otDouble:
+			return DataTypeReference(*(double*)ptr);
+		default:
+			return DataTypeReference();
+		}
+	}
+
+	DataTypeReference SettingsSchema::getReference(Settings& vars, size_t index) const
+	{
+		return _makeReference(_fields[index].type, _fieldPointer(_fields[index], vars));
+	}
+
+	DataTypeReference SettingsSchema::getReference(const Settings& vars, size_t index) const
+	{
+		return _makeReference(_fields[index].type, const_cast<char*>(_fieldPointer(_fields[index], vars)));
+	}
+
+	unsigned long long SettingsSchema::getSignature() const
+	{
+		return _signature;
+	}
+
+	void SettingsSchema::saveSnapshot(const Settings& vars, std::string& data) const
+	{
+		data.assign(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+		data.append((const char*)&_signature, sizeof(_signature));
+		for (size_t u = 0; u < _fields.size(); u++)
+			data.append(_fieldPointer(_fields[u], vars), _valueSize(_fields[u].type));
+	}
+
+	bool SettingsSchema::loadSnapshot(Settings& vars, const std::string& data) const
+	{
+		size_t pos = sizeof(SNAPSHOT_MAGIC) + sizeof(_signature);
+		if (data.size() < pos || memcmp(data.data(), SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+			return false;
+
+		unsigned long long signature;
+		memcpy(&signature, data.data() + sizeof(SNAPSHOT_MAGIC), sizeof(signature));
+		if (signature != _signature)
+			return false; // stored by another version
+
+		size_t total = pos;
+		for (size_t u = 0; u < _fields.size(); u++)
+			total += _valueSize(_fields[u].type);
+		if (data.size() != total)
+			return false;
+
+		for (size_t u = 0; u < _fields.size(); u++)
+		{
+			size_t size = _valueSize(_fields[u].type);
+			memcpy(_fieldPointer(_fields[u], vars), data.data() + pos, size);
+			pos += size;
+		}
+		return true;
+	}
+
+	///////////////////////////////////////////////////////
+
+	SettingsDelta::SettingsDelta() : _errors(0), _changesConfig(false)
+	{
+	}
+
+	SettingsDelta::SettingsDelta(const std::string& config) : _errors(0), _changesConfig(false)
+	{
+		parse(config);
+	}
+
+	int SettingsDelta::parse(const std::string& config)
+	{
+		const SettingsSchema& schema = SettingsSchema::getInstance();
+		int bad_vars = 0;
+
+		_assignments.clear();
+		_changesConfig = false;
+
+		std::string line;
+		for (size_t u = 0; u <= config.size(); u++)
+		{
+			char c = (u < config.size()) ? config[u] : 10;
+			if (c > 32)
+			{
+				line += c;
+				continue;
+			}
+			if (c != 10 || line.empty()) // LF
+				continue;
+
+			// cut lines after ';'
+			size_t p1 = line.find(';');
+			if (p1 != std::string::npos)
+				line.resize(p1);
+
+			size_t p = line.find('=');
+			if (p != std::string::npos)
+			{
+				std::string variable = line.substr(0, p);
+				const char* value = line.c_str() + p + 1;
+
+				int field = schema.find(variable);
+				if (field < 0)
+				{
+					getLogExt().append("Unknown variable from config", variable);
+					bad_vars++;
+				}
+				else
+				{
+					DataTypeReference::ObjectType type = schema.getField(field).type;
+					Assignment a;
+					a.field = field;
+					a.i_value = 0;
+					a.d_value = 0.0;
+
+					bool ok = true;
+					if (strchr(value, '.') != NULL) // double?
+					{
+						if (type == DataTypeReference::otDouble)
+							a.d_value = atof(value);
+						else
+						{
+							getLogExt().append("Double value not expected for " + variable, std::string(value));
+							ok = false;
+						}
+					}
+					else
+					{
+						if (type == DataTypeReference::otInt || type == DataTypeReference::otBool)
+							a.i_value = atoi(value);
+						else
+						{
+							getLogExt().append("Value not expected for " + variable, std::string(value));
+							ok = false;
+						}
+					}
+
+					if (ok)
+					{
+						_assignments.push_back(a);
+						if (!schema.getField(field).state)
+							_changesConfig = true;
+					}
+					else
+						bad_vars++;
+				}
+			}
+
+			line.clear();
+		}
+
+		_errors = bad_vars;
+		return bad_vars;
+	}
+
+	static void _assignValue(DataTypeReference::ObjectType type, char* ptr, int i_value, double d_value)
+	{
+		switch (type)
+		{
+		case DataTypeReference::otBool:
+			*(bool*)ptr = (i_value != 0);
+			break;
+		case DataTypeReference::otInt:
+			*(int*)ptr = i_value;
+			break;
+		case DataTypeReference::otDouble:
+			*(double*)ptr = d_value;
+			break;
+		default:
+			break;
+		}
+	}
+
+	void SettingsDelta::apply(Settings& vars) const
+	{
+		const SettingsSchema& schema = SettingsSchema::getInstance();
+		char* config = _changesConfig ? (char*)&vars.editConfig() : NULL;
+		for (size_t u = 0; u < _assignments.size(); u++)
+		{
+			const Assignment& a = _assignments[u];
+			const SettingsSchema::Field& field = schema.getField(a.field);
+			char* ptr = (field.state ? (char*)&vars : config) + field.offset;
+			_assignValue(field.type, ptr, a.i_value, a.d_value);
+		}
+	}
+
+	void SettingsDelta::apply(SettingsConfig& config) const
+	{
+		const SettingsSchema& schema = SettingsSchema::getInstance();
+		for (size_t u = 0; u < _assignments.size(); u++)
+		{
+			const Assignment& a = _assignments[u];
+			const SettingsSchema::Field& field = schema.getField(a.field);
+			if (field.state)
+				continue;
+
+			char* ptr = (char*)&config + field.offset;
+			_assignValue(field.type, ptr, a.i_value, a.d_value);
+		}
+	}
+
+	size_t SettingsDelta::size() const
+	{
+		return _assignments.size();
+	}
+
+	bool SettingsDelta::empty() const
+	{
+		return _assignments.empty();
+	}
+
+	int SettingsDelta::errors() const
+	{
+		return _errors;
+	}
+
+	///////////////////////////////////////////////////////
+
+	struct ConfigFileEntry
+	{
+		unsigned long long hash;
+		SharedSettingsDelta config;
+	};
+
+	SharedSettingsDelta loadConfigFile(const std::string& fileName)
+	{
+		static std::mutex lock;
+		static std::map<std::string, ConfigFileEntry> files;
+
+		// the text is read every time, the timestamps can miss changes within their resolution
+		std::string stream;
+		try
+		{
+			FileScanner input("%s", fileName.c_str());
+			input.readAll(stream);
+		}
+		catch (FileNotFoundException&)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			files.erase(fileName);
+			return SharedSettingsDelta();
+		}
+
+		unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+		for (size_t u = 0; u < stream.size(); u++)
+		{
+			hash ^= (unsigned char)stream[u];
+			hash *= 1099511628211ULL;
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		ConfigFileEntry& entry = files[fileName];
+		if (entry.config && entry.hash == hash)
+			return entry.config;
+
+		entry.hash = hash;
+		entry.config = std::make_shared<SettingsDelta>(stream);
+		return entry.config;
+	}
+}
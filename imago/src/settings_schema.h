@@ -0,0 +1,115 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _settings_schema_h
+#define _settings_schema_h
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "reference_object.h"
+
+namespace imago
+{
+	struct Settings;
+	struct SettingsConfig;
+
+	// table of the config fields of Settings, compiled once from _fillReferenceMap;
+	// fields are addressed by their offsets, so no map is built per call
+	class SettingsSchema
+	{
+	public:
+		struct Field
+		{
+			std::string name;
+			DataTypeReference::ObjectType type;
+			size_t offset; // in SettingsConfig, or in Settings for the state fields
+			bool state; // general field of Settings, not a part of the shared config
+		};
+
+		static const SettingsSchema& getInstance();
+
+		// fields are sorted by name
+		size_t size() const;
+		const Field& getField(size_t index) const;
+
+		// returns field index or -1
+		int find(const std::string& name) const;
+
+		// the config of 'vars' is copied if it is shared
+		DataTypeReference getReference(Settings& vars, size_t index) const;
+
+		// for reading only, the value must not be changed through it
+		DataTypeReference getReference(const Settings& vars, size_t index) const;
+
+		// identifies the set of fields, snapshots of other versions are rejected
+		unsigned long long getSignature() const;
+
+		// binary copy of all the fields
+		void saveSnapshot(const Settings& vars, std::string& data) const;
+		bool loadSnapshot(Settings& vars, const std::string& data) const;
+
+	private:
+		SettingsSchema();
+
+		std::vector<Field> _fields;
+		std::unordered_map<std::string, int> _index;
+		unsigned long long _signature;
+	};
+
+	// config text compiled into field assignments, applying it does no parsing
+	class SettingsDelta
+	{
+	public:
+		SettingsDelta();
+		explicit SettingsDelta(const std::string& config);
+
+		// parses "name = value;" lines, returns count of bad assignments
+		int parse(const std::string& config);
+
+		// the shared config of 'vars' is copied only if the delta changes config fields
+		void apply(Settings& vars) const;
+
+		// applies the config fields only, the state fields are skipped
+		void apply(SettingsConfig& config) const;
+
+		size_t size() const;
+		bool empty() const;
+
+		// count of bad assignments of the last parse
+		int errors() const;
+
+	private:
+		struct Assignment
+		{
+			int field;
+			int i_value;
+			double d_value;
+		};
+
+		std::vector<Assignment> _assignments;
+		int _errors;
+		bool _changesConfig;
+	};
+
+	typedef std::shared_ptr<const SettingsDelta> SharedSettingsDelta;
+
+	// config file compiled once and shared by all the threads and recognitions;
+	// it is parsed again only if the content of the file is changed, returns NULL if it can not be read
+	SharedSettingsDelta loadConfigFile(const std::string& fileName);
+}
+
+#endif // _settings_schema_h
@@ -32,19 +32,19 @@ Skeleton::Skeleton()
 {	
 }
 
-void Skeleton::setInitialAvgBondLength(Settings& vars, double avg_length )
+void Skeleton::setInitialAvgBondLength(const Settings& vars, double avg_length )
 {
    _avg_bond_length = avg_length;
-   double mult = vars.skeleton.BaseMult;
+   double mult = vars.skeleton().BaseMult;
 
    // TODO: depends on hard-set constants (something more adaptive required here)
 
-   if (_avg_bond_length < vars.skeleton.ShortBondLen)
-	   mult = vars.skeleton.ShortMul;
-   else if (_avg_bond_length < vars.skeleton.MediumBondLen)
-	   mult = vars.skeleton.MediumMul;
-   else if (_avg_bond_length < vars.skeleton.LongBondLen)
-	   mult = vars.skeleton.LongMul;
+   if (_avg_bond_length < vars.skeleton().ShortBondLen)
+	   mult = vars.skeleton().ShortMul;
+   else if (_avg_bond_length < vars.skeleton().MediumBondLen)
+	   mult = vars.skeleton().MediumMul;
+   else if (_avg_bond_length < vars.skeleton().LongBondLen)
+	   mult = vars.skeleton().LongMul;
    
    _addVertexEps = mult * _avg_bond_length;
 }
@@ -169,6 +169,13 @@ int Skeleton::getEdgesCount() const
    return (int)_g.edgeCount();
 }
 
+size_t Skeleton::estimateBytes() const
+{
+   // records with the index and adjacency entries
+   return _g.vertexCount() * (sizeof(VertexData) + 4 * sizeof(void*)) +
+          _g.edgeCount() * (sizeof(EdgeData) + 4 * sizeof(void*));
+}
+
 Bond Skeleton::getBondInfo( const Edge &e ) const
 {
    return _g.getEdgeBond(e);
@@ -192,12 +199,12 @@ void Skeleton::_repairBroken(const Settings& vars)
    // TODO: depends on hard-set constants (something more adaptive required here)
 
    double toSmallErr;
-   if (_avg_bond_length > vars.skeleton.LongBondLen)
-	   toSmallErr = vars.skeleton.LongSmallErr;
-   else if (_avg_bond_length > vars.skeleton.MediumBondLen)
-	   toSmallErr = vars.skeleton.MediumSmallErr;
+   if (_avg_bond_length > vars.skeleton().LongBondLen)
+	   toSmallErr = vars.skeleton().LongSmallErr;
+   else if (_avg_bond_length > vars.skeleton().MediumBondLen)
+	   toSmallErr = vars.skeleton().MediumSmallErr;
    else
-	   toSmallErr = vars.skeleton.BaseSmallErr;
+	   toSmallErr = vars.skeleton().BaseSmallErr;
 
    std::deque<Vertex> toRemove;
 
@@ -222,10 +229,10 @@ void Skeleton::_repairBroken(const Settings& vars)
           e2b.length < toSmallErr * _avg_bond_length)
          continue;
 
-	  coef = vars.skeleton.BrokenRepairCoef1;
-	  if (e1b.length < vars.skeleton.BrokenRepairFactor * toSmallErr * _avg_bond_length ||
-          e2b.length < vars.skeleton.BrokenRepairFactor * toSmallErr * _avg_bond_length)
-         coef = vars.skeleton.BrokenRepairCoef2;
+	  coef = vars.skeleton().BrokenRepairCoef1;
+	  if (e1b.length < vars.skeleton().BrokenRepairFactor * toSmallErr * _avg_bond_length ||
+          e2b.length < vars.skeleton().BrokenRepairFactor * toSmallErr * _avg_bond_length)
+         coef = vars.skeleton().BrokenRepairCoef2;
 
       Vec2d x_pos, y_pos, v_pos;
       x_pos = _g.getVertexPosition(x);
@@ -239,7 +246,7 @@ void Skeleton::_repairBroken(const Settings& vars)
       try
       {
          double angle = Vec2d::angle(v1, v2);
-		 if (angle > PI - coef * vars.skeleton.BrokenRepairAngleEps)
+		 if (angle > PI - coef * vars.skeleton().BrokenRepairAngleEps)
             found = true;
       }
       catch (DivizionByZeroException &)
@@ -320,7 +327,7 @@ void Skeleton::calcShortBondsPenalty(const Settings& vars)
 	logEnterFunction();
 
 	int probablyWarnings = 0;
-	int minSize = (std::max)((int)vars.dynamic.CapitalHeight / 2, vars.main.MinGoodCharactersSize);
+	int minSize = (std::max)((int)vars.dynamic.CapitalHeight / 2, vars.main().MinGoodCharactersSize);
    for (SkeletonGraph::edge_iterator begin_range = _g.edgeBegin(), end_range = _g.edgeEnd(); begin_range != end_range; ++begin_range)
 	{
       SkeletonGraph::edge_descriptor edge = *begin_range;
@@ -556,7 +563,7 @@ bool Skeleton::_dissolveIntermediateVertices (const Settings& vars)
    
    for (; vi != vi_end; ++vi)
    {
-	   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	   if (vars.checkTimeLimit()) throw TimeLimitException();
 
       const Vertex &vertex = *vi;
 
@@ -622,7 +629,7 @@ bool Skeleton::_dissolveIntermediateVertices (const Settings& vars)
       }
    }
    
-   if (min_err < vars.skeleton.DissolveMinErr) 
+   if (min_err < vars.skeleton().DissolveMinErr) 
    {
 	   _dissolvings++;
       
@@ -666,7 +673,7 @@ void Skeleton::_findMultiple(const Settings& vars)
       size_t end = toProcess.size();
       for (int ii = 0; ii < end; ii++)
       {
-		  if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+		  if (vars.checkTimeLimit()) throw TimeLimitException();
 
          Edge i = toProcess[ii];
          if (used[i])
@@ -697,7 +704,7 @@ void Skeleton::_findMultiple(const Settings& vars)
                for (SkeletonGraph::edge_iterator begin = _g.edgeBegin(), end = _g.edgeEnd(); begin != end; ++begin)
                {
                   SkeletonGraph::edge_descriptor k = *begin;
-                  if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+                  if (vars.checkTimeLimit()) throw TimeLimitException();
 
                   if (k == i || k == j ||
                       _g.getEdgeBond(k).type != BT_SINGLE ||
@@ -799,12 +806,12 @@ void Skeleton::_processInlineDoubleBond(const Settings& vars)
 	std::vector<Edge>::iterator it, foundIt;
 
 	double toSmallErr;
-   if (_avg_bond_length > vars.skeleton.LongBondLen)
-	   toSmallErr = vars.skeleton.LongSmallErr;
-   else if (_avg_bond_length > vars.skeleton.MediumBondLen)
-	   toSmallErr = vars.skeleton.MediumSmallErr;
+   if (_avg_bond_length > vars.skeleton().LongBondLen)
+	   toSmallErr = vars.skeleton().LongSmallErr;
+   else if (_avg_bond_length > vars.skeleton().MediumBondLen)
+	   toSmallErr = vars.skeleton().MediumSmallErr;
    else
-	   toSmallErr = vars.skeleton.BaseSmallErr;
+	   toSmallErr = vars.skeleton().BaseSmallErr;
    toSmallErr *= _avg_bond_length;
 
    for (SkeletonGraph::edge_iterator begin = _g.edgeBegin(), end = _g.edgeEnd(); begin != end; ++begin)
@@ -825,7 +832,7 @@ void Skeleton::_processInlineDoubleBond(const Settings& vars)
 
 		for(it = singles.begin(); it != singles.end(); ++it)
 		{
-			if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+			if (vars.checkTimeLimit()) throw TimeLimitException();
 
 			Vec2d midOfSingle;
 
@@ -1095,10 +1102,10 @@ void Skeleton::_connectBridgedBonds(const Settings& vars)
 			bool found_kFactor = false;
 			for(size_t i=0 ; i < kFactor.size() ; i++)
 			{
-				if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+				if (vars.checkTimeLimit()) throw TimeLimitException();
 
-				if(fabs(slope - kFactor[i]) < vars.skeleton.SlopeFact1 ||
-					fabs(fabs(slope - kFactor[i]) - PI)< vars.skeleton.SlopeFact2)
+				if(fabs(slope - kFactor[i]) < vars.skeleton().SlopeFact1 ||
+					fabs(fabs(slope - kFactor[i]) - PI)< vars.skeleton().SlopeFact2)
 				{
 					edge_groups_k[i].push_back(edge);
 					found_kFactor = true;
@@ -1136,7 +1143,7 @@ void Skeleton::_connectBridgedBonds(const Settings& vars)
 
 			for(int l = k + 1;l<gr_count;l++)
 			{
-				if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+				if (vars.checkTimeLimit()) throw TimeLimitException();
 
 				Vec2d sp1 = getVertexPos(getBondBegin(edge_groups_k[i][l]));
 				Vec2d sp2 = getVertexPos(getBondEnd(edge_groups_k[i][l]));
@@ -1147,7 +1154,7 @@ void Skeleton::_connectBridgedBonds(const Settings& vars)
 				double min = d1 < d2 ? d1 : d2;
 
 				double LineS = vars.dynamic.LineThickness;
-				double blockS = LineS * vars.skeleton.ConnectBlockS;
+				double blockS = LineS * vars.skeleton().ConnectBlockS;
 
 				Vec2d nearP1, nearP2;
 				if(d1 < d2)
@@ -1163,7 +1170,7 @@ void Skeleton::_connectBridgedBonds(const Settings& vars)
 				else
 					nearP2 = sp2;
 
-				if(min < blockS && min > vars.skeleton.ConnectFactor * LineS && 
+				if(min < blockS && min > vars.skeleton().ConnectFactor * LineS && 
 					Algebra::SegmentsOnSameLine(vars, p1, p2, sp1, sp2) &&
 					_isSegmentIntersectedByEdge(vars, nearP1, nearP2, otherE))
 				{
@@ -1258,23 +1265,23 @@ void Skeleton::modifyGraph(Settings& vars)
 
    //RecognitionSettings &rs = getSettings();
 
-	_parLinesEps = vars.estimation.ParLinesEps;
+	_parLinesEps = vars.estimation().ParLinesEps;
 
    recalcAvgBondLength();
 
-   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+   if (vars.checkTimeLimit()) throw TimeLimitException();
 
    getLogExt().appendSkeleton(vars, "init", _g);
 
-   _joinVertices(vars.skeleton.JoinVerticiesConst);
+   _joinVertices(vars.skeleton().JoinVerticiesConst);
 
-   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+   if (vars.checkTimeLimit()) throw TimeLimitException();
 
    recalcAvgBondLength();
 
    _vertices_big_degree.clear();
 
-   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+   if (vars.checkTimeLimit()) throw TimeLimitException();
    
    for (SkeletonGraph::vertex_iterator begin = _g.vertexBegin(), end = _g.vertexEnd(); begin != end; ++begin)
    {
@@ -1288,16 +1295,16 @@ void Skeleton::modifyGraph(Settings& vars)
 
    getLogExt().appendSkeleton(vars, "after join verticies", _g);
 
-   while (_dissolveShortEdges(vars.skeleton.DissolveConst))
+   while (_dissolveShortEdges(vars.skeleton().DissolveConst))
    {
-	   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	   if (vars.checkTimeLimit()) throw TimeLimitException();
    }
 
    getLogExt().appendSkeleton(vars, "after dissolve short edges", _g);
 
    while (_dissolveIntermediateVertices(vars))
    {
-	   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	   if (vars.checkTimeLimit()) throw TimeLimitException();
    }
 
    recalcAvgBondLength();
@@ -1308,29 +1315,29 @@ void Skeleton::modifyGraph(Settings& vars)
 
     _findMultiple(vars);
 
-	if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	if (vars.checkTimeLimit()) throw TimeLimitException();
     
 	getLogExt().appendSkeleton(vars, "after find multiple", _g);
 
 	_connectBridgedBonds(vars);
 
-	if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+	if (vars.checkTimeLimit()) throw TimeLimitException();
 
 	getLogExt().appendSkeleton(vars, "after connecting bridge bonds", _g);
 
     recalcAvgBondLength();
    
-	while (_dissolveShortEdges(vars.skeleton.Dissolve2Const))
+	while (_dissolveShortEdges(vars.skeleton().Dissolve2Const))
 	{
-		if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+		if (vars.checkTimeLimit()) throw TimeLimitException();
 	}
 
 	getLogExt().appendSkeleton(vars, "after dissolve edges 2", _g);
 
     recalcAvgBondLength();
 
-	_joinVertices(vars.skeleton.Join2Const);
-	_joinVertices(vars.skeleton.Join3Const);
+	_joinVertices(vars.skeleton().Join2Const);
+	_joinVertices(vars.skeleton().Join3Const);
 
     //Shrinking short bonds (dots)
     std::vector<Edge> edgesToRemove;
@@ -1342,7 +1349,7 @@ void Skeleton::modifyGraph(Settings& vars)
        Vec2d beg_pos = _g.getVertexPosition(beg);
        const Vec2d &end_pos = _g.getVertexPosition(end);
        if (_g.getDegree(beg) == 1 && _g.getDegree(end) == 1 &&
-           _g.getEdgeBond(edge).length < vars.skeleton.ShrinkEps * _avg_bond_length)
+           _g.getEdgeBond(edge).length < vars.skeleton().ShrinkEps * _avg_bond_length)
        {
           beg_pos.add(end_pos);
           beg_pos.scale(0.5); // average
@@ -1369,8 +1376,8 @@ void Skeleton::modifyGraph(Settings& vars)
 
 	double distTresh = vars.dynamic.CapitalHeight;
 
-	   if (distTresh > _avg_bond_length/vars.skeleton.DistTreshLimFactor)
-		   distTresh = _avg_bond_length/vars.skeleton.DistTreshLimFactor;
+	   if (distTresh > _avg_bond_length/vars.skeleton().DistTreshLimFactor)
+		   distTresh = _avg_bond_length/vars.skeleton().DistTreshLimFactor;
 
 	   std::vector<Skeleton::Edge> bad_edges;
       for (SkeletonGraph::edge_iterator begin_range = _g.edgeBegin(), end_range = _g.edgeEnd(); begin_range != end_range; ++begin_range)
@@ -1386,7 +1393,7 @@ void Skeleton::modifyGraph(Settings& vars)
             for (SkeletonGraph::vertex_iterator range_begin = _g.vertexBegin(), range_end = _g.vertexEnd(); range_begin != range_end; ++range_begin)
 			   {
                SkeletonGraph::vertex_descriptor v = *range_begin;
-				   if (vars.checkTimeLimit()) throw ImagoException("Timelimit exceeded");
+				   if (vars.checkTimeLimit()) throw TimeLimitException();
 
 				   if (v != beg && v != end)
 				   {
@@ -95,6 +95,8 @@ namespace imago
 
       int getVerticesCount() const;
       int getEdgesCount() const;
+      // approximate memory of the graph records, for the memory budget
+      size_t estimateBytes() const;
       const Vec2d &getVertexPos(Vertex v1) const;
       BondType getBondType(const Edge &e) const;
       Bond getBondInfo(const Edge &e) const;
@@ -102,7 +104,7 @@ namespace imago
 
       void reverseEdge(const Edge &e);
 
-      void setInitialAvgBondLength(Settings& vars, double avg_length );
+      void setInitialAvgBondLength(const Settings& vars, double avg_length );
       void recalcAvgBondLength();
       double bondLength() const { return _avg_bond_length; } 
       
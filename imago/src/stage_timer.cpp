@@ -0,0 +1,77 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "stage_timer.h"
+
+namespace imago
+{
+	namespace stage_timer
+	{
+#if (_MSC_VER >= 1800)
+		static __declspec(thread) StageTimes* _sink = NULL;
+		static __declspec(thread) ScopedStage* _current = NULL;
+#else
+		static thread_local StageTimes* _sink = NULL;
+		static thread_local ScopedStage* _current = NULL;
+#endif
+
+		void setSink(StageTimes* times)
+		{
+			_sink = times;
+		}
+
+		StageTimes* getSink()
+		{
+			return _sink;
+		}
+
+		ScopedStage::ScopedStage(const char* name) : _sink(stage_timer::_sink), _parent(NULL), _elapsed(0.0)
+		{
+			if (_sink != NULL)
+				start(name);
+		}
+
+		ScopedStage::ScopedStage(const std::string& name) : _sink(stage_timer::_sink), _parent(NULL), _elapsed(0.0)
+		{
+			if (_sink != NULL)
+				start(name);
+		}
+
+		void ScopedStage::start(const std::string& name)
+		{
+			_name = name;
+			_start = Clock::now();
+			_parent = _current;
+			_current = this;
+
+			// pause the outer stage
+			if (_parent != NULL)
+				_parent->_elapsed += std::chrono::duration<double, std::milli>(_start - _parent->_start).count();
+		}
+
+		ScopedStage::~ScopedStage()
+		{
+			if (_sink == NULL)
+				return;
+
+			Clock::time_point now = Clock::now();
+			_elapsed += std::chrono::duration<double, std::milli>(now - _start).count();
+			(*_sink)[_name] += _elapsed;
+
+			_current = _parent;
+			if (_parent != NULL)
+				_parent->_start = now; // resume the outer stage
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _stage_timer_h
+#define _stage_timer_h
+
+#include <chrono>
+#include <map>
+#include <string>
+
+// accounts the current scope as the named pipeline stage, if stage timing is enabled for the thread
+#define logStageTime(name) imago::stage_timer::ScopedStage _stage(name)
+
+namespace imago
+{
+	namespace stage_timer
+	{
+		// milliseconds spent in every stage
+		typedef std::map<std::string, double> StageTimes;
+
+		// starts accumulating stage times of the calling thread into 'times', NULL stops it;
+		// unlike log_ext profiling it works without logging and costs nothing when disabled
+		void setSink(StageTimes* times);
+		StageTimes* getSink();
+
+		// nested stages are exclusive: the time of the inner stage is not added to the outer one
+		class ScopedStage
+		{
+		public:
+			ScopedStage(const char* name);
+			ScopedStage(const std::string& name);
+			~ScopedStage();
+
+		private:
+			typedef std::chrono::steady_clock Clock;
+
+			void start(const std::string& name);
+
+			StageTimes* _sink;
+			ScopedStage* _parent;
+			std::string _name;
+			Clock::time_point _start;
+			double _elapsed;
+
+			ScopedStage(const ScopedStage&);
+			ScopedStage& operator=(const ScopedStage&);
+		};
+	}
+}
+
+#endif // _stage_timer_h
@@ -0,0 +1,232 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "structure_export.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include "indigo.h"
+#include "molecule.h"
+#include "superatom.h"
+#include "log_ext.h"
+
+namespace imago
+{
+	static double getLabelQuality(const Superatom& satom)
+	{
+		double result = -1;
+		for (size_t a = 0; a < satom.atoms.size(); a++)
+		{
+			const CharactersRecognitionGroup& labels = satom.atoms[a].labels;
+			for (size_t c = 0; c < labels.size(); c++)
+			{
+				if (labels[c].alternatives.empty())
+					continue; // exact value, not recognized
+				double q = labels[c].alternatives.getQuality();
+				if (result < 0 || q < result)
+					result = q;
+			}
+		}
+		return result;
+	}
+
+	static bool isRGroup(const Atom& a)
+	{
+		return a.getLabelFirst() == 'R' && a.getLabelSecond() == 0;
+	}
+
+	// the same text as the superatom label in MolfileSaver output, without escapes
+	static std::string getAbbreviationText(const Superatom& satom)
+	{
+		std::string result;
+		char buffer[32];
+		for (size_t a = 0; a < satom.atoms.size(); a++)
+		{
+			const Atom& atom = satom.atoms[a];
+			if (atom.isotope > 0)
+			{
+				// the mass number precedes the element, as "\S13" does in MolfileSaver
+				sprintf(buffer, "%d", atom.isotope);
+				result += buffer;
+			}
+			result += atom.getPrintableForm(false);
+			if (isRGroup(atom))
+				continue;
+			if (atom.count > 1)
+			{
+				sprintf(buffer, "%d", atom.count);
+				result += buffer;
+			}
+			if (atom.charge != 0)
+			{
+				sprintf(buffer, "%d%c", abs(atom.charge), atom.charge > 0 ? '+' : '-');
+				result += buffer;
+			}
+		}
+		return result;
+	}
+
+	void exportMolecule(const Settings& vars, const Molecule& mol, ExportedStructure& out)
+	{
+		logEnterFunction();
+
+		out.clear();
+
+		/*const*/ Skeleton::SkeletonGraph& graph = const_cast<Skeleton::SkeletonGraph&>(mol.getSkeleton());
+		const Molecule::ChemMapping& labels = mol.getMappedLabels();
+		std::map<Skeleton::Vertex, int> mapping;
+		double bond_length = vars.dynamic.AvgBondLength;
+
+		out.atoms.reserve(graph.vertexCount());
+		for (Skeleton::SkeletonGraph::vertex_iterator begin = graph.vertexBegin(), end = graph.vertexEnd(); begin != end; ++begin)
+		{
+			Skeleton::SkeletonGraph::vertex_descriptor v = *begin;
+			mapping[v] = (int)out.atoms.size();
+
+			ExportedAtom atom;
+			Vec2d pos = graph.getVertexPosition(v);
+			atom.x = pos.x / bond_length;
+			atom.y = -pos.y / bond_length;
+
+			Molecule::ChemMapping::const_iterator it = labels.find(v);
+			if (it == labels.end())
+			{
+				atom.label = "C";
+			}
+			else
+			{
+				const Label& l = *it->second;
+				const Superatom& satom = l.satom;
+
+				if (!l.multiline)
+				{
+					atom.x = (l.rect.x + l.rect.width / 2.0) / bond_length;
+					atom.y = -(l.rect.y + l.rect.height / 2.0) / bond_length;
+				}
+
+				if (satom.atoms.size() == 1)
+				{
+					// R-group index is a part of the label
+					const Atom& a = satom.atoms[0];
+					atom.label = a.getPrintableForm(false);
+					if (!isRGroup(a))
+						atom.charge = a.charge;
+					atom.isotope = a.isotope;
+				}
+				else
+				{
+					atom.label = getAbbreviationText(satom);
+				}
+
+				atom.quality = getLabelQuality(satom);
+			}
+
+			out.atoms.push_back(atom);
+		}
+
+		out.bonds.reserve(graph.edgeCount());
+		for (Skeleton::SkeletonGraph::edge_iterator begin = graph.edgeBegin(), end = graph.edgeEnd(); begin != end; ++begin)
+		{
+			Skeleton::SkeletonGraph::edge_descriptor e = *begin;
+			const Bond bond = graph.getEdgeBond(e);
+
+			ExportedBond b;
+			b.begin = mapping.find(e.m_source)->second;
+			b.end = mapping.find(e.m_target)->second;
+
+			switch (bond.type)
+			{
+			case BT_SINGLE_UP:
+				b.order = BT_SINGLE;
+				b.stereo = 1;
+				break;
+			case BT_SINGLE_DOWN:
+				b.order = BT_SINGLE;
+				b.stereo = 3;
+				break;
+			default:
+				b.order = bond.type;
+				break;
+			}
+
+			out.bonds.push_back(b);
+		}
+	}
+
+	bool exportMolfile(const std::string& molfile, ExportedStructure& out)
+	{
+		logEnterFunction();
+
+		out.clear();
+
+		indigoSetOption("treat-x-as-pseudoatom", "true");
+		indigoSetOption("ignore-stereochemistry-errors", "true");
+
+		int mol = indigoLoadMoleculeFromString(molfile.c_str());
+		if (mol == -1)
+			return false;
+
+		int atoms = indigoIterateAtoms(mol);
+		for (int item = indigoNext(atoms); item > 0; item = indigoNext(atoms))
+		{
+			ExportedAtom atom;
+			const char* symbol = indigoSymbol(item);
+			if (symbol)
+				atom.label = symbol;
+			int charge = 0;
+			if (indigoCharge(item, &charge) == 1)
+				atom.charge = charge;
+			atom.isotope = indigoIsotope(item);
+			float* xyz = indigoXYZ(item);
+			if (xyz)
+			{
+				atom.x = xyz[0];
+				atom.y = xyz[1];
+			}
+			out.atoms.push_back(atom);
+			indigoFree(item);
+		}
+		indigoFree(atoms);
+
+		int bonds = indigoIterateBonds(mol);
+		for (int item = indigoNext(bonds); item > 0; item = indigoNext(bonds))
+		{
+			ExportedBond bond;
+			int source = indigoSource(item);
+			int destination = indigoDestination(item);
+			bond.begin = indigoIndex(source);
+			bond.end = indigoIndex(destination);
+			indigoFree(source);
+			indigoFree(destination);
+
+			bond.order = indigoBondOrder(item);
+			switch (indigoBondStereo(item))
+			{
+			case INDIGO_UP:
+				bond.stereo = 1;
+				break;
+			case INDIGO_DOWN:
+				bond.stereo = 3;
+				break;
+			}
+			out.bonds.push_back(bond);
+			indigoFree(item);
+		}
+		indigoFree(bonds);
+
+		indigoFree(mol);
+		return true;
+	}
+}
@@ -0,0 +1,67 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _structure_export_h
+#define _structure_export_h
+
+#include <string>
+#include <vector>
+#include "settings.h"
+
+namespace imago
+{
+	class Molecule;
+
+	struct ExportedAtom
+	{
+		std::string label; // element symbol or abbreviation text, "C" for implicit carbons
+		int charge, isotope;
+		double x, y;       // in average bond length units, y axis directed up (as in molfile)
+		double quality;    // worst recognition quality of the label characters, -1 if not recognized
+
+		ExportedAtom() : charge(0), isotope(0), x(0), y(0), quality(-1) { }
+	};
+
+	struct ExportedBond
+	{
+		int begin, end; // atom indices
+		int order;      // 1 - single, 2 - double, 3 - triple, 4 - aromatic
+		int stereo;     // 0 - none, 1 - up, 3 - down (molfile V3000 CFG values)
+
+		ExportedBond() : begin(0), end(0), order(1), stereo(0) { }
+	};
+
+	struct ExportedStructure
+	{
+		std::vector<ExportedAtom> atoms;
+		std::vector<ExportedBond> bonds;
+
+		void clear()
+		{
+			atoms.clear();
+			bonds.clear();
+		}
+	};
+
+	// fills the structure straight from the recognized molecule,
+	// atoms order and coordinates are the same as in MolfileSaver output
+	void exportMolecule(const Settings& vars, const Molecule& mol, ExportedStructure& out);
+
+	// fills the structure from a molfile using Indigo (e.g. the expanded superatoms form),
+	// returns false if the molfile could not be loaded
+	bool exportMolfile(const std::string& molfile, ExportedStructure& out);
+}
+
+#endif // _structure_export_h
@@ -20,13 +20,48 @@
 #include "output.h"
 #include "molfile_saver.h"
 #include "log_ext.h"
+#include "structure_export.h"
+#include "abbreviation_expander.h"
+#include "stage_timer.h"
 
 namespace imago
 {
 
+// canonical SMILES without stereo: equal strings mean the same atoms and connectivity
+static std::string connectivityKey(const std::string& molfile)
+{
+   std::string result;
+   int mol = indigoLoadMoleculeFromString(molfile.c_str());
+   if (mol == -1)
+      return result;
+   indigoClearStereocenters(mol);
+   indigoClearCisTrans(mol);
+   const char* smiles = indigoCanonicalSmiles(mol);
+   if (smiles != NULL)
+      result = smiles;
+   indigoFree(mol);
+   return result;
+}
+
 std::string expandSuperatoms(const Settings& vars, const Molecule &molecule )
 {
    logEnterFunction();
+   logStageTime("serialize");
+
+   std::string nativeMolfile;
+   if (vars.general.ExpandAbbreviations)
+   {
+      ExportedStructure structure;
+      if (abbreviation_expander::expand(vars, molecule, structure))
+      {
+         ArrayOutput so(nativeMolfile);
+         MolfileSaver ma(so);
+         ma.saveStructure(structure);
+
+         if (!vars.general.ValidateAbbreviations)
+            return nativeMolfile;
+      }
+   }
 
    std::string molString;
    ArrayOutput so(molString);
@@ -57,6 +92,18 @@ std::string expandSuperatoms(const Settings& vars, const Molecule &molecule )
    std::string newMolfile = indigoMolfile(mol);
    indigoFree(mol);
 
+   if (!nativeMolfile.empty())
+   {
+      // validation mode: both expansions should give the same structure
+      std::string nativeKey = connectivityKey(nativeMolfile), indigoKey = connectivityKey(newMolfile);
+      if (nativeKey.empty() || nativeKey != indigoKey)
+      {
+         getLogExt().append("Native expansion", nativeKey);
+         getLogExt().append("Indigo expansion", indigoKey);
+         fprintf(stderr, "Abbreviations expansion mismatch: %s instead of %s\n", nativeKey.c_str(), indigoKey.c_str());
+      }
+   }
+
    return newMolfile;
 }
 
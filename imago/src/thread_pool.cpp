@@ -0,0 +1,96 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "thread_pool.h"
+#include "parallel_tools.h"
+
+namespace imago
+{
+	ThreadPool::ThreadPool(int threads)
+	{
+		_running = 0;
+		_stop = false;
+
+		if (threads <= 0)
+			threads = parallel_tools::getHardwareThreads();
+
+		for (int t = 0; t < threads; t++)
+			_workers.push_back(std::thread(&ThreadPool::_workerLoop, this, t));
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_taskAvailable.notify_all();
+
+		for (size_t u = 0; u < _workers.size(); u++)
+			_workers[u].join();
+	}
+
+	void ThreadPool::enqueue(const Task& task)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_tasks.push_back(task);
+		}
+		_taskAvailable.notify_one();
+	}
+
+	void ThreadPool::wait()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (!_tasks.empty() || _running > 0)
+			_allDone.wait(lock);
+	}
+
+	void ThreadPool::_workerLoop(int worker)
+	{
+		for (;;)
+		{
+			Task task;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				while (_tasks.empty() && !_stop)
+					_taskAvailable.wait(lock);
+
+				// the queue is drained before stopping
+				if (_tasks.empty())
+					return;
+
+				task = _tasks.front();
+				_tasks.pop_front();
+				_running++;
+			}
+
+			try
+			{
+				task(worker);
+			}
+			catch (...)
+			{
+				// tasks are responsible for reporting their own errors
+			}
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_running--;
+				if (_tasks.empty() && _running == 0)
+					_allDone.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,65 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _thread_pool_h
+#define _thread_pool_h
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace imago
+{
+	// fixed size pool of worker threads processing a FIFO queue of tasks
+	class ThreadPool
+	{
+	public:
+		// task receives the index of the worker thread [0 .. size()-1],
+		// so callers can keep per-worker state (contexts, sessions, etc)
+		typedef std::function<void(int worker)> Task;
+
+		// threads <= 0 means all hardware threads
+		ThreadPool(int threads);
+
+		// waits for all enqueued tasks and joins the workers
+		~ThreadPool();
+
+		int size() const { return (int)_workers.size(); }
+
+		void enqueue(const Task& task);
+
+		// blocks until the queue is empty and no task is running
+		void wait();
+
+	private:
+		void _workerLoop(int worker);
+
+		std::vector<std::thread> _workers;
+		std::deque<Task> _tasks;
+		std::mutex _mutex;
+		std::condition_variable _taskAvailable;
+		std::condition_variable _allDone;
+		size_t _running;
+		bool _stop;
+
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+	};
+}
+
+#endif // _thread_pool_h
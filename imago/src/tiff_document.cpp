@@ -0,0 +1,182 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "tiff_document.h"
+
+#include <algorithm>
+#include <mutex>
+#include <tiffio.h>
+#include "image.h"
+#include "exception.h"
+#include "log_ext.h"
+
+namespace imago
+{
+	// libtiff reports warnings (unknown tags etc.) to stderr through a process-wide handler,
+	// so it is replaced only while the documents are read, and restored for the application
+	class QuietTiffWarnings
+	{
+	public:
+		QuietTiffWarnings()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_users++ == 0)
+				_previous = TIFFSetWarningHandler(NULL);
+		}
+
+		~QuietTiffWarnings()
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_users == 0)
+				TIFFSetWarningHandler(_previous);
+		}
+
+	private:
+		static std::mutex _mutex;
+		static int _users;
+		static TIFFErrorHandler _previous;
+	};
+
+	std::mutex QuietTiffWarnings::_mutex;
+	int QuietTiffWarnings::_users = 0;
+	TIFFErrorHandler QuietTiffWarnings::_previous = NULL;
+
+	TiffDocument::TiffDocument() : _tiff(NULL)
+	{
+	}
+
+	TiffDocument::~TiffDocument()
+	{
+		close();
+	}
+
+	void TiffDocument::open(const std::string& fileName)
+	{
+		logEnterFunction();
+
+		close();
+
+		FILE* f = fopen(fileName.c_str(), "rb");
+		if (f == NULL)
+			throw FileNotFoundException(fileName.c_str());
+		fclose(f);
+
+		QuietTiffWarnings quiet;
+		_tiff = TIFFOpen(fileName.c_str(), "r");
+		if (_tiff == NULL)
+			throw ImagoException("Image file is not a valid TIFF: " + fileName);
+		_fileName = fileName;
+
+		do
+		{
+			uint32 type = 0;
+			if (!TIFFGetField(_tiff, TIFFTAG_SUBFILETYPE, &type) || (type & FILETYPE_REDUCEDIMAGE) == 0)
+				_directories.push_back(TIFFCurrentDirOffset(_tiff));
+		} while (TIFFReadDirectory(_tiff));
+
+		getLogExt().append("Pages count", _directories.size());
+	}
+
+	void TiffDocument::close()
+	{
+		if (_tiff != NULL)
+			TIFFClose(_tiff);
+		_tiff = NULL;
+		_fileName.clear();
+		_directories.clear();
+	}
+
+	bool TiffDocument::isOpen() const
+	{
+		return _tiff != NULL;
+	}
+
+	const std::string& TiffDocument::getFileName() const
+	{
+		return _fileName;
+	}
+
+	int TiffDocument::getPageCount() const
+	{
+		return (int)_directories.size();
+	}
+
+	void TiffDocument::readPage(int page, Image& img)
+	{
+		logEnterFunction();
+
+		if (_tiff == NULL)
+			throw ImagoException("TIFF document is not open");
+		if (page < 0 || page >= (int)_directories.size())
+			throw ImagoException("Page index is out of range");
+
+		QuietTiffWarnings quiet;
+		if (!TIFFSetSubDirectory(_tiff, (toff_t)_directories[page]))
+			throw ImagoException("TIFF page directory can not be read");
+
+		char message[1024] = "";
+		TIFFRGBAImage rgba;
+		if (!TIFFRGBAImageOK(_tiff, message) || !TIFFRGBAImageBegin(&rgba, _tiff, 0, message))
+			throw ImagoException(std::string("Unsupported TIFF page: ") + message);
+
+		rgba.req_orientation = ORIENTATION_TOPLEFT;
+		uint32 width = rgba.width, height = rgba.height;
+
+		// whole strips or tile rows are converted at once, so each of them is decoded only once
+		uint32 chunk = 0;
+		if (!TIFFGetField(_tiff, TIFFIsTiled(_tiff) ? TIFFTAG_TILELENGTH : TIFFTAG_ROWSPERSTRIP, &chunk) || chunk == 0 || chunk > height)
+			chunk = height;
+
+		img.init((int)width, (int)height);
+		std::vector<uint32> raster((size_t)width * chunk);
+
+		bool ok = true;
+		for (uint32 row = 0; row < height && ok; row += chunk)
+		{
+			uint32 rows = std::min(chunk, height - row);
+			rgba.row_offset = (int)row;
+			rgba.col_offset = 0;
+			ok = TIFFRGBAImageGet(&rgba, &raster[0], width, rows) != 0;
+
+			for (uint32 y = 0; y < rows; y++)
+			{
+				const uint32* in = &raster[(size_t)y * width];
+				byte* out = img.ptr((int)(row + y));
+				for (uint32 x = 0; x < width; x++)
+				{
+					uint32 v = in[x];
+					out[x] = (TIFFGetA(v) == 0) ? 255 : (byte)((30 * TIFFGetR(v) + 59 * TIFFGetG(v) + 11 * TIFFGetB(v)) / 100);
+				}
+			}
+		}
+		TIFFRGBAImageEnd(&rgba);
+
+		if (!ok)
+			throw ImagoException("TIFF page data is invalid");
+	}
+
+	int TiffDocument::countPages(const std::string& fileName)
+	{
+		try
+		{
+			TiffDocument document;
+			document.open(fileName);
+			return document.getPageCount();
+		}
+		catch (std::exception&)
+		{
+			return 0;
+		}
+	}
+}
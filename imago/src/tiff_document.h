@@ -0,0 +1,61 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _tiff_document_h
+#define _tiff_document_h
+
+#include <string>
+#include <vector>
+
+typedef struct tiff TIFF;
+
+namespace imago
+{
+	class Image;
+
+	// multi-page TIFF file read with libtiff, the pages are decoded one at a time on request
+	class TiffDocument
+	{
+	public:
+		TiffDocument();
+		~TiffDocument();
+
+		// reads the directories only, throws if the file is not a readable TIFF
+		void open(const std::string& fileName);
+		void close();
+
+		bool isOpen() const;
+		const std::string& getFileName() const;
+
+		// reduced-resolution (thumbnail) directories are not counted as pages
+		int getPageCount() const;
+
+		// decodes the page to grayscale strip by strip, transparent pixels become white
+		void readPage(int page, Image& img);
+
+		// count of pages, 0 if the file is not a readable TIFF
+		static int countPages(const std::string& fileName);
+
+	private:
+		TIFF* _tiff;
+		std::string _fileName;
+		std::vector<unsigned long long> _directories; // directory offset of every page, to seek to it directly
+
+		TiffDocument(const TiffDocument&);
+		TiffDocument& operator=(const TiffDocument&);
+	};
+}
+
+#endif // _tiff_document_h
@@ -0,0 +1,204 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "trace_sink.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace imago
+{
+	namespace trace_sink
+	{
+		static const std::chrono::steady_clock::time_point _epoch = std::chrono::steady_clock::now();
+
+		static std::atomic<unsigned long long> _recorders(0);
+		static std::atomic<int> _threads(0);
+		static std::atomic<unsigned long long> _requests(0);
+		static std::atomic<double> _sampleRate(0.0);
+
+#if (_MSC_VER >= 1800)
+		static __declspec(thread) Recorder* _current = NULL;
+		static __declspec(thread) int _tid = 0;
+		// the buffer of the last recorder used by the thread
+		static __declspec(thread) unsigned long long _cachedRecorder = 0;
+		static __declspec(thread) void* _cachedBuffer = NULL;
+#else
+		static thread_local Recorder* _current = NULL;
+		static thread_local int _tid = 0;
+		// the buffer of the last recorder used by the thread
+		static thread_local unsigned long long _cachedRecorder = 0;
+		static thread_local void* _cachedBuffer = NULL;
+#endif
+
+		unsigned long long now()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _epoch).count();
+		}
+
+		Recorder::Recorder(size_t eventsPerThread) : _capacity(eventsPerThread > 0 ? eventsPerThread : 1)
+		{
+			_id = ++_recorders;
+		}
+
+		Recorder::ThreadBuffer* Recorder::_getThreadBuffer()
+		{
+			if (_cachedRecorder == _id)
+				return (ThreadBuffer*)_cachedBuffer;
+
+			if (_tid == 0)
+				_tid = ++_threads;
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			ThreadBuffer* buffer = NULL;
+			for (size_t u = 0; u < _buffers.size(); u++)
+				if (_buffers[u]->tid == _tid)
+					buffer = _buffers[u].get();
+
+			if (buffer == NULL)
+			{
+				_buffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+				buffer = _buffers.back().get();
+				buffer->tid = _tid;
+				buffer->next = 0;
+				buffer->wrapped = false;
+				buffer->events.reserve(std::min(_capacity, (size_t)1024));
+			}
+
+			_cachedRecorder = _id;
+			_cachedBuffer = buffer;
+			return buffer;
+		}
+
+		void Recorder::addScope(const char* name, unsigned long long start, unsigned long long end)
+		{
+			ThreadBuffer* buffer = _getThreadBuffer();
+
+			Event event;
+			event.name = name;
+			event.start = start;
+			event.duration = end - start;
+
+			if (buffer->events.size() < _capacity)
+			{
+				buffer->events.push_back(event);
+			}
+			else
+			{
+				buffer->events[buffer->next] = event;
+				buffer->next = (buffer->next + 1) % _capacity;
+				buffer->wrapped = true;
+			}
+		}
+
+		static void _appendEscaped(std::string& out, const char* text)
+		{
+			for (; *text; text++)
+			{
+				if (*text == '"' || *text == '\\')
+					out += '\\';
+				out += ((unsigned char)*text < 0x20) ? ' ' : *text;
+			}
+		}
+
+		void Recorder::writeJson(std::string& out) const
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			char buf[128];
+			out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+			bool first = true;
+
+			for (size_t b = 0; b < _buffers.size(); b++)
+			{
+				const ThreadBuffer& buffer = *_buffers[b];
+
+				sprintf(buf, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+				        first ? "" : ",", buffer.tid, buffer.tid);
+				out += buf;
+				first = false;
+
+				if (buffer.wrapped)
+				{
+					sprintf(buf, ",\n{\"name\":\"events dropped\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%llu}",
+					        buffer.tid, buffer.events[buffer.next].start);
+					out += buf;
+				}
+
+				// oldest first
+				for (size_t u = 0; u < buffer.events.size(); u++)
+				{
+					const Event& event = buffer.events[(buffer.next + u) % buffer.events.size()];
+					out += ",\n{\"name\":\"";
+					_appendEscaped(out, event.name);
+					sprintf(buf, "\",\"cat\":\"imago\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu}",
+					        buffer.tid, event.start, event.duration);
+					out += buf;
+				}
+			}
+
+			out += "\n]}\n";
+		}
+
+		bool Recorder::storeToFile(const std::string& filename) const
+		{
+			std::string json;
+			writeJson(json);
+
+			FILE* f = fopen(filename.c_str(), "wb");
+			if (f == NULL)
+				return false;
+			bool result = fwrite(json.data(), 1, json.size(), f) == json.size();
+			fclose(f);
+			return result;
+		}
+
+		Recorder* current()
+		{
+			return _current;
+		}
+
+		ScopedRecording::ScopedRecording(Recorder* recorder) : _previous(_current)
+		{
+			_current = recorder;
+		}
+
+		ScopedRecording::~ScopedRecording()
+		{
+			_current = _previous;
+		}
+
+		void setSampleRate(double rate)
+		{
+			_sampleRate = (rate < 0.0) ? 0.0 : (rate > 1.0 ? 1.0 : rate);
+		}
+
+		double getSampleRate()
+		{
+			return _sampleRate;
+		}
+
+		bool shouldSample()
+		{
+			double rate = _sampleRate;
+			if (rate <= 0.0)
+				return false;
+
+			unsigned long long n = _requests++;
+			return std::floor((n + 1) * rate) > std::floor(n * rate);
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ *
+ * This file is part of Imago toolkit.
+ *
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _trace_sink_h
+#define _trace_sink_h
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace imago
+{
+	namespace trace_sink
+	{
+		// microseconds from the process start, monotonic
+		unsigned long long now();
+
+		// timeline of the logEnterFunction scopes of one request in Chrome trace format;
+		// every thread writes into its own ring buffer, the oldest scopes are dropped on overflow
+		class Recorder
+		{
+		public:
+			Recorder(size_t eventsPerThread = 65536);
+
+			// 'name' should be a string literal (e.g. __FUNCTION__), it is not copied
+			void addScope(const char* name, unsigned long long start, unsigned long long end);
+
+			// should be called when the request is done, i.e. no thread writes anymore
+			void writeJson(std::string& out) const;
+			bool storeToFile(const std::string& filename) const;
+
+		private:
+			struct Event
+			{
+				const char* name;
+				unsigned long long start, duration;
+			};
+
+			struct ThreadBuffer
+			{
+				int tid;
+				std::vector<Event> events;
+				size_t next; // ring position
+				bool wrapped;
+			};
+
+			ThreadBuffer* _getThreadBuffer();
+
+			size_t _capacity;
+			unsigned long long _id; // distinguishes recorders in the per-thread caches
+			std::vector<std::unique_ptr<ThreadBuffer> > _buffers;
+			mutable std::mutex _mutex;
+
+			Recorder(const Recorder&);
+			Recorder& operator=(const Recorder&);
+		};
+
+		// recorder attached to the calling thread or NULL
+		Recorder* current();
+
+		// attaches the recorder (may be NULL) to the calling thread until the scope ends
+		class ScopedRecording
+		{
+		public:
+			ScopedRecording(Recorder* recorder);
+			~ScopedRecording();
+		private:
+			Recorder* _previous;
+		};
+
+		// fraction of requests to trace in [0..1], 0 (default) disables tracing
+		void setSampleRate(double rate);
+		double getSampleRate();
+
+		// deterministic sampling: returns true for every 1/rate-th request
+		bool shouldSample();
+	}
+}
+
+#endif // _trace_sink_h
@@ -12,31 +12,191 @@
  * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
  ***************************************************************************/
 
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
 #include "virtual_fs.h"
 #include "output.h"
+#include "exception.h"
 
 namespace imago
 {
+	const size_t VirtualFSRecord::CHUNK_SIZE;
+
+	VirtualFSRecord::VirtualFSRecord()
+	{
+		_size = 0;
+		_compress = false;
+		_cachedIndex = (size_t)-1;
+	}
+
+	size_t VirtualFSRecord::size() const
+	{
+		return _size;
+	}
+
+	void VirtualFSRecord::setCompression(bool enabled)
+	{
+		_compress = enabled;
+	}
+
+	void VirtualFSRecord::append(const unsigned char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			if (_chunks.empty() || _chunks.back().compressed || _chunks.back().size == CHUNK_SIZE)
+			{
+				if (!_chunks.empty())
+					_pack(_chunks.back());
+				_chunks.push_back(VirtualFSChunk());
+				_chunks.back().size = 0;
+				_chunks.back().compressed = false;
+				_chunks.back().bytes.reserve(CHUNK_SIZE);
+			}
+
+			VirtualFSChunk& chunk = _chunks.back();
+			size_t part = std::min(size, CHUNK_SIZE - chunk.size);
+			chunk.bytes.insert(chunk.bytes.end(), data, data + part);
+			chunk.size += part;
+			_size += part;
+			data += part;
+			size -= part;
+		}
+	}
+
+	void VirtualFSRecord::finish()
+	{
+		if (!_chunks.empty())
+			_pack(_chunks.back());
+	}
+
+	void VirtualFSRecord::_pack(VirtualFSChunk& chunk)
+	{
+		if (!_compress || chunk.compressed || chunk.size == 0)
+			return;
+
+		uLongf packedSize = compressBound((uLong)chunk.size);
+		std::vector<unsigned char> packed(packedSize);
+		if (compress2(&packed[0], &packedSize, &chunk.bytes[0], (uLong)chunk.size, Z_BEST_SPEED) != Z_OK)
+			return;
+
+		// PNG images and such do not shrink, do not waste time on the rest of the record
+		if (packedSize > chunk.size * 9 / 10)
+		{
+			_compress = false;
+			return;
+		}
+
+		packed.resize(packedSize);
+		chunk.bytes.swap(packed);
+		chunk.compressed = true;
+	}
+
+	const unsigned char* VirtualFSRecord::_unpack(size_t index) const
+	{
+		const VirtualFSChunk& chunk = _chunks[index];
+		if (!chunk.compressed)
+			return chunk.bytes.empty() ? NULL : &chunk.bytes[0];
+
+		if (_cachedIndex != index)
+		{
+			_cache.resize(chunk.size);
+			uLongf size = (uLongf)chunk.size;
+			if (uncompress(&_cache[0], &size, &chunk.bytes[0], (uLong)chunk.bytes.size()) != Z_OK || size != chunk.size)
+				throw ImagoException("VirtualFS chunk is corrupted");
+			_cachedIndex = index;
+		}
+		return &_cache[0];
+	}
+
+	void VirtualFSRecord::forEachChunk(const std::function<void(const unsigned char*, size_t)>& consumer) const
+	{
+		for (size_t u = 0; u < _chunks.size(); u++)
+		{
+			if (_chunks[u].size > 0)
+				consumer(_unpack(u), _chunks[u].size);
+		}
+	}
+
+	size_t VirtualFSRecord::read(size_t offset, unsigned char* buffer, size_t count) const
+	{
+		size_t copied = 0;
+		size_t start = 0;
+		for (size_t u = 0; u < _chunks.size() && copied < count; u++)
+		{
+			size_t end = start + _chunks[u].size;
+			if (offset < end)
+			{
+				size_t from = offset - start;
+				size_t part = std::min(count - copied, _chunks[u].size - from);
+				memcpy(buffer + copied, _unpack(u) + from, part);
+				copied += part;
+				offset += part;
+			}
+			start = end;
+		}
+		return copied;
+	}
+
+	void VirtualFSRecord::getData(std::vector<unsigned char>& output) const
+	{
+		output.clear();
+		output.reserve(_size);
+		forEachChunk([&output](const unsigned char* data, size_t size)
+		{
+			output.insert(output.end(), data, data + size);
+		});
+	}
+
+	///////////////////////////////////////////////////////
+
+	VirtualFS::VirtualFS()
+	{
+		_compression = false;
+		_lastAppended = 0;
+	}
+
+	void VirtualFS::setCompression(bool enabled)
+	{
+		_compression = enabled;
+	}
+
 	bool VirtualFS::createNewFile(const std::string& filename, const std::string& data)
 	{
-		VirtualFSRecord rec;
+		return createNewFile(filename, (const unsigned char*)data.data(), data.size());
+	}
+
+	bool VirtualFS::createNewFile(const std::string& filename, const unsigned char* data, size_t size)
+	{
+		push_back(VirtualFSRecord());
+		VirtualFSRecord& rec = back();
 		rec.filename = filename;
-		rec.data.insert(rec.data.end(), data.begin(), data.end());
-		push_back(rec);
+		rec.setCompression(_compression);
+		rec.append(data, size);
+		rec.finish();
 		return true;
 	}
 
 	bool VirtualFS::appendData(const std::string& filename, const std::string& data)
 	{
+		if (_lastAppended < size() && at(_lastAppended).filename == filename)
+		{
+			at(_lastAppended).append((const unsigned char*)data.data(), data.size());
+			return true;
+		}
+
 		for (size_t u = 0; u < size(); u++)
 		{
 			if (filename == at(u).filename)
 			{
-				at(u).data.insert(at(u).data.end(), data.begin(), data.end());
+				at(u).append((const unsigned char*)data.data(), data.size());
+				_lastAppended = u;
 				return true;
 			}
 		}
 
+		_lastAppended = size();
 		return createNewFile(filename, data);
 	}
 
@@ -45,7 +205,10 @@ namespace imago
 		for (size_t u = 0; u < size(); u++)
 		{
 			FileOutput dump((folder + at(u).filename).c_str());
-			dump.write(&at(u).data.at(0), (int)at(u).data.size());
+			at(u).forEachChunk([&dump](const unsigned char* data, size_t size)
+			{
+				dump.write(data, (int)size);
+			});
 		}
 	}
 
@@ -53,6 +216,7 @@ namespace imago
 	{
 		clear();
 		bool name = true;
+		std::vector<unsigned char> decoded;
 		for (size_t idx = 0; idx < input.size(); )
 		{
 			size_t end = idx + 1;
@@ -63,16 +227,21 @@ namespace imago
 				VirtualFSRecord r;
 				for (size_t u = idx; u < end; u++)
 					r.filename += input[u];
+				r.setCompression(_compression);
 				push_back(r);
 			}
 			else
 			{
 				VirtualFSRecord& r = at(size() - 1);
+				decoded.clear();
 				for (size_t u = idx; u < end; u += 2)
 				{
 					unsigned char c = (input[u] - 'a') * 16 + (input[u+1] - 'a');
-					r.data.push_back(c);
+					decoded.push_back(c);
 				}
+				if (!decoded.empty())
+					r.append(&decoded[0], decoded.size());
+				r.finish();
 			}
 
 			idx = end+1;
@@ -80,6 +249,17 @@ namespace imago
 		}
 	}
 
+	static void _encodeChunk(const unsigned char* data, size_t size, std::vector<char>& output)
+	{
+		for (size_t v = 0; v < size; v++)
+		{
+			char c1 = 'a' + ((data[v] & 0xF0) / 16);
+			char c2 = 'a' +  (data[v] & 0x0F);
+			output.push_back(c1);
+			output.push_back(c2);
+		}
+	}
+
 	void VirtualFS::getData(std::vector<char>& output) const
 	{
 		output.clear();
@@ -87,14 +267,29 @@ namespace imago
 		{
 			output.insert(output.end(), at(u).filename.begin(), at(u).filename.end());
 			output.push_back('\n');
-			for (size_t v = 0; v < at(u).data.size(); v++)
+			at(u).forEachChunk([&output](const unsigned char* data, size_t size)
 			{
-				char c1 = 'a' + ((at(u).data.at(v) & 0xF0) / 16);
-				char c2 = 'a' +  (at(u).data.at(v) & 0x0F);
-				output.push_back(c1);
-				output.push_back(c2);
-			}
+				_encodeChunk(data, size, output);
+			});
 			output.push_back('\n');
 		}
 	}
-}
\ No newline at end of file
+
+	void VirtualFS::writeData(Output& output) const
+	{
+		std::vector<char> buffer;
+		buffer.reserve(2 * VirtualFSRecord::CHUNK_SIZE);
+		for (size_t u = 0; u < size(); u++)
+		{
+			output.write(at(u).filename.c_str(), (int)at(u).filename.size());
+			output.writeChar('\n');
+			at(u).forEachChunk([&output, &buffer](const unsigned char* data, size_t size)
+			{
+				buffer.clear();
+				_encodeChunk(data, size, buffer);
+				output.write(&buffer[0], (int)buffer.size());
+			});
+			output.writeChar('\n');
+		}
+	}
+}
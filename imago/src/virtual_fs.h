@@ -16,31 +16,92 @@
 #ifndef _virtual_fs_h
 #define _virtual_fs_h
 
+#include <functional>
 #include <string>
 #include <vector>
 
 namespace imago
 {
-	struct VirtualFSRecord
+	class Output;
+
+	struct VirtualFSChunk
+	{
+		std::vector<unsigned char> bytes;
+		size_t size; // uncompressed
+		bool compressed;
+	};
+
+	// file stored in chunks of CHUNK_SIZE bytes, so appending never reallocates
+	// the whole content; with compression full chunks are packed by zlib
+	class VirtualFSRecord
 	{
+	public:
+		static const size_t CHUNK_SIZE = 64 * 1024;
+
 		std::string filename;
-		std::vector<unsigned char> data;
+
+		VirtualFSRecord();
+
+		// uncompressed size
+		size_t size() const;
+
+		void append(const unsigned char* data, size_t size);
+
+		// the record is not going to be appended anymore, packs the last chunk
+		void finish();
+
+		void setCompression(bool enabled);
+
+		// calls 'consumer' for the parts of the content in order; packed chunks
+		// are unpacked one by one into a buffer of the chunk size
+		void forEachChunk(const std::function<void(const unsigned char*, size_t)>& consumer) const;
+
+		// copies up to 'count' bytes from 'offset', returns the count copied
+		size_t read(size_t offset, unsigned char* buffer, size_t count) const;
+
+		// whole content, for small records
+		void getData(std::vector<unsigned char>& output) const;
+
+	private:
+		void _pack(VirtualFSChunk& chunk);
+		const unsigned char* _unpack(size_t index) const;
+
+		std::vector<VirtualFSChunk> _chunks;
+		size_t _size;
+		bool _compress;
+
+		// the last unpacked chunk, sequential reads unpack every chunk once
+		mutable size_t _cachedIndex;
+		mutable std::vector<unsigned char> _cache;
 	};
 
 	class VirtualFS : public std::vector<VirtualFSRecord>
 	{
 	public:
+		VirtualFS();
+
+		// packs the finished parts of the records (disabled by default)
+		void setCompression(bool enabled);
+
 		bool createNewFile(const std::string& filename, const std::string& data);
-		bool appendData(const std::string& filename, const std::string& data);		
-		
+		bool createNewFile(const std::string& filename, const unsigned char* data, size_t size);
+		bool appendData(const std::string& filename, const std::string& data);
+
 		// gets internal data to external storage
 		void getData(std::vector<char>& output) const;
 
+		// same as getData, but streamed chunk by chunk
+		void writeData(Output& output) const;
+
 		// sets internal state by specified input
 		void setData(std::vector<char>& input);
-		
+
 		// if non-empty, the trailing slash is required
 		void storeOnDisk(const std::string& folder = "") const;
+
+	private:
+		bool _compression;
+		size_t _lastAppended; // the log is appended much more often than other files
 	};
 };
 
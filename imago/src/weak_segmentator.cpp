@@ -90,7 +90,7 @@ namespace imago
 	{
 		logEnterFunction();
 
-		int area_pixels = round(width() * height() * vars.weak_seg.RectangularCropAreaTreshold);
+		int area_pixels = round(width() * height() * vars.weak_seg().RectangularCropAreaTreshold);
 		for (size_t id = 1; id <= SegmentPoints.size(); id++)
 		{			
 			Rectangle bounds;
@@ -162,7 +162,7 @@ namespace imago
 						good++;
 					else
 						bad++;
-				if ((double)good / (good+bad) > vars.weak_seg.RectangularCropFitTreshold)
+				if ((double)good / (good+bad) > vars.weak_seg().RectangularCropFitTreshold)
 				{
 					bound = Rectangle((int)x1c, (int)y1c, (int)x2c, (int)y2c, 0);
 					return true;
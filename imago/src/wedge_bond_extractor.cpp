@@ -138,7 +138,7 @@ void WedgeBondExtractor::_fitSingleDownBorders( Vec2d &p1, Vec2d &p2, const Vec2
 int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
 {
    int sdb_count = 0;
-   double eps = vars.wbe.SingleDownEps, angle;   
+   double eps = vars.wbe().SingleDownEps, angle;   
 
    std::vector<SegCenter> segs_info;
    std::vector<Segment *> to_delete_segs;
@@ -163,7 +163,7 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
    for (size_t i = 0; i < segs_info.size(); i++)
       for (size_t j = i + 1; j < segs_info.size(); j++)
       {
-		  if (segs_info[i].used && segs_info[j].used && fabs(segs_info[i].angle - segs_info[j].angle) < vars.wbe.SomeTresh)
+		  if (segs_info[i].used && segs_info[j].used && fabs(segs_info[i].angle - segs_info[j].angle) < vars.wbe().SomeTresh)
          {
             Vec2d p1 = segs_info[i].center, p2 = segs_info[j].center;   
 
@@ -180,18 +180,18 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
                {
                   p3 = segs_info[k].center;
 
-				  if (absolute(p1.x - p2.x) <= vars.wbe.SingleDownCompareDist)
+				  if (absolute(p1.x - p2.x) <= vars.wbe().SingleDownCompareDist)
                   {
-                     if (absolute(p1.x - p3.x) <= vars.wbe.SingleDownCompareDist || absolute(p3.x - p2.x) <= vars.wbe.SingleDownCompareDist)
+                     if (absolute(p1.x - p3.x) <= vars.wbe().SingleDownCompareDist || absolute(p3.x - p2.x) <= vars.wbe().SingleDownCompareDist)
                      {
                         cur_points.push_back(segs_info[k]);
                         continue;
                      }
                   }
 
-                  if (absolute(p1.y - p2.y) <= vars.wbe.SingleDownCompareDist)
+                  if (absolute(p1.y - p2.y) <= vars.wbe().SingleDownCompareDist)
                   {
-                     if (absolute(p1.y - p3.y) <= vars.wbe.SingleDownCompareDist || absolute(p3.y - p2.y) <= vars.wbe.SingleDownCompareDist)
+                     if (absolute(p1.y - p3.y) <= vars.wbe().SingleDownCompareDist || absolute(p3.y - p2.y) <= vars.wbe().SingleDownCompareDist)
                      {
                         cur_points.push_back(segs_info[k]);
                         continue;
@@ -201,14 +201,14 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
                   double ch1 = (p1.x - p3.x) * (p2.y - p1.y);
                   double ch2 = (p1.x - p2.x) * (p3.y - p1.y);
 
-				  if (absolute(ch1 - ch2) <= vars.wbe.SingleDownAngleMax)
+				  if (absolute(ch1 - ch2) <= vars.wbe().SingleDownAngleMax)
                      cur_points.push_back(segs_info[k]);
                }
             }
 
-			std::sort(cur_points.begin(), cur_points.end(), PointsComparator(vars.wbe.PointsCompareDist));
+			std::sort(cur_points.begin(), cur_points.end(), PointsComparator(vars.wbe().PointsCompareDist));
 
-            if ((int)cur_points.size() >= vars.wbe.MinimalSingleDownSegsCount)
+            if ((int)cur_points.size() >= vars.wbe().MinimalSingleDownSegsCount)
             {
                std::vector<IntPair> same_dist_pairs;
                DoubleVector distances(cur_points.size() - 1);
@@ -223,7 +223,7 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
 
                   for (; l != (int)distances.size(); l++)
                   {
-					  if (fabs(distances[l - 1] - distances[l]) > vars.wbe.SingleDownDistancesMax)
+					  if (fabs(distances[l - 1] - distances[l]) > vars.wbe().SingleDownDistancesMax)
                         break;
                   }
 
@@ -250,7 +250,7 @@ int WedgeBondExtractor::singleDownFetch(const Settings& vars, Skeleton &g )
 
                      ave_dist /= p.second - p.first;
 
-					 if (ave_dist > vars.wbe.SingleDownLengthMax)
+					 if (ave_dist > vars.wbe().SingleDownLengthMax)
                         continue;
 
                      if (!segs_info[cur_points[p.first].seginfo_index].used ||
@@ -604,17 +604,17 @@ bool WedgeBondExtractor::_isSingleUp(const Settings& vars, Skeleton &g, const Sk
    int max_r = r1 > r2 ? r1 : r2;
    int min_r = r1 < r2 ? r1 : r2;
 
-   double coef = vars.wbe.SingleUpDefCoeff;
-   if (_bond_length < vars.wbe.SingleUpIncLengthTresh)
-	   coef = vars.wbe.SingleUpIncCoeff;
+   double coef = vars.wbe().SingleUpDefCoeff;
+   if (_bond_length < vars.wbe().SingleUpIncLengthTresh)
+	   coef = vars.wbe().SingleUpIncCoeff;
 
    if (Vec2d::distance(bb, ee) < _bond_length * coef)
       return false;
    double interpolation_factor = 0.1;
 
    Vec2d b(bb), e(ee);
-   b.interpolate(bb, ee, interpolation_factor); //vars.wbe.SingleUpInterpolateEps);
-   e.interpolate(ee, bb, interpolation_factor); //vars.wbe.SingleUpInterpolateEps);
+   b.interpolate(bb, ee, interpolation_factor); //vars.wbe().SingleUpInterpolateEps);
+   e.interpolate(ee, bb, interpolation_factor); //vars.wbe().SingleUpInterpolateEps);
    b.x = round(b.x);
    b.y = round(b.y);
    e.x = round(e.x);
@@ -643,7 +643,7 @@ bool WedgeBondExtractor::_isSingleUp(const Settings& vars, Skeleton &g, const Sk
       visited.push_back(cur);
 
       double dp = Vec2d::distance(cur, e);
-	  dp = sqrt(dp * dp + 1) + vars.wbe.SingleUpMagicAddition;
+	  dp = sqrt(dp * dp + 1) + vars.wbe().SingleUpMagicAddition;
       for (int i = round(cur.x) - 1; i <= round(cur.x) + 1; i++)
       {
          for (int j = round(cur.y) - 1; j <= round(cur.y) + 1; j++)
@@ -677,7 +677,7 @@ bool WedgeBondExtractor::_isSingleUp(const Settings& vars, Skeleton &g, const Sk
    getLogExt().appendImage("image profile", img);
 
    double y_mean = 0, x_mean = 0;
-   size_t startProfile = round(vars.wbe.SingleUpInterpolateEps * profile.size());
+   size_t startProfile = round(vars.wbe().SingleUpInterpolateEps * profile.size());
    size_t endProfile = profile.size() - startProfile;
    
    size_t psize = endProfile - startProfile;//(profile.size() - 1);
@@ -727,7 +727,7 @@ bool WedgeBondExtractor::_isSingleUp(const Settings& vars, Skeleton &g, const Sk
 		   _bfs_state[y * w + x] = 0;
    }
 
-   if( abs(b_coeff) > vars.wbe.SingleUpSlopeThresh && (y_mean > vars.dynamic.LineThickness || max_r / min_r > 2) )
+   if( abs(b_coeff) > vars.wbe().SingleUpSlopeThresh && (y_mean > vars.dynamic.LineThickness || max_r / min_r > 2) )
    {
 	   return_type = BT_SINGLE_UP;
 	   if( b_coeff < 0 )
@@ -735,7 +735,7 @@ bool WedgeBondExtractor::_isSingleUp(const Settings& vars, Skeleton &g, const Sk
 	   return true;
    }
    else
-	   if( y_mean / vars.dynamic.LineThickness > vars.wbe.SingleUpThickThresh)
+	   if( y_mean / vars.dynamic.LineThickness > vars.wbe().SingleUpThickThresh)
 	   {
 		   return_type = BT_WEDGE;
 		   return true;
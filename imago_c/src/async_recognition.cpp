@@ -0,0 +1,195 @@
+/****************************************************************************
+ * Copyright (C) 2009-2010 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include <map>
+
+#include "async_recognition.h"
+#include "batch_recognition.h"
+#include "indigo.h"
+#include "log_ext.h"
+#include "thread_pool.h"
+
+namespace imago
+{
+   AsyncJob::AsyncJob()
+   {
+      id = 0;
+      time_limit = 0;
+      callback = NULL;
+      user_data = NULL;
+      cancelled = false;
+      done = success = false;
+      warnings = 0;
+   }
+
+   namespace async_recognition
+   {
+      // executor threads live until the library is unloaded, every thread
+      // keeps its own context and Indigo session between jobs
+      class Executor
+      {
+      public:
+         Executor() : _pool(0)
+         {
+            _last_id = 0;
+            _contexts.resize(_pool.size(), NULL);
+         }
+
+         ~Executor()
+         {
+            // pending jobs are cancelled, running ones stop at the next checkpoint
+            {
+               std::lock_guard<std::mutex> lock(_jobs_mutex);
+               for (JobMap::value_type &item: _jobs)
+                  item.second->cancelled = true;
+            }
+            _pool.wait();
+
+            for (size_t u = 0; u < _contexts.size(); u++)
+               delete _contexts[u];
+         }
+
+         qword submit( const AsyncJobPtr &job )
+         {
+            {
+               std::lock_guard<std::mutex> lock(_jobs_mutex);
+               job->id = ++_last_id;
+               _jobs[job->id] = job;
+            }
+
+            _pool.enqueue([this, job](int worker)
+            {
+               _run(worker, *job);
+            });
+
+            return job->id;
+         }
+
+         AsyncJobPtr find( qword id )
+         {
+            std::lock_guard<std::mutex> lock(_jobs_mutex);
+            JobMap::iterator it = _jobs.find(id);
+            if (it == _jobs.end())
+               return AsyncJobPtr();
+            return it->second;
+         }
+
+         void release( qword id )
+         {
+            std::lock_guard<std::mutex> lock(_jobs_mutex);
+            JobMap::iterator it = _jobs.find(id);
+            if (it != _jobs.end())
+            {
+               it->second->cancelled = true;
+               _jobs.erase(it);
+            }
+         }
+
+      private:
+         void _run( int worker, AsyncJob &job )
+         {
+            bool success = false;
+            std::string molfile, error;
+            int warnings = 0;
+
+            if (job.cancelled)
+            {
+               error = "Recognition cancelled";
+            }
+            else
+            {
+               RecognitionContext *&context = _contexts[worker];
+               if (context == NULL)
+               {
+                  // executor threads are never released, so the session is kept
+                  qword sid = SessionManager::getInstance().allocSID();
+                  SessionManager::getInstance().setSID(sid);
+                  indigoSetSessionId(sid);
+                  context = acquireRecognitionContext();
+               }
+
+               // log is shared between all the threads
+               std::unique_lock<std::mutex> serial(_log_mutex, std::defer_lock);
+               if (getLogExt().loggingEnabled())
+                  serial.lock();
+
+               ImagoBatchItem item;
+               item.buf = job.buf.empty() ? NULL : &job.buf[0];
+               item.buf_size = job.buf.size();
+               item.file_name = job.file_name.empty() ? NULL : job.file_name.c_str();
+               item.time_limit = job.time_limit;
+
+               pipeline_counters::ScopedCounters counting(job.counters.get());
+               memory_budget::ScopedAccount accounting(job.memory.get());
+               batch_recognition::recognizeItem(*context, job.vars, item);
+
+               success = (item.error == NULL);
+               if (success)
+                  molfile.assign(item.molfile, item.molfile_size);
+               else if (job.cancelled)
+                  error = "Recognition cancelled";
+               else
+                  error = item.error;
+               warnings = item.warnings;
+
+               delete[] item.molfile;
+               delete[] item.error;
+            }
+
+            {
+               std::lock_guard<std::mutex> lock(job.mutex);
+               job.success = success;
+               job.molfile = molfile;
+               job.error = error;
+               job.warnings = warnings;
+               job.done = true;
+            }
+            job.finished.notify_all();
+
+            if (job.callback != NULL)
+               job.callback(job.id, success ? 1 : 0, job.user_data);
+         }
+
+         typedef std::map<qword, AsyncJobPtr> JobMap;
+         JobMap _jobs;
+         std::mutex _jobs_mutex;
+         qword _last_id;
+
+         std::mutex _log_mutex;
+         std::vector<RecognitionContext*> _contexts;
+         ThreadPool _pool; // declared last to be stopped first
+      };
+
+      static Executor &_getExecutor()
+      {
+         static Executor executor;
+         return executor;
+      }
+
+      qword submit( const AsyncJobPtr &job )
+      {
+         return _getExecutor().submit(job);
+      }
+
+      AsyncJobPtr find( qword id )
+      {
+         return _getExecutor().find(id);
+      }
+
+      void release( qword id )
+      {
+         _getExecutor().release(id);
+      }
+   }
+}
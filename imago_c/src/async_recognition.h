@@ -0,0 +1,77 @@
+/****************************************************************************
+ * Copyright (C) 2009-2010 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _async_recognition_h
+#define _async_recognition_h
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "imago_c.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
+#include "settings.h"
+
+namespace imago
+{
+   struct AsyncJob
+   {
+      qword id;
+
+      // inputs are copied, so the caller may free them right after submission
+      std::vector<char> buf;
+      std::string file_name;
+      int time_limit;
+      Settings vars;
+      std::shared_ptr<pipeline_counters::Counters> counters; // of the submitting instance
+      std::shared_ptr<memory_budget::Account> memory; // the budget of the submitting instance
+
+      ImagoCompletionCallback callback;
+      void *user_data;
+
+      std::atomic<bool> cancelled;
+
+      // guarded by mutex
+      std::mutex mutex;
+      std::condition_variable finished;
+      bool done;
+      bool success;
+      std::string molfile;
+      std::string error;
+      int warnings;
+
+      AsyncJob();
+   };
+
+   typedef std::shared_ptr<AsyncJob> AsyncJobPtr;
+
+   namespace async_recognition
+   {
+      // registers the job and schedules it on the shared executor, returns job id
+      qword submit( const AsyncJobPtr &job );
+
+      // returns NULL if there is no such job
+      AsyncJobPtr find( qword id );
+
+      // forgets the job, cancelling it if it is not finished yet
+      void release( qword id );
+   }
+}
+
+#endif /* _async_recognition_h */
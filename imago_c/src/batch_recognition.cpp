@@ -0,0 +1,167 @@
+/****************************************************************************
+ * Copyright (C) 2009-2010 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include <cstring>
+#include <vector>
+
+#include "batch_recognition.h"
+#include "indigo.h"
+#include "image_utils.h"
+#include "exception.h"
+#include "log_ext.h"
+#include "failsafe_png.h"
+#include "prefilter_entry.h"
+#include "superatom_expansion.h"
+#include "platform_tools.h"
+#include "thread_pool.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
+
+namespace imago
+{
+   namespace batch_recognition
+   {
+      static char *_copyString( const std::string &str )
+      {
+         char *result = new char[str.size() + 1];
+         memcpy(result, str.c_str(), str.size());
+         result[str.size()] = 0;
+         return result;
+      }
+
+      void recognizeItem( RecognitionContext &context, const Settings &config, ImagoBatchItem &item )
+      {
+         item.molfile = NULL;
+         item.molfile_size = 0;
+         item.warnings = 0;
+         item.error = NULL;
+
+         try
+         {
+            context.vars = config;
+            if (item.time_limit > 0)
+               context.vars.general.TimeLimit = item.time_limit;
+
+            // the deadline covers loading too
+            context.vars.general.StartTime = platform::TICKS();
+
+            if (item.buf != NULL)
+            {
+               int maxDimension = context.vars.general.LoadMaxDimension;
+               if (!failsafePngLoadBuffer((const unsigned char*)item.buf, item.buf_size, context.img_src, maxDimension))
+                  throw ImagoException("Image buffer decoding failed");
+               ImageUtils::fitMaxDimension(context.img_src, maxDimension);
+            }
+            else if (item.file_name != NULL)
+            {
+               ImageUtils::loadImageFromFile(context.img_src, std::string(item.file_name), context.vars.general.LoadMaxDimension);
+            }
+            else
+            {
+               throw ImagoException("No image specified for batch item");
+            }
+
+            memory_budget::Reservation filteredMemory(context.img_src.total()); // img_tmp
+            prefilterEntrypoint(context.vars, context.img_tmp, context.img_src);
+
+            context.csr.setImage(context.img_tmp);
+            context.csr.recognize(context.vars, context.mol);
+            item.warnings = context.mol.getWarningsCount() + context.mol.getDissolvingsCount() / context.vars.main().DissolvingsFactor;
+
+            context.molfile = expandSuperatoms(context.vars, context.mol);
+            item.molfile = _copyString(context.molfile);
+            item.molfile_size = context.molfile.size();
+         }
+         catch ( std::exception &e )
+         {
+            item.error = _copyString(e.what());
+         }
+         catch ( ... )
+         {
+            item.error = _copyString("Unknown recognition error");
+         }
+      }
+
+      struct BatchWorker
+      {
+         qword sid;
+         RecognitionContext *context;
+
+         BatchWorker()
+         {
+            sid = 0;
+            context = NULL;
+         }
+      };
+
+      void recognizeBatch( const Settings &config, ImagoBatchItem *items, int count, int workers )
+      {
+         if (count <= 0)
+            return;
+
+         // log is shared between all the threads
+         if (getLogExt().loggingEnabled())
+            workers = 1;
+
+         if (workers > count)
+            workers = count;
+
+         Settings workerConfig = config;
+         if (workers != 1)
+            workerConfig.general.MaxThreads = 1; // items are already processed in parallel
+
+         // the items are counted in the session of the caller and share its memory budget
+         pipeline_counters::Counters *counters = pipeline_counters::current();
+         memory_budget::Account *account = memory_budget::current();
+
+         std::vector<BatchWorker> states;
+         {
+            ThreadPool pool(workers);
+            states.resize(pool.size());
+
+            for (int i = 0; i < count; i++)
+            {
+               ImagoBatchItem *item = &items[i];
+               pool.enqueue([&states, &workerConfig, counters, account, item](int worker)
+               {
+                  pipeline_counters::ScopedCounters counting(counters);
+                  memory_budget::ScopedAccount accounting(account);
+                  BatchWorker &state = states[worker];
+                  if (state.context == NULL)
+                  {
+                     // Indigo is used for superatoms expansion, its session is per-thread
+                     state.sid = SessionManager::getInstance().allocSID();
+                     SessionManager::getInstance().setSID(state.sid);
+                     indigoSetSessionId(state.sid);
+                     state.context = acquireRecognitionContext();
+                  }
+                  recognizeItem(*state.context, workerConfig, *item);
+               });
+            }
+
+            pool.wait();
+         }
+
+         for (size_t u = 0; u < states.size(); u++)
+         {
+            if (states[u].context != NULL)
+            {
+               releaseRecognitionContext(states[u].context);
+               indigoReleaseSessionId(states[u].sid);
+               SessionManager::getInstance().releaseSID(states[u].sid);
+            }
+         }
+      }
+   }
+}
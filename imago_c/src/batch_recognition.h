@@ -0,0 +1,36 @@
+/****************************************************************************
+ * Copyright (C) 2009-2010 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+#ifndef _batch_recognition_h
+#define _batch_recognition_h
+
+#include "imago_c.h"
+#include "recognition_context.h"
+
+namespace imago
+{
+   namespace batch_recognition
+   {
+      // loads, filters and recognizes the item using the context buffers;
+      // context settings are reset from 'config' first, errors are stored in the item
+      void recognizeItem( RecognitionContext &context, const Settings &config, ImagoBatchItem &item );
+
+      // recognizes all items using up to 'workers' threads, each worker owns
+      // its own context and Indigo session for the whole batch
+      void recognizeBatch( const Settings &config, ImagoBatchItem *items, int count, int workers );
+   }
+}
+
+#endif /* _batch_recognition_h */
@@ -14,6 +14,7 @@
 
 #include <cstdio>
 #include <cstring>
+#include <memory>
 #include <string>
 
 #include "imago_c.h"
@@ -28,11 +29,18 @@
 #include "comdef.h"
 #include "session_manager.h"
 #include "superatom_expansion.h"
+#include "abbreviation_expander.h"
 #include "settings.h"
+#include "cluster_model.h"
 #include "failsafe_png.h"
 #include "recognition_context.h"
 #include "prefilter_entry.h"
 #include "filters_list.h"
+#include "batch_recognition.h"
+#include "async_recognition.h"
+#include "trace_sink.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
 
 #define IMAGO_BEGIN try {                                                    
 
@@ -67,7 +75,7 @@ CEXPORT void imagoSetSessionId( qword id )
    RecognitionContext *context = getCurrentContext();
       
    if (context == 0)
-      setContextForSession(id, new RecognitionContext());
+      setContextForSession(id, acquireRecognitionContext());
 }
 
 CEXPORT void imagoReleaseSessionId( qword id )
@@ -84,7 +92,17 @@ CEXPORT const char* imagoGetConfigsList()
 {  
    RecognitionContext *context = getCurrentContext();
    
-   // TODO: fill configs list
+   context->configs_list.clear();
+   if (context->vars.getClusterModel())
+   {
+      const ClusterModel &model = *context->vars.getClusterModel();
+      for (size_t i = 0; i < model.size(); i++)
+      {
+         if (i > 0)
+            context->configs_list += ",";
+         context->configs_list += model.getConfigFile((int)i);
+      }
+   }
 
    return context->configs_list.c_str();
 }
@@ -101,6 +119,7 @@ CEXPORT int imagoSetConfig( const char *Name )
    }
    else
    {
+	   context->vars.setClusterModel(std::shared_ptr<const ClusterModel>()); // the config is chosen by the caller
 	   bool loaded = context->vars.forceSelectCluster(Name);
 
 	   if (!loaded)
@@ -110,6 +129,27 @@ CEXPORT int imagoSetConfig( const char *Name )
    IMAGO_END;
 }
 
+CEXPORT int imagoSetClusterModel( const char *FileName )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+
+   if (FileName == NULL || strlen(FileName) == 0)
+   {
+      context->vars.setClusterModel(std::shared_ptr<const ClusterModel>());
+   }
+   else
+   {
+      std::shared_ptr<ClusterModel> model = std::make_shared<ClusterModel>();
+      if (!model->loadFromFile(FileName))
+         throw ImagoException(std::string("Cluster model can not be loaded: ") + FileName);
+      context->vars.setClusterModel(model);
+   }
+
+   IMAGO_END;
+}
+
 CEXPORT int imagoSetFilter( const char *Name )
 {
    IMAGO_BEGIN;
@@ -117,7 +157,7 @@ CEXPORT int imagoSetFilter( const char *Name )
    RecognitionContext *context = getCurrentContext();
    bool found = false;
    
-   FilterEntries entries = getFiltersList();
+   const FilterEntries& entries = getFiltersList();
 
    for (size_t i = 0; i < entries.size(); i++)
    {
@@ -140,17 +180,60 @@ CEXPORT int imagoLoadImageFromFile( const char *FileName )
    IMAGO_BEGIN;
 
    RecognitionContext *context = getCurrentContext();
-   ImageUtils::loadImageFromFile(context->img_src, FileName);
+   ImageUtils::loadImageFromFile(context->img_src, std::string(FileName), context->vars.general.LoadMaxDimension);
    context->img_tmp = context->img_src;
       
    IMAGO_END;
 }
 
+// returns false for single-page formats
+static bool _openPages( RecognitionContext *context, const char *FileName )
+{
+   if (!ImageUtils::isMultiPageFile(FileName))
+      return false;
+   if (!context->pages.isOpen() || context->pages.getFileName() != FileName)
+      context->pages.open(FileName);
+   return true;
+}
+
+CEXPORT int imagoGetPageCount( const char *FileName, int *count )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+   *count = _openPages(context, FileName) ? context->pages.getPageCount() : 1;
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoLoadImagePageFromFile( const char *FileName, const int page )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+   int maxDimension = context->vars.general.LoadMaxDimension;
+   if (_openPages(context, FileName))
+   {
+      context->pages.readPage(page, context->img_src);
+      ImageUtils::fitMaxDimension(context->img_src, maxDimension);
+   }
+   else if (page == 0)
+      ImageUtils::loadImageFromFile(context->img_src, std::string(FileName), maxDimension);
+   else
+      throw ImagoException("Page index is out of range");
+   context->img_tmp = context->img_src;
+
+   IMAGO_END;
+}
+
 CEXPORT int imagoFilterImage()
 {
    IMAGO_BEGIN;
    
    RecognitionContext *context = getCurrentContext();   
+   pipeline_counters::ScopedCounters counting(context->counters.get());
+   memory_budget::ScopedAccount accounting(context->memory.get());
+   memory_budget::Reservation filteredMemory(context->img_src.total()); // img_tmp
    prefilterEntrypoint(context->vars, context->img_tmp, context->img_src);
 
    IMAGO_END;
@@ -162,7 +245,9 @@ CEXPORT int imagoLoadImageFromBuffer( const char *buf, const int buf_size )
    
    RecognitionContext *context = getCurrentContext();
    const unsigned char* buf_uc = (const unsigned char*)buf;
-   failsafePngLoadBuffer(buf_uc, buf_size, context->img_src);
+   int maxDimension = context->vars.general.LoadMaxDimension;
+   if (failsafePngLoadBuffer(buf_uc, buf_size, context->img_src, maxDimension))
+      ImageUtils::fitMaxDimension(context->img_src, maxDimension);
    context->img_tmp = context->img_src;
 
    IMAGO_END;
@@ -180,9 +265,24 @@ CEXPORT int imagoLoadGreyscaleRawImage( const char *buf, const int width, const
    img.init(width, height);
    
    for (int y = 0; y < height; y++)
-	   for (int x = 0; x < width; x++)
-		   img.getByte(x,y) = buf[y * width + x];
+	   memcpy(img.ptr(y), buf + y * width, width);
+
+   context->img_tmp = context->img_src;
 
+   IMAGO_END;
+}
+
+CEXPORT int imagoLoadGreyscaleRawImageView( const unsigned char *buf, const int width, const int height, const int stride )
+{
+   IMAGO_BEGIN;
+
+   if (buf == NULL || width <= 0 || height <= 0 || stride < width)
+      throw ImagoException("Invalid raw image view");
+
+   RecognitionContext *context = getCurrentContext();
+
+   // the data is only read: prefilters copy it before any modification
+   context->img_src = Image(width, height, const_cast<unsigned char*>(buf), stride);
    context->img_tmp = context->img_src;
 
    IMAGO_END;
@@ -238,19 +338,25 @@ CEXPORT int imagoGetPrefilteredImage (unsigned char **data, int *width, int *hei
    *width = img.getWidth();
 
    for (int j = 0; j != img.getHeight(); j++)
-   {
-      int offset = j * img.getWidth();
-
-      for (int i = 0; i != img.getWidth(); i++)
-      {
-         buf[offset + i] = img.getByte(i, j);
-      }
-   }
+      memcpy(buf + j * img.getWidth(), img.ptr(j), img.getWidth());
 
    *data = buf;
    IMAGO_END;
 }
 
+CEXPORT int imagoGetPrefilteredImageView (const unsigned char **data, int *width, int *height, int *stride)
+{
+   IMAGO_BEGIN;
+   RecognitionContext *context = getCurrentContext();
+   Image &img = context->img_tmp;
+
+   *data = img.data;
+   *height = img.getHeight();
+   *width = img.getWidth();
+   *stride = (int)img.step;
+   IMAGO_END;
+}
+
 CEXPORT int imagoSaveImageToFile( const char *filename )
 {
    IMAGO_BEGIN;
@@ -270,13 +376,298 @@ CEXPORT int imagoRecognize(int* warningsCountDataOut)
    RecognitionContext *context = getCurrentContext();
    ChemicalStructureRecognizer &csr = context->csr;
 
-   csr.setImage(context->img_tmp);
-   csr.recognize(context->vars, context->mol);
-   if (warningsCountDataOut)
+   context->trace_json.clear();
+   std::unique_ptr<trace_sink::Recorder> trace;
+   if (trace_sink::shouldSample())
+      trace.reset(new trace_sink::Recorder());
+
+   {
+      trace_sink::ScopedRecording recording(trace.get());
+      pipeline_counters::ScopedCounters counting(context->counters.get());
+      memory_budget::ScopedAccount accounting(context->memory.get());
+      try
+      {
+         csr.setImage(context->img_tmp);
+         csr.recognize(context->vars, context->mol);
+         if (warningsCountDataOut)
+         {
+            (*warningsCountDataOut) = context->mol.getWarningsCount() + context->mol.getDissolvingsCount() / context->vars.main().DissolvingsFactor;
+         }
+         context->molfile = expandSuperatoms(context->vars, context->mol);
+      }
+      catch (...)
+      {
+         // the trace of the failed recognition is the most interesting one
+         if (trace)
+            trace->writeJson(context->trace_json);
+         throw;
+      }
+   }
+
+   if (trace)
+      trace->writeJson(context->trace_json);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoSetTraceSampling( double rate )
+{
+   IMAGO_BEGIN;
+
+   if (rate < 0.0 || rate > 1.0)
+      throw ImagoException("Trace sampling rate should be in [0..1]");
+   trace_sink::setSampleRate(rate);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetTrace( const char **buf, int *buf_size )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+   *buf = context->trace_json.c_str();
+   *buf_size = (int)context->trace_json.size();
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetStatistics( const char **buf, int *buf_size, int process_wide )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+   context->statistics.clear();
+   if (process_wide)
+   {
+      pipeline_counters::getProcessCounters().writeText(context->statistics);
+      memory_budget::getProcessAccount().writeText(context->statistics);
+   }
+   else
+   {
+      context->counters->writeText(context->statistics);
+      context->memory->writeText(context->statistics);
+   }
+   *buf = context->statistics.c_str();
+   *buf_size = (int)context->statistics.size();
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoSetMemoryBudget( int kilobytes )
+{
+   IMAGO_BEGIN;
+
+   if (kilobytes < 0)
+      throw ImagoException("Memory budget should not be negative");
+   getCurrentContext()->memory->setLimit((size_t)kilobytes << 10);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoSetLoadMaxDimension( int max_dimension )
+{
+   IMAGO_BEGIN;
+
+   if (max_dimension < 0)
+      throw ImagoException("Max dimension should not be negative");
+   getCurrentContext()->vars.general.LoadMaxDimension = max_dimension;
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoSetValidateAbbreviations( int validate )
+{
+   IMAGO_BEGIN;
+
+   getCurrentContext()->vars.general.ValidateAbbreviations = (validate != 0);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoRecognizeBatch( ImagoBatchItem *items, int count, int workers )
+{
+   IMAGO_BEGIN;
+
+   if (count < 0 || (items == NULL && count > 0))
+      throw ImagoException("Invalid batch items");
+
+   RecognitionContext *context = getCurrentContext();
+   pipeline_counters::ScopedCounters counting(context->counters.get());
+   memory_budget::ScopedAccount accounting(context->memory.get());
+   batch_recognition::recognizeBatch(context->vars, items, count, workers);
+
+   IMAGO_END;
+}
+
+CEXPORT qword imagoRecognizeAsync( const char *buf, const int buf_size, const char *file_name, int time_limit,
+                                   ImagoCompletionCallback callback, void *user_data )
+{
+   try
+   {
+      if (buf == NULL && file_name == NULL)
+         throw ImagoException("No image specified");
+
+      RecognitionContext *context = getCurrentContext();
+
+      AsyncJobPtr job(new AsyncJob());
+      if (buf != NULL)
+      {
+         if (buf_size <= 0)
+            throw ImagoException("Image buffer is empty");
+         job->buf.assign(buf, buf + buf_size);
+      }
+      else
+         job->file_name = file_name;
+      job->time_limit = time_limit;
+      job->vars = context->vars;
+      job->vars.general.MaxThreads = 1; // jobs are already processed in parallel
+      job->vars.general.CancelFlag = &job->cancelled;
+      job->counters = context->counters;
+      job->memory = context->memory;
+      job->callback = callback;
+      job->user_data = user_data;
+
+      return async_recognition::submit(job);
+   }
+   catch ( ImagoException &e )
+   {
+      RecognitionContext *context = getCurrentContext();
+      context->error_buf = e.what();
+      return 0;
+   }
+}
+
+static AsyncJobPtr _getJob( qword job )
+{
+   AsyncJobPtr result = async_recognition::find(job);
+   if (!result)
+      throw ImagoException("Unknown job handle");
+   return result;
+}
+
+CEXPORT int imagoPoll( qword job, int *done )
+{
+   IMAGO_BEGIN;
+
+   AsyncJobPtr ptr = _getJob(job);
+   std::lock_guard<std::mutex> lock(ptr->mutex);
+   *done = ptr->done ? 1 : 0;
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoWait( qword job )
+{
+   IMAGO_BEGIN;
+
+   AsyncJobPtr ptr = _getJob(job);
+   std::unique_lock<std::mutex> lock(ptr->mutex);
+   while (!ptr->done)
+      ptr->finished.wait(lock);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoCancel( qword job )
+{
+   IMAGO_BEGIN;
+
+   _getJob(job)->cancelled = true;
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetAsyncResult( qword job, char **buf, int *buf_size, int *warnings )
+{
+   IMAGO_BEGIN;
+
+   AsyncJobPtr ptr = _getJob(job);
+   std::lock_guard<std::mutex> lock(ptr->mutex);
+
+   if (!ptr->done)
+      throw ImagoException("Job is not finished");
+   if (!ptr->success)
+      throw ImagoException(ptr->error);
+
+   std::string &out_buf = ptr->molfile;
+   *buf = new char[out_buf.size() + 1];
+   memcpy(*buf, out_buf.c_str(), out_buf.size());
+   *buf_size = out_buf.size();
+   (*buf)[out_buf.size()] = 0;
+
+   if (warnings)
+      *warnings = ptr->warnings;
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoReleaseJob( qword job )
+{
+   IMAGO_BEGIN;
+
+   _getJob(job);
+   async_recognition::release(job);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetStructure( int expanded, const ImagoAtom **atoms, int *atoms_count,
+                               const ImagoBond **bonds, int *bonds_count )
+{
+   IMAGO_BEGIN;
+
+   RecognitionContext *context = getCurrentContext();
+
+   if (context->molfile.empty())
+      throw ImagoException("No recognized structure");
+
+   ExportedStructure &structure = context->structure;
+
+   if (!expanded)
+   {
+      exportMolecule(context->vars, context->mol, structure);
+   }
+   else if (!abbreviation_expander::expand(context->vars, context->mol, structure))
+   {
+      // labels unknown to the native expander are expanded by Indigo
+      Settings temp = context->vars;
+      temp.general.ExpandAbbreviations = true;
+      temp.general.ValidateAbbreviations = false;
+      std::string expandedMolfile = expandSuperatoms(temp, context->mol);
+
+      if (!exportMolfile(expandedMolfile, structure))
+         throw ImagoException(std::string("Structure export failed: ") + indigoGetLastError());
+   }
+
+   context->structure_atoms.resize(structure.atoms.size());
+   for (size_t i = 0; i < structure.atoms.size(); i++)
+   {
+      const ExportedAtom &src = structure.atoms[i];
+      ImagoAtom &dst = context->structure_atoms[i];
+      dst.label = src.label.c_str();
+      dst.charge = src.charge;
+      dst.isotope = src.isotope;
+      dst.x = src.x;
+      dst.y = src.y;
+      dst.quality = src.quality;
+   }
+
+   context->structure_bonds.resize(structure.bonds.size());
+   for (size_t i = 0; i < structure.bonds.size(); i++)
    {
-	   (*warningsCountDataOut) = context->mol.getWarningsCount() + context->mol.getDissolvingsCount() / context->vars.main.DissolvingsFactor;
+      const ExportedBond &src = structure.bonds[i];
+      ImagoBond &dst = context->structure_bonds[i];
+      dst.begin = src.begin;
+      dst.end = src.end;
+      dst.order = src.order;
+      dst.stereo = src.stereo;
    }
-   context->molfile = expandSuperatoms(context->vars, context->mol);
+
+   *atoms = context->structure_atoms.empty() ? NULL : &context->structure_atoms[0];
+   *atoms_count = context->structure_atoms.size();
+   *bonds = context->structure_bonds.empty() ? NULL : &context->structure_bonds[0];
+   *bonds_count = context->structure_bonds.size();
 
    IMAGO_END;
 }
@@ -321,11 +712,12 @@ CEXPORT int imagoSetLogging( int mode )
       context->vars.general.LogEnabled = true;
       imago::getLogExt().setLoggingEnabled(true);
 
-      if (mode == 2)
+      if (mode == 2 || mode == 3)
       {
          context->vars.general.LogVFSEnabled = true;
          imago::getLogExt().SetVirtualFS(context->vfs);
          context->vfs.clear();
+         context->vfs.setCompression(mode == 3);
       }
       else
       {
@@ -377,6 +769,7 @@ CEXPORT int imagoClearLog( )
 	IMAGO_BEGIN;
 
 	RecognitionContext *context = getCurrentContext();
+	imago::getLogExt().flushImages(); // pending images belong to the cleared log
 	context->vfs.clear();
 
 	IMAGO_END;
@@ -387,6 +780,7 @@ CEXPORT int imagoGetLogCount( int *count )
 {
    IMAGO_BEGIN;
 
+   imago::getLogExt().flushImages();
    VirtualFS &vfs = getCurrentContext()->vfs;
    *count = vfs.size();
 
@@ -400,12 +794,39 @@ CEXPORT int imagoGetLogRecord( int it, char **filename, int *length, char **data
    VirtualFS &vfs = getCurrentContext()->vfs;
    std::string &fname = vfs[it].filename;
    *filename = new char[fname.length() + 1];
-   *length = vfs[it].data.size();
-   *data = new char[vfs[it].data.size()];
+   *length = vfs[it].size();
+   *data = new char[vfs[it].size()];
 
    memcpy(*filename, fname.c_str(), fname.length());
    (*filename)[fname.length()] = 0;
-   memcpy(*data, &vfs[it].data[0], *length);
+   vfs[it].read(0, (unsigned char *)*data, *length);
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoGetLogRecordInfo( int it, const char **filename, int *length )
+{
+   IMAGO_BEGIN;
+
+   VirtualFS &vfs = getCurrentContext()->vfs;
+   if (it < 0 || it >= (int)vfs.size())
+      throw ImagoException("Log record index is out of range");
+   *filename = vfs[it].filename.c_str();
+   *length = (int)vfs[it].size();
+
+   IMAGO_END;
+}
+
+CEXPORT int imagoReadLogRecord( int it, int offset, char *buf, int buf_size, int *read )
+{
+   IMAGO_BEGIN;
+
+   VirtualFS &vfs = getCurrentContext()->vfs;
+   if (it < 0 || it >= (int)vfs.size())
+      throw ImagoException("Log record index is out of range");
+   if (offset < 0 || buf_size < 0)
+      throw ImagoException("Invalid log record range");
+   *read = (int)vfs[it].read(offset, (unsigned char *)buf, buf_size);
 
    IMAGO_END;
 }
@@ -65,12 +65,18 @@ CEXPORT void imagoReleaseSessionId( qword id );
 
 /* Set one of predefined configuration sets.
  * The given name should be selected from imagoGetConfigsList() results
- * Empty string as parameter means config auto-detection. */
+ * Empty string as parameter means config auto-detection.
+ * Specified config disables the cluster model. */
 CEXPORT int imagoSetConfig( const char *name );
 
 /* Get the list of available predefined configuration sets separated by comma. */
 CEXPORT const char* imagoGetConfigsList();
 
+/* Load the cluster model trained by the console (-trainclusters) for config auto-detection:
+ * imagoFilterImage() applies the config of the cluster nearest to the image features.
+ * NULL or empty string unloads the model. */
+CEXPORT int imagoSetClusterModel( const char *file_name );
+
 /* Choose the filter to process image before call imagoFilterImage()
  * name can be "prefilter_binarized", "prefilter_basic", or something else.
  * For the exact information see the filters_list.cpp file.
@@ -81,17 +87,63 @@ CEXPORT int imagoSetFilter( const char *name );
 CEXPORT int imagoLoadImageFromBuffer( const char *buf, const int buf_size );
 CEXPORT int imagoLoadImageFromFile( const char *FileName );
 
+/* Multi-page (TIFF) files: the pages are numbered from 0, single-page images
+ * report one page. Only the page directories are read by imagoGetPageCount(),
+ * every page is decoded when it is loaded. The file is kept open until another
+ * file is used or the instance is released. */
+CEXPORT int imagoGetPageCount( const char *FileName, int *count );
+CEXPORT int imagoLoadImagePageFromFile( const char *FileName, const int page );
+
 /* PNG image saving function. */
 CEXPORT int imagoSaveImageToFile( const char *FileName );
 
 /* Load raw grayscale image - byte array of length width*height. */
 CEXPORT int imagoLoadGreyscaleRawImage( const char *buf, const int width, const int height );
 
+/* Use raw grayscale image without copying it: rows are 'stride' bytes apart.
+ * The buffer is borrowed: it must stay valid and unchanged until another image
+ * is loaded or the instance is released. Imago never writes into it,
+ * filtering works on its own copy. */
+CEXPORT int imagoLoadGreyscaleRawImageView( const unsigned char *buf, const int width, const int height, const int stride );
+
 /* Enable or disable global log printing */
-/* Modes are: 0 - disabled, 1 - enable log to file, 2 - enable log to virtual fs*/
+/* Modes are: 0 - disabled, 1 - enable log to file, 2 - enable log to virtual fs,
+ * 3 - enable log to virtual fs, compressing the finished parts of the records in memory */
 /* WARNING: affects all threads/IDS */
 CEXPORT int imagoSetLogging( int mode );
 
+/* Timeline tracing of the recognition in Chrome trace JSON format (chrome://tracing, Perfetto).
+ * rate is the fraction of imagoRecognize() calls to trace: 0 - disabled (default), 1 - every call.
+ * WARNING: affects all threads/IDS */
+CEXPORT int imagoSetTraceSampling( double rate );
+
+/* Returns the trace of the last imagoRecognize() call of the current instance,
+ * buf_size is 0 if the call was not sampled. The buffer is owned by Imago. */
+CEXPORT int imagoGetTrace( const char **buf, int *buf_size );
+
+/* Pipeline counters (segments found, templates compared, restarts, time limit aborts etc.)
+ * as "name=value" lines. The counters of the current instance are accumulated over its
+ * imagoFilterImage(), imagoRecognize() and imagoRecognizeBatch() calls and its
+ * imagoRecognizeAsync() jobs, process_wide != 0 returns the counters of all the instances instead. The buffer is owned by Imago.
+ * Also reports memory_current, memory_peak and memory_limit in bytes. */
+CEXPORT int imagoGetStatistics( const char **buf, int *buf_size, int process_wide );
+
+/* Limits the large buffers (images, segments, graph) of the current instance,
+ * recognition or filtering fails with an error when the budget is exceeded.
+ * 0 (default) means unlimited. Batch items and async jobs share the budget of the calling instance. */
+CEXPORT int imagoSetMemoryBudget( int kilobytes );
+
+/* Images with the longest side over max_dimension pixels are reduced to it while loading
+ * (JPEG and PNG are decoded at reduced resolution), so they are never kept at full size.
+ * 0 (default) loads images at full size. Affects imagoLoadImageFromFile(),
+ * imagoLoadImageFromBuffer() and imagoRecognizeBatch(). */
+CEXPORT int imagoSetLoadMaxDimension( int max_dimension );
+
+/* validate != 0 makes the molfile of imagoRecognize() and imagoRecognizeBatch() be checked
+ * against the abbreviations expansion by Indigo, whose result is used on mismatch.
+ * 0 (default) trusts the native expansion. */
+CEXPORT int imagoSetValidateAbbreviations( int validate );
+
 /* Attach some arbitrary data to the current Imago instance. */
 CEXPORT int imagoSetSessionSpecificData( void *data );
 CEXPORT int imagoGetSessionSpecificData( void **data );
@@ -100,6 +152,85 @@ CEXPORT int imagoGetSessionSpecificData( void **data );
    Returns count of recognition warnings in warningsCountDataOut value (if specified) */
 CEXPORT int imagoRecognize( int *warningsCountDataOut = NULL );
 
+/* Batch recognition item. Input is either an image buffer (buf, buf_size)
+ * or a file name (file_name, used when buf is NULL).
+ * time_limit is in milliseconds, 0 means the limit from current config.
+ * Outputs are allocated by Imago the same way as in imagoSaveMolToBuffer():
+ * molfile is NULL and error is set if the item failed. */
+typedef struct
+{
+   const char *buf;
+   int buf_size;
+   const char *file_name;
+   int time_limit;
+
+   char *molfile;
+   int molfile_size;
+   int warnings;
+   char *error;
+} ImagoBatchItem;
+
+/* Recognizes 'count' items using 'workers' threads (0 - all hardware threads).
+ * Each item is loaded, filtered and recognized independently using
+ * the configuration of the current instance; recognition caches are shared.
+ * Returns 0 only if the batch could not be started, per-item errors
+ * are reported in the items. */
+CEXPORT int imagoRecognizeBatch( ImagoBatchItem *items, int count, int workers );
+
+/* Asynchronous recognition. The image is given the same way as in ImagoBatchItem,
+ * input buffers are copied. Recognition runs on an internal executor using
+ * the configuration of the current instance at the moment of the call.
+ * The optional callback is called from an executor thread when the job finishes.
+ * Returns job handle, or 0 on error. Every job should be released by imagoReleaseJob(). */
+typedef void (*ImagoCompletionCallback)( qword job, int success, void *user_data );
+
+CEXPORT qword imagoRecognizeAsync( const char *buf, const int buf_size, const char *file_name, int time_limit,
+                                   ImagoCompletionCallback callback, void *user_data );
+
+/* Sets *done to 1 if the job is finished (successfully or not), 0 otherwise. */
+CEXPORT int imagoPoll( qword job, int *done );
+
+/* Blocks until the job is finished. */
+CEXPORT int imagoWait( qword job );
+
+/* Requests cooperative cancellation, the job stops at the next time limit checkpoint. */
+CEXPORT int imagoCancel( qword job );
+
+/* Gets the molfile of the finished job. Returns 0 if the job is not finished
+ * or failed, the reason is available via imagoGetLastError(). */
+CEXPORT int imagoGetAsyncResult( qword job, char **buf, int *buf_size, int *warnings );
+
+/* Releases the job handle, cancelling the job if it is still running. */
+CEXPORT int imagoReleaseJob( qword job );
+
+/* Recognized structure as flat arrays, without molfile formatting and parsing.
+ * Atom coordinates are in average bond length units, y axis directed up.
+ * Label is an element symbol or an abbreviation text; quality is the worst
+ * recognition quality of the label characters, -1 for unlabeled atoms.
+ * Bond order is 1..4 (4 - aromatic), stereo is 0 - none, 1 - up, 3 - down. */
+typedef struct
+{
+   const char *label;
+   int charge;
+   int isotope;
+   double x, y;
+   double quality;
+} ImagoAtom;
+
+typedef struct
+{
+   int begin, end; /* atom indices */
+   int order;
+   int stereo;
+} ImagoBond;
+
+/* Returns the structure from the last imagoRecognize() call.
+ * With expanded = 0 it is taken straight from the recognized molecule,
+ * abbreviations are single atoms; with expanded = 1 abbreviations are expanded.
+ * Arrays are owned by Imago and valid until the next call or recognition. */
+CEXPORT int imagoGetStructure( int expanded, const ImagoAtom **atoms, int *atoms_count,
+                               const ImagoBond **bonds, int *bonds_count );
+
 /* Molfile (.mol) output functions. */
 CEXPORT int imagoSaveMolToBuffer( char **buf, int *buf_size );
 CEXPORT int imagoSaveMolToFile( const char *fileName );
@@ -116,12 +247,23 @@ CEXPORT int imagoGetPrefilteredImageSize( int *width, int *height );
 /* returns filtered image data */
 CEXPORT int imagoGetPrefilteredImage( unsigned char **data, int *width, int *height );
 
+/* returns filtered image data without copying: rows are 'stride' bytes apart.
+ * The pointer is owned by Imago and valid until the next image load or filtering. */
+CEXPORT int imagoGetPrefilteredImageView( const unsigned char **data, int *width, int *height, int *stride );
+
 /* returns count of files contained in log vfs. */
 CEXPORT int imagoGetLogCount( int *count );
 
 /* returns it's file name, length and content */
 CEXPORT int imagoGetLogRecord( int it, char **filename, int *lengths, char **data );
 
+/* returns it's file name and length without copying, the name is owned by Imago */
+CEXPORT int imagoGetLogRecordInfo( int it, const char **filename, int *length );
+
+/* streaming export: copies up to buf_size bytes of the record content from offset,
+ * read is 0 at the end of the record. Memory use does not depend on the record size. */
+CEXPORT int imagoReadLogRecord( int it, int offset, char *buf, int buf_size, int *read );
+
 /* clears all current vfs log content */
 CEXPORT int imagoClearLog();
 
@@ -1,7 +1,9 @@
 #include <map>
 #include <mutex>
+#include <vector>
 
 #include "recognition_context.h"
+#include "parallel_tools.h"
 
 namespace imago
 {
@@ -9,6 +11,75 @@ namespace imago
    static ContextMap _contexts;
    static std::mutex _contexts_mutex;
 
+   typedef std::vector<RecognitionContext *> ContextPool;
+   static ContextPool _pool;
+   static std::mutex _pool_mutex;
+
+   // bigger recognizer buffers are not kept in pooled contexts
+   static const size_t MAX_POOLED_IMAGE_PIXELS = 4096 * 4096;
+
+   static const Settings &_pristineSettings()
+   {
+      static const Settings settings;
+      return settings;
+   }
+
+   void RecognitionContext::reset( size_t maxPixels )
+   {
+      csr.trimBuffers(maxPixels);
+      img_tmp.release();
+      img_src.release(); // also drops borrowed views
+      mol.clear();
+      molfile.clear();
+      out_buf.clear();
+      error_buf = "No error";
+      configs_list.clear();
+      vars = _pristineSettings();
+      vars.caches = RecognitionCaches(); // results of other sessions and configs are not reused
+      vfs.clear();
+      structure.clear();
+      structure_atoms.clear();
+      structure_bonds.clear();
+      pages.close();
+      trace_json.clear();
+      counters.reset(new pipeline_counters::Counters()); // unfinished async jobs keep the old ones
+      memory.reset(new memory_budget::Account()); // with the default limit
+      statistics.clear();
+      session_specific_data = 0;
+   }
+
+   RecognitionContext *acquireRecognitionContext()
+   {
+      {
+         std::lock_guard<std::mutex> lock(_pool_mutex);
+         if (!_pool.empty())
+         {
+            RecognitionContext *context = _pool.back();
+            _pool.pop_back();
+            return context;
+         }
+      }
+      return new RecognitionContext();
+   }
+
+   void releaseRecognitionContext(RecognitionContext *context)
+   {
+      if (context == NULL)
+         return;
+
+      context->reset(MAX_POOLED_IMAGE_PIXELS);
+
+      {
+         std::lock_guard<std::mutex> lock(_pool_mutex);
+         if (_pool.size() < 2 * (size_t)parallel_tools::getHardwareThreads())
+         {
+            _pool.push_back(context);
+            return;
+         }
+      }
+      delete context;
+   }
+
    RecognitionContext *getContextForSession( qword sessionId )
    {
       std::lock_guard<std::mutex> lock(_contexts_mutex);
@@ -31,9 +102,11 @@ namespace imago
 
    void deleteRecognitionContext(qword sessionId, RecognitionContext *context)
    {
-      std::lock_guard<std::mutex> lock(_contexts_mutex);
-      delete context;
-      _contexts.erase(_contexts.find(sessionId));
+      {
+         std::lock_guard<std::mutex> lock(_contexts_mutex);
+         _contexts.erase(_contexts.find(sessionId));
+      }
+      releaseRecognitionContext(context);
    }
 
    struct _ContextCleanup
@@ -44,6 +117,10 @@ namespace imago
          {
             delete item.second;
          }
+         for(RecognitionContext *context: _pool)
+         {
+            delete context;
+         }
       }
    };
 
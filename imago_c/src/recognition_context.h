@@ -16,6 +16,7 @@
 #ifndef _recognition_context_h
 #define _recognition_context_h
 
+#include <memory>
 #include <string>
 
 #include "comdef.h"
@@ -25,6 +26,11 @@
 #include "settings.h"
 #include "virtual_fs.h"
 #include "session_manager.h"
+#include "structure_export.h"
+#include "imago_c.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
+#include "tiff_document.h"
 
 namespace imago
 {
@@ -40,13 +46,25 @@ namespace imago
 	  std::string configs_list;
       Settings vars;
       VirtualFS vfs;
+      ExportedStructure structure;
+      std::vector<ImagoAtom> structure_atoms;
+      std::vector<ImagoBond> structure_bonds;
+      TiffDocument pages;
+      std::string trace_json;
+      std::shared_ptr<pipeline_counters::Counters> counters; // shared with the async jobs
+      std::shared_ptr<memory_budget::Account> memory; // shared with the async jobs
+      std::string statistics;
       void *session_specific_data;
       
-      RecognitionContext () 
+      RecognitionContext () : counters(new pipeline_counters::Counters()), memory(new memory_budget::Account())
       {
          session_specific_data = 0;
          error_buf = "No error";
       }
+
+      // returns the context to the just-constructed state, keeping
+      // the recognizer buffers if they are not larger than maxPixels
+      void reset( size_t maxPixels );
    };
 
    RecognitionContext *getContextForSession(qword sessionId);
@@ -57,6 +75,10 @@ namespace imago
 
    void setContextForSession(qword sessionId, RecognitionContext *context);
    void deleteRecognitionContext(qword sessionId, RecognitionContext *context);
+
+   // pooled contexts: released contexts are reset and reused by the next sessions
+   RecognitionContext *acquireRecognitionContext();
+   void releaseRecognitionContext(RecognitionContext *context);
 };
 
 
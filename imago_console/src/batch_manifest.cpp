@@ -0,0 +1,185 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "batch_manifest.h"
+#include "exception.h"
+
+namespace batch_manifest
+{
+	BatchManifest::BatchManifest(const std::string& filename, bool resume)
+	{
+		if (resume)
+			_load(filename);
+
+		_file = fopen(filename.c_str(), resume ? "ab" : "wb");
+		if (_file == NULL)
+			throw imago::ImagoException("Can't open manifest file: " + filename);
+	}
+
+	BatchManifest::~BatchManifest()
+	{
+		fclose(_file);
+	}
+
+	std::string BatchManifest::hashFile(const std::string& path)
+	{
+		// 64-bit FNV-1a of the file content
+		unsigned long long hash = 14695981039346656037ULL;
+
+		FILE* f = fopen(path.c_str(), "rb");
+		if (f != NULL)
+		{
+			unsigned char buf[64 * 1024];
+			size_t read;
+			while ((read = fread(buf, 1, sizeof(buf), f)) > 0)
+			{
+				for (size_t u = 0; u < read; u++)
+				{
+					hash ^= buf[u];
+					hash *= 1099511628211ULL;
+				}
+			}
+			fclose(f);
+		}
+
+		char result[32];
+		sprintf(result, "%016llx", hash);
+		return result;
+	}
+
+	void BatchManifest::_load(const std::string& filename)
+	{
+		FILE* f = fopen(filename.c_str(), "rb");
+		if (f == NULL)
+			return; // nothing to resume
+
+		char line[4096];
+		while (fgets(line, sizeof(line), f) != NULL)
+		{
+			std::string str = line;
+			while (!str.empty() && (str[str.size() - 1] == '\n' || str[str.size() - 1] == '\r'))
+				str.erase(str.size() - 1);
+
+			// status, hash, elapsed, offset, path
+			size_t fields[4];
+			size_t pos = 0;
+			bool valid = str.size() > 2;
+			for (int u = 0; u < 4 && valid; u++)
+			{
+				pos = str.find('\t', pos);
+				valid = (pos != std::string::npos);
+				fields[u] = pos++;
+			}
+
+			// the last line may be truncated by a crash
+			if (!valid)
+				continue;
+
+			std::string hash = str.substr(fields[0] + 1, fields[1] - fields[0] - 1);
+			std::string path = str.substr(fields[3] + 1);
+			_apply((ItemStatus)str[0], path, hash);
+		}
+		fclose(f);
+
+		for (std::map<std::string, ItemState>::iterator it = _items.begin(); it != _items.end(); ++it)
+		{
+			if (it->second.pending)
+			{
+				it->second.pending = false;
+				it->second.failures++;
+			}
+		}
+	}
+
+	void BatchManifest::_apply(ItemStatus status, const std::string& path, const std::string& hash)
+	{
+		ItemState& item = _items[path];
+		if (item.hash != hash)
+		{
+			// the file is changed, its history is not relevant
+			item = ItemState();
+			item.hash = hash;
+		}
+
+		switch (status)
+		{
+		case STATUS_STARTED:
+			if (item.pending)
+				item.failures++; // started again without finishing
+			item.pending = true;
+			break;
+		case STATUS_DONE:
+		case STATUS_FAILED:
+			item.pending = false;
+			item.completed = true;
+			break;
+		case STATUS_TIMEOUT:
+			item.pending = false;
+			item.failures++;
+			break;
+		case STATUS_QUARANTINED:
+			item.pending = false;
+			item.quarantined = true;
+			break;
+		}
+	}
+
+	bool BatchManifest::shouldSkip(const std::string& path, const std::string& hash, std::string& reason)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		std::map<std::string, ItemState>::iterator it = _items.find(path);
+		if (it == _items.end() || it->second.hash != hash)
+			return false;
+
+		ItemState& item = it->second;
+		if (item.completed)
+		{
+			reason = "already completed";
+			return true;
+		}
+		if (item.quarantined || item.failures >= QUARANTINE_ATTEMPTS)
+		{
+			if (!item.quarantined)
+			{
+				item.quarantined = true;
+				_write(STATUS_QUARANTINED, path, hash, 0, -1);
+			}
+			reason = "quarantined";
+			return true;
+		}
+		return false;
+	}
+
+	void BatchManifest::started(const std::string& path, const std::string& hash)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_write(STATUS_STARTED, path, hash, 0, -1);
+	}
+
+	void BatchManifest::finished(const std::string& path, const std::string& hash, ItemStatus status,
+		                         unsigned int elapsed, long long offset)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_apply(status, path, hash);
+		_write(status, path, hash, elapsed, offset);
+	}
+
+	void BatchManifest::_write(ItemStatus status, const std::string& path, const std::string& hash,
+		                       unsigned int elapsed, long long offset)
+	{
+		fprintf(_file, "%c\t%s\t%u\t%lld\t%s\n", (char)status, hash.c_str(), elapsed, offset, path.c_str());
+		fflush(_file); // the record should survive a crash of the next item
+	}
+}
@@ -0,0 +1,83 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _batch_manifest_h
+#define _batch_manifest_h
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace batch_manifest
+{
+	// item statuses stored in the manifest
+	enum ItemStatus
+	{
+		STATUS_STARTED = 'S',
+		STATUS_DONE = 'D',
+		STATUS_FAILED = 'F',
+		STATUS_TIMEOUT = 'T',
+		STATUS_QUARANTINED = 'Q'
+	};
+
+	// append-only log of batch items, one line per event:
+	//   status <tab> content hash <tab> elapsed ms <tab> output offset <tab> path
+	// an item that has been started but has no final record crashed the process
+	class BatchManifest
+	{
+	public:
+		// reads the existing manifest if 'resume' is set, otherwise starts a new one
+		BatchManifest(const std::string& filename, bool resume);
+		~BatchManifest();
+
+		// items crashed or timed out this many times are not processed anymore
+		static const int QUARANTINE_ATTEMPTS = 2;
+
+		static std::string hashFile(const std::string& path);
+
+		// returns true if the item is already completed or quarantined (the reason is stored)
+		bool shouldSkip(const std::string& path, const std::string& hash, std::string& reason);
+
+		void started(const std::string& path, const std::string& hash);
+		void finished(const std::string& path, const std::string& hash, ItemStatus status,
+			          unsigned int elapsed, long long offset);
+
+	private:
+		struct ItemState
+		{
+			std::string hash;
+			bool pending, completed, quarantined;
+			int failures; // crashes and timeouts
+
+			ItemState() : pending(false), completed(false), quarantined(false), failures(0) { }
+		};
+
+		FILE* _file;
+		std::map<std::string, ItemState> _items;
+		std::mutex _mutex;
+
+		void _load(const std::string& filename);
+		void _apply(ItemStatus status, const std::string& path, const std::string& hash);
+		void _write(ItemStatus status, const std::string& path, const std::string& hash,
+			        unsigned int elapsed, long long offset);
+
+		BatchManifest(const BatchManifest&);
+		BatchManifest& operator=(const BatchManifest&);
+	};
+}
+
+#endif // _batch_manifest_h
@@ -0,0 +1,208 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+#include "recognition_helpers.h"
+#include "image_utils.h"
+#include "log_ext.h"
+#include "platform_tools.h"
+#include "prefilter_cache.h"
+#include "stage_timer.h"
+
+namespace benchmark
+{
+	typedef std::chrono::steady_clock Clock;
+
+	static double elapsedMs(const Clock::time_point& start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// nearest-rank percentile of the sorted samples
+	static double percentile(const std::vector<double>& sorted, double p)
+	{
+		size_t rank = (size_t)std::ceil(p * sorted.size());
+		if (rank < 1)
+			rank = 1;
+		return sorted[std::min(rank, sorted.size()) - 1];
+	}
+
+	StageStatistics calculateStatistics(const std::string& name, std::vector<double>& samples)
+	{
+		StageStatistics result;
+		result.name = name;
+		result.count = samples.size();
+		if (samples.empty())
+			return result;
+
+		std::sort(samples.begin(), samples.end());
+		double sum = 0.0;
+		for (size_t u = 0; u < samples.size(); u++)
+			sum += samples[u];
+		result.mean = sum / samples.size();
+		result.p50 = percentile(samples, 0.50);
+		result.p95 = percentile(samples, 0.95);
+		result.p99 = percentile(samples, 0.99);
+		result.max = samples.back();
+		return result;
+	}
+
+	void printReport(FILE* out, const BenchmarkReport& report)
+	{
+		fprintf(out, "\n%-32s %8s %10s %10s %10s %10s %10s\n", "Stage", "Count", "Mean", "P50", "P95", "P99", "Max");
+		for (size_t u = 0; u < report.stages.size(); u++)
+		{
+			const StageStatistics& s = report.stages[u];
+			fprintf(out, "%-32s %8u %10.2f %10.2f %10.2f %10.2f %10.2f\n", s.name.c_str(), (unsigned int)s.count,
+			        s.mean, s.p50, s.p95, s.p99, s.max);
+		}
+		fprintf(out, "\nImages: %u x %d iterations, failures: %u\n", (unsigned int)report.images, report.iterations,
+		        (unsigned int)report.failures);
+		fprintf(out, "Wall time: %.0f ms, throughput: %.2f images/s, peak memory: %u KB\n", report.wallTime,
+		        report.throughput, report.peakMemory);
+	}
+
+	static std::string jsonString(const std::string& value)
+	{
+		std::string result = "\"";
+		for (size_t u = 0; u < value.size(); u++)
+		{
+			char c = value[u];
+			if (c == '"' || c == '\\')
+				result += '\\';
+			if ((unsigned char)c < 0x20)
+				c = ' ';
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	void storeReportJson(FILE* out, const BenchmarkReport& report)
+	{
+		fprintf(out, "{\n");
+		fprintf(out, "  \"images\": %u,\n", (unsigned int)report.images);
+		fprintf(out, "  \"iterations\": %d,\n", report.iterations);
+		fprintf(out, "  \"failures\": %u,\n", (unsigned int)report.failures);
+		fprintf(out, "  \"wall_ms\": %.3f,\n", report.wallTime);
+		fprintf(out, "  \"throughput\": %.3f,\n", report.throughput);
+		fprintf(out, "  \"peak_rss_kb\": %u,\n", report.peakMemory);
+		fprintf(out, "  \"stages\": {");
+		for (size_t u = 0; u < report.stages.size(); u++)
+		{
+			const StageStatistics& s = report.stages[u];
+			fprintf(out, "%s\n    %s: { \"count\": %u, \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f }",
+			        u ? "," : "", jsonString(s.name).c_str(), (unsigned int)s.count, s.mean, s.p50, s.p95, s.p99, s.max);
+		}
+		fprintf(out, "\n  }\n}\n");
+	}
+
+	int performBenchmark(const imago::Settings& vars, const strings& files, const std::string& configName,
+	                     int iterations, const std::string& jsonName)
+	{
+		if (files.empty())
+		{
+			printf("[ERROR] No images to benchmark\n");
+			return 1;
+		}
+
+		if (iterations < 1)
+			iterations = 1;
+
+		// logging distorts the timings
+		imago::getLogExt().setLoggingEnabled(false);
+		// cached prefilter results would hide the prefilters work
+		imago::PrefilterCache::disable();
+		imago::Settings benchVars = vars;
+		benchVars.general.LogEnabled = false;
+		benchVars.general.LogVFSEnabled = false;
+
+		// warm-up: loads fonts and fills the recognition caches
+		{
+			imago::Settings temp = benchVars;
+			recognition_helpers::recognizeFile(temp, files[0], configName);
+		}
+
+		std::map<std::string, std::vector<double> > samples;
+		std::vector<std::string> order;
+		std::vector<double> totals;
+
+		BenchmarkReport report;
+		report.images = files.size();
+		report.iterations = iterations;
+
+		Clock::time_point wallStart = Clock::now();
+
+		for (int iter = 0; iter < iterations; iter++)
+		{
+			for (size_t u = 0; u < files.size(); u++)
+			{
+				imago::stage_timer::StageTimes times;
+				imago::Settings fileVars = benchVars;
+
+				Clock::time_point start = Clock::now();
+				imago::stage_timer::setSink(&times);
+				recognition_helpers::RecognitionResult result =
+					recognition_helpers::recognizeFile(fileVars, files[u], configName);
+				imago::stage_timer::setSink(NULL);
+				totals.push_back(elapsedMs(start));
+
+				if (!result.error.empty())
+					report.failures++;
+
+				for (imago::stage_timer::StageTimes::const_iterator it = times.begin(); it != times.end(); ++it)
+				{
+					std::vector<double>& stage = samples[it->first];
+					if (stage.empty())
+						order.push_back(it->first);
+					stage.push_back(it->second);
+				}
+			}
+
+			printf("Iteration %d/%d done (%.0f ms)\n", iter + 1, iterations, elapsedMs(wallStart));
+		}
+
+		report.wallTime = elapsedMs(wallStart);
+		if (report.wallTime > 0)
+			report.throughput = files.size() * iterations * 1000.0 / report.wallTime;
+		report.peakMemory = platform::PEAK_MEMORY();
+
+		for (size_t u = 0; u < order.size(); u++)
+			report.stages.push_back(calculateStatistics(order[u], samples[order[u]]));
+		report.stages.push_back(calculateStatistics("total", totals));
+
+		printReport(stdout, report);
+
+		if (!jsonName.empty())
+		{
+			FILE* out = (jsonName == "-") ? stdout : fopen(jsonName.c_str(), "w");
+			if (out == NULL)
+			{
+				printf("[ERROR] Can't create JSON file '%s'\n", jsonName.c_str());
+				return 2;
+			}
+			storeReportJson(out, report);
+			if (out != stdout)
+				fclose(out);
+		}
+
+		return 0;
+	}
+}
@@ -0,0 +1,62 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _benchmark_h
+#define _benchmark_h
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "file_helpers.h"
+#include "settings.h"
+
+namespace benchmark
+{
+	struct StageStatistics
+	{
+		std::string name;
+		size_t count;
+		double mean, p50, p95, p99, max; // milliseconds
+
+		StageStatistics() : count(0), mean(0), p50(0), p95(0), p99(0), max(0) { }
+	};
+
+	struct BenchmarkReport
+	{
+		size_t images;
+		int iterations;
+		size_t failures;
+		double wallTime;   // milliseconds
+		double throughput; // images per second
+		unsigned int peakMemory; // kilobytes
+		std::vector<StageStatistics> stages; // in order of the first appearance, "total" is the last
+
+		BenchmarkReport() : images(0), iterations(0), failures(0), wallTime(0), throughput(0), peakMemory(0) { }
+	};
+
+	// calculates statistics of the samples (which are reordered)
+	StageStatistics calculateStatistics(const std::string& name, std::vector<double>& samples);
+
+	void printReport(FILE* out, const BenchmarkReport& report);
+	void storeReportJson(FILE* out, const BenchmarkReport& report);
+
+	// recognizes every image 'iterations' times in the calling thread with logging disabled;
+	// prints the per-stage timings table and stores it as JSON to 'jsonName' if specified ('-' for stdout)
+	int performBenchmark(const imago::Settings& vars, const strings& files, const std::string& configName,
+	                     int iterations, const std::string& jsonName);
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "machine_learning.h"
+#include <algorithm>
 #include <time.h>
 #include "platform_tools.h"
 #include "exception.h"
@@ -8,6 +9,10 @@
 #include "output.h"
 #include "virtual_fs.h"
 #include "exception.h"
+#include "indigo.h"
+#include "prefilter_cache.h"
+#include "cluster_model.h"
+#include "image_utils.h"
 
 namespace machine_learning
 {
@@ -26,6 +31,58 @@ namespace machine_learning
 
 	double LEARNING_MULTIPLIER_BASE = 0.1;         /* %, constants variation threshold */
 
+	const size_t LEARNING_PREFILTER_CACHE_BYTES = 512 * 1024 * 1024; /* bytes, memory for the prefilter results */
+
+	std::string prefilter_cache_file = "";
+
+	void setPrefilterCacheFile(const std::string& filename)
+	{
+		prefilter_cache_file = filename;
+	}
+
+	void storePrefilterCache()
+	{
+		imago::PrefilterCache* cache = imago::PrefilterCache::getInstance();
+		if (cache != NULL && !prefilter_cache_file.empty())
+		{
+			printf("[Learning] Prefilter cache: %u hits, %u misses\n", (unsigned)cache->hits(), (unsigned)cache->misses());
+			if (!cache->storeToFile(prefilter_cache_file))
+				printf("[Learning] Failed to store the prefilter cache!\n");
+		}
+	}
+
+	void fillLearningBase(const strings& imageSet, LearningBase& base)
+	{
+		for (size_t u = 0; u < imageSet.size(); u++)
+		{			
+			const std::string& file = imageSet[u];
+
+			LearningContext ctx;
+			if (file_helpers::getReferenceFileName(file, ctx.reference_file))
+			{
+				try
+				{
+					imago::FileScanner fsc("%s", ctx.reference_file.c_str());
+			
+					ctx.valid = true;
+				}
+				catch (imago::FileNotFoundException&)
+				{
+					printf("[ERROR] Can not open reference file: '%s'\n", ctx.reference_file.c_str());
+				}
+			}
+			else
+			{
+				printf("[ERROR] Can not obtain reference filename for: '%s'\n", file.c_str());
+			}
+
+			// TODO: probably is better to place them in some temp folder
+			ctx.output_file = file + ".temp.mol";
+
+			base[file] = ctx;
+		}
+	}
+
 	double getWorstAllowedDelta(int imagesCount)  /* %, worst similarity delta (in average) allowed for further checks */
 	{
 		if (imagesCount < LEARNING_QUICKCHECK_MAX_COUNT)
@@ -164,58 +221,86 @@ namespace machine_learning
 		return output;
 	}
 
-	void runSingleItem(LearningContext& ctx, LearningResultRecord& res, const std::string& image_name, int timelimit_value, bool init)
+	ItemEvaluation evaluateItem(const LearningContext& ctx, const imago::Settings& config_vars, const std::string& image_name, int timelimit_value)
 	{
-		int action_error = 0;
-		double cur_work_time = 0.0;
-		double cur_similarity = 0.0;
+		ItemEvaluation result;
+		std::string molecule;
 
 		{
-			imago::Settings temp_vars;				
-			temp_vars.fillFromDataStream(res.config);
-			temp_vars.general.TimeLimit = timelimit_value;				
-			
-			unsigned int start_time = platform::TICKS();				
-			action_error = recognition_helpers::performFileAction(false, temp_vars, image_name, "", ctx.output_file);				
-			unsigned int end_time = platform::TICKS();		
-			cur_work_time = end_time - start_time;
-		}		
+			imago::Settings temp_vars = config_vars;
+			temp_vars.general.TimeLimit = timelimit_value;
+
+			unsigned int start_time = platform::TICKS();
+			recognition_helpers::RecognitionResult recognized = recognition_helpers::recognizeFile(temp_vars, image_name, "");
+			unsigned int end_time = platform::TICKS();
+			result.work_time = end_time - start_time;
+			result.action_error = recognized.aborted ? 2 : 0; // as performFileAction, failed filters are not an error
+			molecule = recognized.molecule;
+		}
 
-		if (cur_work_time > timelimit_value)
+		if (result.work_time > timelimit_value)
 		{
-			if (init)
-			{
-				printf("TL: %g ms\n", cur_work_time);
-				ctx.valid = false; // not valid for learning
-			}
+			result.timeout = true;
+			return result;
 		}
-		else
+
+		try
 		{
-			try
+			if (similarity_tools::isExternalSimilarityTool())
 			{
-				cur_similarity = similarity_tools::getSimilarity(ctx);
-				if (init)
+				// the external tool compares files
 				{
-					printf("%g (%g ms)\n", cur_similarity, cur_work_time);
+					imago::FileOutput fout(ctx.output_file.c_str());
+					fout.writeString(molecule.c_str());
 				}
+				result.similarity = similarity_tools::getSimilarity(ctx);
 			}
-			catch(imago::ImagoException &e)
+			else
 			{
-				printf("%s\n", e.what());
-				if (init)
-					ctx.valid = false;
+				result.similarity = similarity_tools::getSimilarity(molecule, ctx.reference_file);
 			}
-			catch(std::exception &e)
+		}
+		catch(imago::ImagoException &e)
+		{
+			result.error = e.what();
+		}
+		catch(std::exception &e)
+		{
+			result.error = std::string("Similarity internal exception: ") + e.what();
+		}
+		catch(...)
+		{
+			result.error = "Similarity unknown exception";
+		}
+
+		return result;
+	}
+
+	void applyEvaluation(LearningContext& ctx, LearningResultRecord& res, const ItemEvaluation& eval, bool init)
+	{
+		double cur_work_time = eval.work_time;
+		double cur_similarity = 0.0;
+
+		if (eval.timeout)
+		{
+			if (init)
 			{
-				printf("Similarity internal exception: %s\n", e.what());
-				if (init)
-					ctx.valid = false;
+				printf("TL: %g ms\n", cur_work_time);
+				ctx.valid = false; // not valid for learning
 			}
-			catch(...)
+		}
+		else if (!eval.error.empty())
+		{
+			printf("%s\n", eval.error.c_str());
+			if (init)
+				ctx.valid = false;
+		}
+		else
+		{
+			cur_similarity = eval.similarity;
+			if (init)
 			{
-				printf("Similarity unknown exception\n");
-				if (init)
-					ctx.valid = false;
+				printf("%g (%g ms)\n", cur_similarity, cur_work_time);
 			}
 		}
 
@@ -227,7 +312,7 @@ namespace machine_learning
 			res.ok_count++;
 		}
 			
-		double cur_stability = (action_error == 0) ? 1.0 : 0.0;
+		double cur_stability = (eval.action_error == 0) ? 1.0 : 0.0;
 
 		if (init)
 		{
@@ -250,6 +335,67 @@ namespace machine_learning
 		ctx.time = cur_work_time;
 	}
 
+	void runSingleItem(LearningContext& ctx, LearningResultRecord& res, const std::string& image_name, int timelimit_value, bool init)
+	{
+		imago::Settings config_vars;
+		config_vars.fillFromDataStream(res.config);
+		applyEvaluation(ctx, res, evaluateItem(ctx, config_vars, image_name, timelimit_value), init);
+	}
+
+	ParallelEvaluator::ParallelEvaluator(int threads, int loadMaxDimension) : _loadMaxDimension(loadMaxDimension)
+	{
+		if (threads != 1)
+			_pool.reset(new imago::ThreadPool(threads));
+		size_t workers = _pool ? _pool->size() : 0;
+		_sessions.resize(workers, 0);
+		_initialized.resize(workers, 0);
+	}
+
+	ParallelEvaluator::~ParallelEvaluator()
+	{
+		_pool.reset(); // joins the workers
+		for (size_t t = 0; t < _sessions.size(); t++)
+			if (_initialized[t])
+				indigoReleaseSessionId(_sessions[t]);
+	}
+
+	void ParallelEvaluator::evaluate(const std::vector<LearningBase::iterator>& items, size_t start, size_t end,
+	                                 const std::string& config, int timelimit_value, std::vector<ItemEvaluation>& results)
+	{
+		imago::Settings config_vars;
+		config_vars.fillFromDataStream(config);
+		config_vars.general.LoadMaxDimension = _loadMaxDimension;
+		if (_pool)
+			config_vars.general.MaxThreads = 1; // images are already processed in parallel
+
+		results.clear();
+		results.resize(end - start);
+
+		for (size_t idx = start; idx < end; idx++)
+		{
+			imago::ThreadPool::Task task = [&, idx](int worker)
+			{
+				if (_pool && !_initialized[worker])
+				{
+					// Indigo sessions are not shared between threads
+					_sessions[worker] = indigoAllocSessionId();
+					indigoSetSessionId(_sessions[worker]);
+					_initialized[worker] = 1;
+				}
+				if (items[idx]->second.valid)
+					results[idx - start] = evaluateItem(items[idx]->second, config_vars, items[idx]->first, timelimit_value);
+			};
+
+			if (_pool)
+				_pool->enqueue(task);
+			else
+				task(0);
+		}
+
+		if (_pool)
+			_pool->wait();
+	}
+
 	bool updateResult(LearningResultRecord& result_record, LearningHistory& history)
 	{
 		if (result_record.valid_count)
@@ -397,13 +543,24 @@ namespace machine_learning
 		BreakIterationException() : imago::ImagoException("break") { }
 	};
 
-	int performMachineLearning(imago::Settings& vars, const strings& imageSet, const std::string& configName)
+	int performMachineLearning(imago::Settings& vars, const strings& imageSet, const std::string& configName, int threads)
 	{
 		int result = 0; // ok mark
 		int timelimit_default_value = vars.general.TimeLimit;
+
+		// the log is global and not thread-safe
+		if (vars.general.LogEnabled || vars.general.LogVFSEnabled)
+			threads = 1;
 	
+		// mutated constants mostly affect the stages after the prefilters,
+		// so the binarized images are reused between the configs
+		if (imago::PrefilterCache::getInstance() == NULL)
+			imago::PrefilterCache::enable(LEARNING_PREFILTER_CACHE_BYTES);
+
 		try
 		{
+			ParallelEvaluator evaluator(threads);
+
 			LearningBase base;
 			LearningHistory history;
 			int work_iteration = 1;
@@ -436,34 +593,7 @@ namespace machine_learning
 
 				// step 0: prepare learning base
 				printf("[Learning] filling learning base for %u images\n", (unsigned)imageSet.size());
-				for (size_t u = 0; u < imageSet.size(); u++)
-				{			
-					const std::string& file = imageSet[u];
-
-					LearningContext ctx;
-					if (file_helpers::getReferenceFileName(file, ctx.reference_file))
-					{
-						try
-						{
-							imago::FileScanner fsc("%s", ctx.reference_file.c_str());
-					
-							ctx.valid = true;
-						}
-						catch (imago::FileNotFoundException&)
-						{
-							printf("[ERROR] Can not open reference file: '%s'\n", ctx.reference_file.c_str());
-						}
-					}
-					else
-					{
-						printf("[ERROR] Can not obtain reference filename for: '%s'\n", file.c_str());
-					}
-
-					// TODO: probably is better to place them in some temp folder
-					ctx.output_file = file + ".temp.mol";
-
-					base[file] = ctx;
-				}
+				fillLearningBase(imageSet, base);
 				
 				// step 1: get initial results
 				printf("[Learning] getting initial results for %u images\n", (unsigned)base.size());
@@ -472,27 +602,39 @@ namespace machine_learning
 				LearningResultRecord result_record;
 				vars.saveToDataStream(result_record.config);
 
+				std::vector<LearningBase::iterator> items;
 				for (LearningBase::iterator it = base.begin(); it != base.end(); it++)
+					items.push_back(it);
+
+				std::vector<ItemEvaluation> evaluations;
+				for (size_t first = 0; first < items.size(); first += evaluator.batchSize())
 				{
-					printf("Image (%u/%u): %s... ", ++visual_counter, (unsigned)base.size(), it->first.c_str());
+					size_t last = std::min(first + evaluator.batchSize(), items.size());
+					evaluator.evaluate(items, first, last, result_record.config, timelimit_default_value, evaluations);
 
-					if (!it->second.valid)
+					for (size_t idx = first; idx < last; idx++)
 					{
-						printf("skipped\n");
-					}
-					else
-					{									
-						runSingleItem(it->second, result_record, it->first, timelimit_default_value, true /*init*/);
-						if (it->second.valid)
+						LearningBase::iterator it = items[idx];
+						printf("Image (%u/%u): %s... ", ++visual_counter, (unsigned)base.size(), it->first.c_str());
+
+						if (!it->second.valid)
 						{
-							result_record.valid_count++;
+							printf("skipped\n");
+						}
+						else
+						{									
+							applyEvaluation(it->second, result_record, evaluations[idx - first], true /*init*/);
+							if (it->second.valid)
+							{
+								result_record.valid_count++;
+							}
 						}
-					}
 
-					if (visual_counter % 10 == 1)
-					{
-						printf("*** OK: %u/%u, SCORE: %g, TIME: %g ms\n", result_record.ok_count, visual_counter, 
-							  result_record.average_score / visual_counter, result_record.average_time / visual_counter);
+						if (visual_counter % 10 == 1)
+						{
+							printf("*** OK: %u/%u, SCORE: %g, TIME: %g ms\n", result_record.ok_count, visual_counter, 
+								  result_record.average_score / visual_counter, result_record.average_time / visual_counter);
+						}
 					}
 				}
 
@@ -622,8 +764,22 @@ namespace machine_learning
 
 						int count = end_idx - start_idx;
 
+						// the quickcheck subset is evaluated at once, the rest in small batches
+						// to keep the early skipping of bad configs
+						size_t batch = quick_check ? (end_idx - start_idx) : evaluator.batchSize();
+						size_t evaluated_start = start_idx, evaluated_end = start_idx;
+						std::vector<ItemEvaluation> evaluations;
+
 						for (size_t idx = start_idx; idx < end_idx; idx++)
 						{
+							if (idx == evaluated_end)
+							{
+								evaluated_start = idx;
+								evaluated_end = std::min(idx + batch, end_idx);
+								evaluator.evaluate(valid_indexes, evaluated_start, evaluated_end, res.config,
+								                   timelimit_default_value, evaluations);
+							}
+
 							LearningBase::iterator& it = valid_indexes[idx];
 
 							int pos = idx-start_idx + 1;
@@ -632,7 +788,7 @@ namespace machine_learning
 							try
 							{
 								double avg_time = it->second.average_time;
-								runSingleItem(it->second, res, it->first, timelimit_default_value);
+								applyEvaluation(it->second, res, evaluations[idx - evaluated_start]);
 								if (quick_check &&
 									it->second.time > LEARNING_SUSPICIOUS_TIME_FACTOR * avg_time &&
 									it->second.time > LEARNING_ABNORMAL_TIME)
@@ -708,6 +864,7 @@ namespace machine_learning
 					if (updateResult(res, history))
 					{
 						storeLearningProgress(base, history);
+						storePrefilterCache();
 					}
 
 					bool all_ok = res.valid_count == res.ok_count;
@@ -750,4 +907,107 @@ namespace machine_learning
 		return result;
 	}
 
+	int performClusterTraining(imago::Settings& vars, const strings& imageSet, const strings& configFiles,
+	                           const std::string& modelFile, int threads)
+	{
+		// the log is global and not thread-safe
+		if (vars.general.LogEnabled || vars.general.LogVFSEnabled)
+			threads = 1;
+
+		try
+		{
+			// the configs are compared on the images the recognition will see (-loadmax)
+			ParallelEvaluator evaluator(threads, vars.general.LoadMaxDimension);
+
+			LearningBase base;
+			printf("[Clusters] filling learning base for %u images\n", (unsigned)imageSet.size());
+			fillLearningBase(imageSet, base);
+
+			std::vector<LearningBase::iterator> items;
+			for (LearningBase::iterator it = base.begin(); it != base.end(); it++)
+				items.push_back(it);
+
+			// the best config for every image: max similarity, then min time
+			std::vector<int> assignment(items.size(), -1);
+			std::vector<ItemEvaluation> best(items.size());
+
+			for (size_t c = 0; c < configFiles.size(); c++)
+			{
+				std::string config;
+				{
+					imago::FileScanner fi("%s", configFiles[c].c_str());
+					fi.readAll(config);
+				}
+				printf("[Clusters] evaluating config '%s'\n", configFiles[c].c_str());
+
+				std::vector<ItemEvaluation> evaluations;
+				for (size_t first = 0; first < items.size(); first += evaluator.batchSize())
+				{
+					size_t last = std::min(first + evaluator.batchSize(), items.size());
+					evaluator.evaluate(items, first, last, config, vars.general.TimeLimit, evaluations);
+
+					for (size_t idx = first; idx < last; idx++)
+					{
+						const ItemEvaluation& eval = evaluations[idx - first];
+						if (!items[idx]->second.valid || eval.timeout || !eval.error.empty() || eval.similarity <= 0.0)
+							continue;
+
+						if (assignment[idx] < 0 || eval.similarity > best[idx].similarity + imago::EPS ||
+							(eval.similarity > best[idx].similarity - imago::EPS && eval.work_time < best[idx].work_time))
+						{
+							assignment[idx] = (int)c;
+							best[idx] = eval;
+						}
+					}
+				}
+			}
+
+			std::vector<imago::ImageFeatures> features(items.size());
+			std::vector<int> counts(configFiles.size(), 0);
+			for (size_t idx = 0; idx < items.size(); idx++)
+			{
+				if (!items[idx]->second.valid)
+					continue;
+				try
+				{
+					imago::Image image;
+					imago::ImageUtils::loadImageFromFile(image, items[idx]->first, vars.general.LoadMaxDimension);
+					features[idx].compute(image);
+				}
+				catch (std::exception &e)
+				{
+					printf("[ERROR] Can not load image '%s': %s\n", items[idx]->first.c_str(), e.what());
+					assignment[idx] = -1;
+				}
+				if (assignment[idx] >= 0)
+					counts[assignment[idx]]++;
+			}
+
+			for (size_t c = 0; c < configFiles.size(); c++)
+				printf("[Clusters] config '%s': best for %u images\n", configFiles[c].c_str(), counts[c]);
+
+			imago::ClusterModel model;
+			model.train(configFiles, features, assignment);
+			if (model.size() == 0)
+			{
+				printf("[ERROR] No images are recognized by the configs\n");
+				return 5;
+			}
+
+			if (!model.storeToFile(modelFile))
+			{
+				printf("[ERROR] Can't store the cluster model to '%s'\n", modelFile.c_str());
+				return 2;
+			}
+			printf("[Clusters] model of %u clusters is stored to '%s'\n", (unsigned)model.size(), modelFile.c_str());
+		}
+		catch (std::exception &e)
+		{
+			puts(e.what());
+			return 2;
+		}
+
+		return 0;
+	}
+
 }
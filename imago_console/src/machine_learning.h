@@ -17,21 +17,75 @@
 #ifndef _machine_learning_h
 #define _machine_learning_h
 
+#include <memory>
 #include <string>
+#include <vector>
+#include "comdef.h"
 #include "learning_context.h"
 #include "file_helpers.h"
 #include "settings.h"
+#include "thread_pool.h"
 
 namespace machine_learning
 {
+	// outcome of a single image recognition, computed without touching the learning base
+	struct ItemEvaluation
+	{
+		int action_error;
+		double work_time;
+		double similarity;
+		bool timeout;
+		std::string error; // similarity calculation failure
+
+		ItemEvaluation() : action_error(0), work_time(0.0), similarity(0.0), timeout(false) { }
+	};
+
+	// evaluates the learning items in parallel, each worker with own Indigo session
+	class ParallelEvaluator
+	{
+	public:
+		// threads <= 0 means all hardware threads, 1 - in the calling thread;
+		// images are loaded as by the recognition with the same LoadMaxDimension
+		ParallelEvaluator(int threads, int loadMaxDimension = 0);
+		~ParallelEvaluator();
+
+		// evaluates valid items[start .. end-1] with the config, results[i] corresponds to items[start + i]
+		void evaluate(const std::vector<LearningBase::iterator>& items, size_t start, size_t end,
+		              const std::string& config, int timelimit_value, std::vector<ItemEvaluation>& results);
+
+		// count of items worth to evaluate at once
+		size_t batchSize() const { return _pool ? 2 * _pool->size() : 1; }
+
+	private:
+		std::unique_ptr<imago::ThreadPool> _pool;
+		std::vector<qword> _sessions;
+		std::vector<char> _initialized; // not vector<bool>: written from different threads
+		int _loadMaxDimension;
+
+		ParallelEvaluator(const ParallelEvaluator&);
+		ParallelEvaluator& operator=(const ParallelEvaluator&);
+	};
+
+	// the prefilter cache is stored to the file together with the learning progress
+	void setPrefilterCacheFile(const std::string& filename);
+
+	// items of the images with reference molfiles are marked valid
+	void fillLearningBase(const strings& imageSet, LearningBase& base);
 	double getWorstAllowedDelta(int imagesCount = 0);
 	std::string modifyConfig(const std::string& config, const LearningBase& learning, int iteration);
+	ItemEvaluation evaluateItem(const LearningContext& ctx, const imago::Settings& config_vars, const std::string& image_name, int timelimit_value);
+	void applyEvaluation(LearningContext& ctx, LearningResultRecord& res, const ItemEvaluation& eval, bool init = false);
 	void runSingleItem(LearningContext& ctx, LearningResultRecord& res, const std::string& image_name, int timelimit_value, bool init = false);
 	bool updateResult(LearningResultRecord& result_record, LearningHistory& history);
 	bool storeConfig(const LearningResultRecord& res, const std::string& prefix = "");
 	bool readLearningProgress(LearningBase& base, LearningHistory& history, bool quiet = false, const std::string& filename = "learning_progress.dat");
 	bool storeLearningProgress(const LearningBase& base, const LearningHistory& history, const std::string& filename = "learning_progress.dat");
-	int performMachineLearning(imago::Settings& vars, const strings& imageSet, const std::string& configName);
+	// images are evaluated using up to 'threads' worker threads (log forces 1)
+	int performMachineLearning(imago::Settings& vars, const strings& imageSet, const std::string& configName, int threads = 1);
+	// recognizes the images with every config, assigns every image to the best one
+	// and stores the nearest-centroid model of the image features to 'modelFile'
+	int performClusterTraining(imago::Settings& vars, const strings& imageSet, const strings& configFiles,
+	                           const std::string& modelFile, int threads = 1);
 }
 
 #endif
\ No newline at end of file
@@ -16,8 +16,52 @@
 #include "recognition_helpers.h"
 #include "machine_learning.h"
 #include "similarity_tools.h"
+#include "benchmark.h"
+#include "regression.h"
 #include "settings.h"
 #include "log_ext.h"
+#include "image_utils.h"
+#include "tiff_document.h"
+#include "prefilter_cache.h"
+#include "trace_sink.h"
+#include "pipeline_counters.h"
+#include "memory_budget.h"
+#include "cluster_model.h"
+
+#include <memory>
+
+const size_t PREFILTER_CACHE_BYTES = 512 * 1024 * 1024;
+
+// stores the prefilter cache on any exit from main
+struct PrefilterCacheStorage
+{
+	std::string filename;
+
+	~PrefilterCacheStorage()
+	{
+		imago::PrefilterCache* cache = imago::PrefilterCache::getInstance();
+		if (cache != NULL && !filename.empty() && !cache->storeToFile(filename))
+			printf("[ERROR] Can't store the prefilter cache to '%s'\n", filename.c_str());
+	}
+};
+
+// prints the pipeline counters on any exit from main
+struct StatisticsPrinter
+{
+	bool enabled;
+
+	StatisticsPrinter() : enabled(false) {}
+
+	~StatisticsPrinter()
+	{
+		if (!enabled)
+			return;
+		std::string text;
+		imago::pipeline_counters::getProcessCounters().writeText(text);
+		imago::memory_budget::getProcessAccount().writeText(text);
+		printf("Pipeline counters:\n%s", text.c_str());
+	}
+};
 
 int main(int argc, char **argv)
 {
@@ -31,23 +75,43 @@ int main(int argc, char **argv)
 		printf("  image_path: full path to image to recognize (may be omitted if other switch is specified) \n");
 		printf("  -o output_file: save single recognition result to the specified file \n");
 		printf("  -characters: extracts only characters from image(s) and store in ./characters/ \n");
-		printf("  -learn dir_name: process machine learning for specified collection \n");
+		printf("  -learn dir_name: process machine learning for specified collection (-j threads is supported) \n");
+		printf("  -trainclusters cfg1,cfg2,... dir_name: train the cluster model (-clusters) on the collection \n");
+		printf("  -bench dir_name: measure per-stage timings on the images of the collection \n");
+		printf("    -iter count: recognize every image specified times (default is 3) \n");
+		printf("    -json file_name: store the timings as JSON ('-' for stdout) \n");
+		printf("  -regress dir_name: check recognition of the images with reference molfiles (-j threads is supported) \n");
+		printf("    -report file_name: store JUnit XML report (default is report.xml) \n");
 		printf("  -compare molfile1 molfile2: calculate similarity between molfiles \n");
 		printf("    -retcode: returns similarity 0..100 in ERRORLEVEL \n");
 		printf("\n OPTION SWITCHES: \n");
 		printf("  -config cfg_file: use specified configuration cluster file \n");		
+		printf("  -clusters model_file: select the configuration cluster by the image features \n");
 		printf("  -log: enables debug log output to ./log.html \n");
 		printf("  -logvfs: stores log in single encoded file ./log_vfs.txt \n");		
 		printf("  -noexp: do not expand chemical abbreviations \n");		
+		printf("  -validateexp: check the abbreviations expansion against Indigo \n");
 		printf("  -pr: use probablistic separator (experimental) \n");
 		printf("  -tl time_in_ms: timelimit per single image process (default is %u) \n", vars.general.TimeLimit);
 		printf("  -similarity tool [-sparam additional_parameters]: override the default comparison method \n");
 		printf("  -pass: don't process images, only print their filenames \n");
 		printf("  -override config_string: override config by applying specified string \n");
+		printf("  -pcache file_name: reuse prefilter results, keep them in the file between runs \n");
+		printf("  -trace file_name: store the recognition timeline in Chrome trace format \n");
+		printf("  -stats: print pipeline counters (segments, templates compared, restarts etc.) on exit \n");
+		printf("  -membudget megabytes: fail the image when its large buffers exceed the budget \n");
+		printf("  -loadmax pixels: decode larger images at reduced resolution, down to this longest side \n");
 		printf("\n BATCHES: \n");
 		printf("  -dir dir_name: process every image from dir dir_name \n");
 		printf("    -rec: process directory recursively \n");
 		printf("    -images: skip non-supported files from directory \n");				
+		printf("    -j threads: process files in parallel (0 - all cores, log forces 1) \n");
+		printf("    -ordered: print parallel progress in files order \n");
+		printf("    -sdf file_name: store all results into single SD file ('-' for stdout) \n");
+		printf("    -manifest file_name: record processed items into the checkpoint manifest \n");
+		printf("    -resume: skip items completed in the manifest, quarantine ones crashed twice \n");
+		printf("    -tracerate fraction: store timelines of the part of files to <file>.trace.json \n");
+		printf("  pages of multi-page TIFF files are recognized separately (also with -j) \n");
 		printf("\n SHORTCUTS: \n");
 		printf("  -learnd dir_name: -learn -dir dir_name -images \n");
 		return 0;
@@ -62,6 +126,15 @@ int main(int argc, char **argv)
 	std::string molfile2 = "";
 	std::string override_cfg = "";
 	std::string output = "molecule.mol";
+	std::string sdf = "";
+	std::string manifest = "";
+	std::string json = "";
+	std::string pcache = "";
+	std::string report = "report.xml";
+	std::string trace = "";
+	std::string clusters = "";
+	strings cluster_configs;
+	double trace_rate = 0.0;
 
 	bool next_arg_dir = false;
 	bool next_arg_config = false;
@@ -70,6 +143,19 @@ int main(int argc, char **argv)
 	bool next_arg_tl = false;	
 	bool next_arg_override_cfg = false;
 	bool next_arg_output = false;
+	bool next_arg_threads = false;
+	bool next_arg_sdf = false;
+	bool next_arg_manifest = false;
+	bool next_arg_iterations = false;
+	bool next_arg_json = false;
+	bool next_arg_pcache = false;
+	bool next_arg_membudget = false;
+	bool next_arg_loadmax = false;
+	bool next_arg_report = false;
+	bool next_arg_trace = false;
+	bool next_arg_trace_rate = false;
+	bool next_arg_clusters = false;
+	bool next_arg_cluster_configs = false;
 	int next_arg_compare = 0; // two args
 
 	bool mode_recursive = false;
@@ -78,6 +164,14 @@ int main(int argc, char **argv)
 	bool mode_filter = false;
 	bool mode_retcode = false;
 	bool mode_test_filter_only = false;
+	bool mode_ordered = false;
+	bool mode_resume = false;
+	bool mode_bench = false;
+	bool mode_regress = false;
+	bool mode_stats = false;
+	bool mode_train_clusters = false;
+	int threads = 1;
+	int iterations = 3;
 
 	for (int c = 1; c < argc; c++)
 	{
@@ -95,6 +189,9 @@ int main(int argc, char **argv)
 		else if (param == "-noexp")
 			vars.general.ExpandAbbreviations = false;
 
+		else if (param == "-validateexp")
+			vars.general.ValidateAbbreviations = true;
+
 		else if (param == "-pr" || param == "-probablistic")
 			vars.general.UseProbablistics = true;
 
@@ -145,9 +242,72 @@ int main(int argc, char **argv)
 		else if (param == "-pass")
 			mode_pass = true;
 
+		else if (param == "-bench")
+		{
+			mode_bench = true;
+			next_arg_dir = true;
+		}
+
+		else if (param == "-regress")
+		{
+			mode_regress = true;
+			next_arg_dir = true;
+		}
+
+		else if (param == "-report")
+			next_arg_report = true;
+
+		else if (param == "-trace")
+			next_arg_trace = true;
+
+		else if (param == "-tracerate")
+			next_arg_trace_rate = true;
+
+		else if (param == "-stats")
+			mode_stats = true;
+
+		else if (param == "-membudget")
+			next_arg_membudget = true;
+
+		else if (param == "-loadmax")
+			next_arg_loadmax = true;
+
+		else if (param == "-iter")
+			next_arg_iterations = true;
+
+		else if (param == "-json")
+			next_arg_json = true;
+
+		else if (param == "-pcache")
+			next_arg_pcache = true;
+
+		else if (param == "-j")
+			next_arg_threads = true;
+
+		else if (param == "-ordered")
+			mode_ordered = true;
+
+		else if (param == "-sdf")
+			next_arg_sdf = true;
+
+		else if (param == "-manifest")
+			next_arg_manifest = true;
+
+		else if (param == "-resume")
+			mode_resume = true;
+
 		else if (param == "-config")
 			next_arg_config = true;
 
+		else if (param == "-clusters")
+			next_arg_clusters = true;
+
+		else if (param == "-trainclusters")
+		{
+			mode_train_clusters = true;
+			next_arg_cluster_configs = true;
+		}
+
 		else if (param == "-characters")
 			vars.general.ExtractCharactersOnly = true;
 
@@ -175,6 +335,25 @@ int main(int argc, char **argv)
 				config = param;
 				next_arg_config = false;
 			}
+			else if (next_arg_clusters)
+			{
+				clusters = param;
+				next_arg_clusters = false;
+			}
+			else if (next_arg_cluster_configs)
+			{
+				for (size_t start = 0; start <= param.size(); )
+				{
+					size_t end = param.find(',', start);
+					if (end == std::string::npos)
+						end = param.size();
+					if (end > start)
+						cluster_configs.push_back(param.substr(start, end - start));
+					start = end + 1;
+				}
+				next_arg_cluster_configs = false;
+				next_arg_dir = true;
+			}
 			else if (next_arg_dir)
 			{
 				dir = param;
@@ -190,6 +369,61 @@ int main(int argc, char **argv)
 				sim_param = param;
 				next_arg_sim_param = false;
 			}
+			else if (next_arg_manifest)
+			{
+				manifest = param;
+				next_arg_manifest = false;
+			}
+			else if (next_arg_trace)
+			{
+				trace = param;
+				next_arg_trace = false;
+			}
+			else if (next_arg_trace_rate)
+			{
+				trace_rate = atof(param.c_str());
+				next_arg_trace_rate = false;
+			}
+			else if (next_arg_report)
+			{
+				report = param;
+				next_arg_report = false;
+			}
+			else if (next_arg_pcache)
+			{
+				pcache = param;
+				next_arg_pcache = false;
+			}
+			else if (next_arg_membudget)
+			{
+				imago::memory_budget::setDefaultLimit((size_t)atoi(param.c_str()) << 20);
+				next_arg_membudget = false;
+			}
+			else if (next_arg_loadmax)
+			{
+				vars.general.LoadMaxDimension = atoi(param.c_str());
+				next_arg_loadmax = false;
+			}
+			else if (next_arg_json)
+			{
+				json = param;
+				next_arg_json = false;
+			}
+			else if (next_arg_iterations)
+			{
+				iterations = atoi(param.c_str());
+				next_arg_iterations = false;
+			}
+			else if (next_arg_sdf)
+			{
+				sdf = param;
+				next_arg_sdf = false;
+			}
+			else if (next_arg_threads)
+			{
+				threads = atoi(param.c_str());
+				next_arg_threads = false;
+			}
 			else if (next_arg_tl)
 			{
 				vars.general.TimeLimit = atoi(param.c_str());
@@ -232,6 +466,33 @@ int main(int argc, char **argv)
 	if (!override_cfg.empty())
 		vars.fillFromDataStream(override_cfg);	
 
+	imago::trace_sink::setSampleRate(trace_rate);
+
+	// the file given by -config wins over the model
+	if (!clusters.empty() && !mode_train_clusters && config.empty())
+	{
+		std::shared_ptr<imago::ClusterModel> model = std::make_shared<imago::ClusterModel>();
+		if (!model->loadFromFile(clusters))
+		{
+			printf("[ERROR] Can't load the cluster model from '%s'\n", clusters.c_str());
+			return 2;
+		}
+		vars.setClusterModel(model);
+	}
+
+	StatisticsPrinter statisticsPrinter;
+	statisticsPrinter.enabled = mode_stats;
+
+	PrefilterCacheStorage pcacheStorage;
+	if (!pcache.empty())
+	{
+		imago::PrefilterCache::enable(PREFILTER_CACHE_BYTES);
+		if (imago::PrefilterCache::getInstance()->loadFromFile(pcache))
+			printf("Prefilter cache loaded from '%s'\n", pcache.c_str());
+		pcacheStorage.filename = pcache;
+		machine_learning::setPrefilterCacheFile(pcache);
+	}
+
 	if (mode_test_filter_only)
 	{
 		return recognition_helpers::performFilterTest(vars, image);
@@ -272,35 +533,97 @@ int main(int argc, char **argv)
 			return 2;
 		}
 
-		if (mode_filter || mode_learning)
+		if (mode_filter || mode_learning || mode_bench || mode_regress || mode_train_clusters)
 		{
 			file_helpers::filterOnlyImages(files);
 		}
 
 		if (mode_learning)
 		{			
-			return machine_learning::performMachineLearning(vars, files, config);
+			return machine_learning::performMachineLearning(vars, files, config, threads);
+		}
+		else if (mode_train_clusters)
+		{
+			if (clusters.empty())
+			{
+				printf("[ERROR] The model file should be specified by -clusters\n");
+				return 1;
+			}
+			return machine_learning::performClusterTraining(vars, files, cluster_configs, clusters, threads);
+		}
+		else if (mode_bench)
+		{
+			return benchmark::performBenchmark(vars, files, config, iterations, json);
 		}
-		else // process or pass
+		else if (mode_regress)
+		{
+			return regression::performRegression(vars, files, config, threads, report);
+		}
+		else if (mode_pass)
 		{
 			for (size_t u = 0; u < files.size(); u++)
 			{
-				if (mode_pass)
-				{
-					printf("Skipped file '%s'\n", files[u].c_str());
-				}
-				else
+				printf("Skipped file '%s'\n", files[u].c_str());
+			}
+		}
+		else
+		{
+			if (mode_resume && manifest.empty())
+			{
+				printf("[ERROR] -resume requires -manifest file_name\n");
+				return 1;
+			}
+
+			try
+			{
+				std::unique_ptr<batch_manifest::BatchManifest> batchManifest;
+				if (!manifest.empty())
+					batchManifest.reset(new batch_manifest::BatchManifest(manifest, mode_resume));
+
+				std::unique_ptr<sdf_writer::SdfWriter> writer;
+				if (!sdf.empty() && !vars.general.ExtractCharactersOnly)
 				{
-					std::string output_file = files[u] + ".result.mol";
-					recognition_helpers::performFileAction(true, vars, files[u], config, output_file);	
+					// resumed runs keep the records of completed items
+					writer.reset(new sdf_writer::SdfWriter(sdf, mode_resume && sdf != "-"));
+					writer->setAutoFlush(batchManifest.get() != NULL);
 				}
+
+				recognition_helpers::performFilesActions(threads, mode_ordered, vars, files, config,
+				                                         writer.get(), batchManifest.get());
+			}
+			catch (imago::ImagoException &e)
+			{
+				printf("[ERROR] %s\n", e.what());
+				return 2;
 			}
 		}
 	}
 	else if (!image.empty())
 	{
 		// single item mode
-		return recognition_helpers::performFileAction(true, vars, image, config, output);	
+		// only the page directories are read here, errors are reported by the single file action
+		if (imago::ImageUtils::isMultiPageFile(image) && !vars.general.ExtractCharactersOnly &&
+		    imago::TiffDocument::countPages(image) > 1)
+		{
+			// pages are stored to <image>.page<N>.result.mol
+			strings files(1, image);
+			return recognition_helpers::performFilesActions(threads, true, vars, files, config);
+		}
+
+		std::unique_ptr<imago::trace_sink::Recorder> recorder;
+		if (!trace.empty())
+			recorder.reset(new imago::trace_sink::Recorder());
+
+		int result = 0;
+		{
+			imago::trace_sink::ScopedRecording recording(recorder.get());
+			result = recognition_helpers::performFileAction(true, vars, image, config, output);
+		}
+
+		if (recorder && !recorder->storeToFile(trace))
+			printf("[ERROR] Can't store the trace to '%s'\n", trace.c_str());
+
+		return result;
 	}		
 	
 	return 1; // "nothing to do" error
@@ -6,8 +6,19 @@
 #include "superatom_expansion.h"
 #include "log_ext.h"
 #include "image_utils.h"
+#include "tiff_document.h"
 #include "indigo.h"
 #include "indigo-renderer.h"
+#include "platform_tools.h"
+#include "thread_pool.h"
+#include "trace_sink.h"
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 
 // Required for indigo-renderer:
 #ifdef _WIN32
@@ -22,12 +33,11 @@ namespace recognition_helpers
 		if (!vfs.empty())
 		{
 			imago::FileOutput filedump(filename.c_str());
-			std::vector<char> data;		
-			vfs.getData(data); 
-			filedump.write(&data.at(0), data.size());
+			vfs.writeData(filedump);
 		}
 	}
 
+	// the cluster chosen by the model is already selected by prefilterEntrypoint
 	void applyConfig(bool verbose, imago::Settings& vars, const std::string& config)
 	{
 		if (!config.empty())
@@ -45,10 +55,6 @@ namespace recognition_helpers
 					printf("FAIL\n");
 			}
 		}
-		else
-		{
-			vars.selectBestCluster();
-		}
 	}
 
 
@@ -59,6 +65,11 @@ namespace recognition_helpers
 		imago::ChemicalStructureRecognizer _csr;
 		imago::Molecule mol;
 
+		// every image has its own budget (-membudget)
+		imago::memory_budget::Account memory;
+		imago::memory_budget::ScopedAccount accounting(&memory);
+
+		bool timeout = false;
 		for (int iter = 0; ; iter++)
 		{
 			bool good = false;
@@ -67,6 +78,7 @@ namespace recognition_helpers
 
 			try
 			{
+				imago::memory_budget::Reservation imgMemory(src.total());
 				imago::Image img;
 
 				if (iter == 0)
@@ -84,22 +96,29 @@ namespace recognition_helpers
 				_csr.image2mol(vars, img, mol);
 
 				RecognitionResult result;
+				result.filter = vars.general.FilterIndex;
 				result.molecule = imago::expandSuperatoms(vars, mol);
-				result.warnings = mol.getWarningsCount() + mol.getDissolvingsCount() / vars.main.DissolvingsFactor;
+				result.warnings = mol.getWarningsCount() + mol.getDissolvingsCount() / vars.main().DissolvingsFactor;
 				
-				if (vars.dynamic.CapitalHeight < vars.main.MinGoodCharactersSize &&
+				if (vars.dynamic.CapitalHeight < vars.main().MinGoodCharactersSize &&
 					!vars.general.ImageAlreadyBinarized)
 				{
-					result.warnings += vars.main.WarningsForTooSmallCharacters;
+					result.warnings += vars.main().WarningsForTooSmallCharacters;
 				}
 
 				results.push_back(result);
 
-				good = result.warnings <= vars.main.WarningsRecalcTreshold;				
+				good = result.warnings <= vars.main().WarningsRecalcTreshold;				
 			
 				if (verbose)
 					printf("Filter [%u] done, warnings: %u, good: %u.\n", vars.general.FilterIndex, result.warnings, good);
 			}
+			catch (imago::TimeLimitException &e)
+			{
+				if (verbose)
+					printf("Filter [%u] exception '%s'.\n", vars.general.FilterIndex, e.what());
+				timeout = true;
+			}
 			catch (std::exception &e)
 			{
 				if (verbose)
@@ -121,6 +140,7 @@ namespace recognition_helpers
 				result = results[u];
 			}
 		}
+		result.timeout = timeout;
 		return result;
 	}
 
@@ -131,7 +151,7 @@ namespace recognition_helpers
 		try
 		{
 			imago::Image image;
-			imago::ImageUtils::loadImageFromFile(image, imageName.c_str());
+			imago::ImageUtils::loadImageFromFile(image, imageName, vars.general.LoadMaxDimension);
 			
 			imago::Image out;
 			if (!imago::prefilterEntrypoint(vars, out, image))
@@ -174,10 +194,11 @@ namespace recognition_helpers
 
 			if (vars.general.LogVFSEnabled)
 			{
+				vfs.setCompression(true); // the log is kept only until it is dumped
 				imago::getLogExt().SetVirtualFS(vfs);
 			}
 
-			imago::ImageUtils::loadImageFromFile(image, imageName.c_str());
+			imago::ImageUtils::loadImageFromFile(image, imageName, vars.general.LoadMaxDimension);
 
 			if (vars.general.ExtractCharactersOnly)
 			{
@@ -214,8 +235,372 @@ namespace recognition_helpers
 			puts(e.what());
 		}
 
+		imago::getLogExt().flushImages();
 		dumpVFS(vfs, "log_vfs.txt");
 
 		return result;
 	}
-}
\ No newline at end of file
+
+	RecognitionResult recognizeLoadedImage(imago::Settings& vars, const imago::Image& image, const std::string& configName)
+	{
+		logEnterFunction();
+
+		RecognitionResult result;
+		vars.general.StartTime = 0; // reset timelimit
+
+		try
+		{
+			result = recognizeImage(false, vars, image, configName);
+			if (result.molecule.empty())
+				result.error = "Recognition failed with all filters";
+		}
+		catch (imago::TimeLimitException &e)
+		{
+			result.error = e.what();
+			result.aborted = true;
+			result.timeout = true;
+		}
+		catch (std::exception &e)
+		{
+			result.error = e.what();
+			result.aborted = true;
+		}
+
+		return result;
+	}
+
+	RecognitionResult recognizeFile(imago::Settings& vars, const std::string& imageName, const std::string& configName)
+	{
+		logEnterFunction();
+
+		imago::Image image;
+		try
+		{
+			imago::ImageUtils::loadImageFromFile(image, imageName, vars.general.LoadMaxDimension);
+		}
+		catch (std::exception &e)
+		{
+			RecognitionResult result;
+			result.error = e.what();
+			result.aborted = true;
+			return result;
+		}
+
+		return recognizeLoadedImage(vars, image, configName);
+	}
+
+	// decodes only the given page of the multi-page file; the document is kept open
+	// between the calls, so the directories are not read again for every page
+	static RecognitionResult recognizePage(imago::Settings& vars, imago::TiffDocument& document, const std::string& imageName, int page,
+	                                       const std::string& configName)
+	{
+		logEnterFunction();
+
+		imago::Image image;
+		try
+		{
+			if (!document.isOpen() || document.getFileName() != imageName)
+				document.open(imageName);
+			document.readPage(page, image);
+			imago::ImageUtils::fitMaxDimension(image, vars.general.LoadMaxDimension);
+		}
+		catch (std::exception &e)
+		{
+			RecognitionResult result;
+			result.error = e.what();
+			result.aborted = true;
+			return result;
+		}
+
+		return recognizeLoadedImage(vars, image, configName);
+	}
+
+	static long long addSdfRecord(sdf_writer::SdfWriter& sdf, const std::string& imageName, int page, const RecognitionResult& result,
+		                     unsigned int time)
+	{
+		char buf[32];
+		sdf_writer::DataFields fields;
+		fields.push_back(std::make_pair(std::string("SOURCE"), imageName));
+		if (page >= 0)
+		{
+			sprintf(buf, "%d", page + 1);
+			fields.push_back(std::make_pair(std::string("PAGE"), std::string(buf)));
+		}
+		sprintf(buf, "%d", result.error.empty() ? result.warnings : 0);
+		fields.push_back(std::make_pair(std::string("WARNINGS"), std::string(buf)));
+		sprintf(buf, "%d", result.filter);
+		fields.push_back(std::make_pair(std::string("FILTER"), std::string(buf)));
+		sprintf(buf, "%u", time);
+		fields.push_back(std::make_pair(std::string("TIME_MS"), std::string(buf)));
+		if (!result.error.empty())
+			fields.push_back(std::make_pair(std::string("ERROR"), result.error));
+
+		return sdf.addRecord(result.error.empty() ? result.molecule : std::string(), fields);
+	}
+
+	struct FileProgress
+	{
+		size_t file;     // index in the files list
+		std::string label;
+		bool done;
+		int result; // 0 - ok, -1 - skipped
+		unsigned int time;
+		std::string note;
+
+		FileProgress() : file(0), done(false), result(0), time(0) { }
+	};
+
+	static void printProgress(FILE* out, size_t count, const FileProgress& progress)
+	{
+		if (progress.result < 0)
+			fprintf(out, "[%u/%u] %s: SKIP (%s)\n", (unsigned int)progress.file + 1, (unsigned int)count,
+			        progress.label.c_str(), progress.note.c_str());
+		else
+			fprintf(out, "[%u/%u] %s: %s (%u ms)\n", (unsigned int)progress.file + 1, (unsigned int)count,
+			        progress.label.c_str(), progress.result == 0 ? "OK" : "FAIL", progress.time);
+	}
+
+	// one recognition task: a whole file or a single page of a multi-page file
+	struct WorkItem
+	{
+		size_t index;    // index in the progress list
+		size_t file;
+		int page;        // -1 for the whole file
+		int pages;
+		std::string key; // item name for the manifest
+		std::string hash;
+
+		WorkItem() : index(0), file(0), page(-1), pages(1) { }
+	};
+
+	int performFilesActions(int threads, bool ordered, const imago::Settings& vars, const std::vector<std::string>& files,
+		                    const std::string& configName, sdf_writer::SdfWriter* sdf,
+		                    batch_manifest::BatchManifest* manifest)
+	{
+		logEnterFunction();
+
+		// the log is global and not thread-safe
+		if (vars.general.LogEnabled || vars.general.LogVFSEnabled)
+			threads = 1;
+
+		// characters extraction works on whole files only
+		bool splitPages = !vars.general.ExtractCharactersOnly;
+
+		bool multiPage = false;
+		for (size_t u = 0; u < files.size() && splitPages; u++)
+			multiPage |= imago::ImageUtils::isMultiPageFile(files[u]);
+
+		if (threads == 1 && sdf == NULL && manifest == NULL && !multiPage && imago::trace_sink::getSampleRate() <= 0.0)
+		{
+			imago::Settings shared = vars;
+			for (size_t u = 0; u < files.size(); u++)
+				performFileAction(true, shared, files[u], configName, files[u] + ".result.mol");
+			return 0;
+		}
+
+		// grows while multi-page files are unpacked; references stay valid on push_back
+		std::deque<FileProgress> progress;
+		std::mutex progress_mutex;
+		size_t printed = 0;
+
+		// progress does not mix with the records written to stdout
+		FILE* progress_out = (sdf != NULL && sdf->isStdout()) ? stderr : stdout;
+
+		// without parallelism the calling thread processes the files with the default Indigo session
+		std::unique_ptr<imago::ThreadPool> pool;
+		if (threads != 1)
+			pool.reset(new imago::ThreadPool(threads));
+		size_t workers = pool ? pool->size() : 0;
+
+		imago::Settings workerVars = vars;
+		if (pool)
+			workerVars.general.MaxThreads = 1; // files are already processed in parallel
+
+		std::vector<qword> sessions(workers, 0);
+		std::vector<char> initialized(workers, 0); // not vector<bool>: written from different threads
+		std::unique_ptr<imago::TiffDocument[]> documents(new imago::TiffDocument[std::max<size_t>(workers, 1)]); // the last multi-page file of every worker
+
+		// the producer does not run ahead of the workers
+		size_t in_flight = 0;
+		const size_t max_in_flight = 2 * workers;
+		std::condition_variable in_flight_cv;
+
+		auto process = [&](const WorkItem& item, int worker)
+		{
+			if (pool && !initialized[worker])
+			{
+				// Indigo sessions are not shared between threads
+				sessions[worker] = indigoAllocSessionId();
+				indigoSetSessionId(sessions[worker]);
+				initialized[worker] = 1;
+			}
+
+			const std::string& file = files[item.file];
+			std::string hash = item.hash, note;
+			int result = -1;
+			unsigned int start = platform::TICKS();
+
+			if (manifest != NULL && hash.empty())
+				hash = batch_manifest::BatchManifest::hashFile(file);
+
+			if (manifest == NULL || !manifest->shouldSkip(item.key, hash, note))
+			{
+				if (manifest != NULL)
+					manifest->started(item.key, hash);
+
+				imago::Settings fileVars = workerVars;
+				long long offset = -1;
+				bool timeout = false;
+
+				// sampled items get the timeline in <item>.trace.json
+				std::unique_ptr<imago::trace_sink::Recorder> trace;
+				if (imago::trace_sink::shouldSample())
+					trace.reset(new imago::trace_sink::Recorder());
+				imago::trace_sink::ScopedRecording recording(trace.get());
+
+				// the manifest needs the failures which performFileAction does not report
+				if (sdf != NULL || item.page >= 0 || (manifest != NULL && !fileVars.general.ExtractCharactersOnly))
+				{
+					// the page is decoded by the worker, so the queue holds no images
+					RecognitionResult recognized = (item.page >= 0) ? recognizePage(fileVars, documents[worker], file, item.page, configName)
+					                                                : recognizeFile(fileVars, file, configName);
+					result = recognized.error.empty() ? 0 : 2;
+					timeout = (result != 0 && recognized.timeout);
+
+					// timed out items are retried by -resume, they get the record then
+					if (sdf != NULL && !(manifest != NULL && timeout))
+					{
+						offset = addSdfRecord(*sdf, file, item.page, recognized, platform::TICKS() - start);
+					}
+					else if (result == 0)
+					{
+						char suffix[32];
+						if (item.page >= 0)
+							sprintf(suffix, ".page%d.result.mol", item.page + 1);
+						else
+							sprintf(suffix, ".result.mol");
+						imago::FileOutput fout((file + suffix).c_str());
+						fout.writeString(recognized.molecule.c_str());
+					}
+				}
+				else
+				{
+					result = performFileAction(false, fileVars, file, configName, file + ".result.mol");
+				}
+
+				if (trace)
+				{
+					char suffix[32];
+					if (item.page >= 0)
+						sprintf(suffix, ".page%d.trace.json", item.page + 1);
+					else
+						sprintf(suffix, ".trace.json");
+					trace->storeToFile(file + suffix);
+				}
+
+				if (manifest != NULL)
+				{
+					unsigned int elapsed = platform::TICKS() - start;
+					batch_manifest::ItemStatus status = batch_manifest::STATUS_DONE;
+					if (result != 0)
+						status = timeout ? batch_manifest::STATUS_TIMEOUT : batch_manifest::STATUS_FAILED;
+					manifest->finished(item.key, hash, status, elapsed, offset);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			FileProgress& current = progress[item.index];
+			current.done = true;
+			current.result = result;
+			current.time = platform::TICKS() - start;
+			current.note = note;
+
+			if (!ordered)
+			{
+				printProgress(progress_out, files.size(), current);
+			}
+			else
+			{
+				for (; printed < progress.size() && progress[printed].done; printed++)
+					printProgress(progress_out, files.size(), progress[printed]);
+			}
+			fflush(progress_out);
+
+			if (in_flight > 0)
+				in_flight--;
+			in_flight_cv.notify_one();
+		};
+
+		auto submit = [&](WorkItem& item)
+		{
+			{
+				std::unique_lock<std::mutex> lock(progress_mutex);
+				if (pool)
+				{
+					in_flight_cv.wait(lock, [&]() { return in_flight < max_in_flight; });
+					in_flight++;
+				}
+
+				item.index = progress.size();
+				progress.push_back(FileProgress());
+				progress.back().file = item.file;
+				progress.back().label = files[item.file];
+				if (item.page >= 0)
+				{
+					char buf[64];
+					sprintf(buf, " (page %d/%d)", item.page + 1, item.pages);
+					progress.back().label += buf;
+				}
+			}
+
+			if (pool)
+				pool->enqueue([&process, item](int worker) { process(item, worker); });
+			else
+				process(item, 0);
+		};
+
+		for (size_t u = 0; u < files.size(); u++)
+		{
+			WorkItem item;
+			item.file = u;
+			item.key = files[u];
+
+			// only the page directories are read, unreadable files are reported by the whole file task
+			int pages = 0;
+			if (splitPages && imago::ImageUtils::isMultiPageFile(files[u]))
+				pages = imago::TiffDocument::countPages(files[u]);
+
+			if (pages <= 1)
+			{
+				submit(item);
+				continue;
+			}
+
+			if (manifest != NULL)
+				item.hash = batch_manifest::BatchManifest::hashFile(files[u]);
+
+			item.pages = pages;
+			for (int p = 0; p < pages; p++)
+			{
+				char buf[32];
+				sprintf(buf, "#p%d", p + 1);
+				WorkItem pageItem = item;
+				pageItem.page = p;
+				pageItem.key = files[u] + buf;
+				submit(pageItem);
+			}
+		}
+
+		if (pool)
+			pool->wait();
+
+		if (sdf != NULL)
+			sdf->flush();
+
+		for (size_t t = 0; t < sessions.size(); t++)
+			if (initialized[t])
+				indigoReleaseSessionId(sessions[t]);
+
+		return 0;
+	}
+}
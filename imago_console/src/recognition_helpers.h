@@ -18,9 +18,12 @@
 #define _recognition_helpers_h
 
 #include <string>
+#include <vector>
 #include "virtual_fs.h"
 #include "settings.h"
 #include "image.h"
+#include "sdf_writer.h"
+#include "batch_manifest.h"
 
 namespace recognition_helpers
 {
@@ -31,6 +34,12 @@ namespace recognition_helpers
 	{
 		std::string molecule;
 		int warnings;
+		int filter;        // index of the filter used
+		std::string error; // empty if recognized
+		bool aborted;      // an exception stopped the loading or recognition, not set if all filters just failed
+		bool timeout;      // some filter attempt was stopped by the time limit
+
+		RecognitionResult() : warnings(0), filter(-1), aborted(false), timeout(false) { }
 	};
 
 	RecognitionResult recognizeImage(bool verbose, imago::Settings& vars, const imago::Image& src,
@@ -41,6 +50,23 @@ namespace recognition_helpers
 	int performFileAction(bool verbose, imago::Settings& vars, const std::string& imageName, 
 		                  const std::string& configName, const std::string& outputName = "molecule.mol");
 
+	// recognizes the already loaded image, errors are returned in result.error
+	RecognitionResult recognizeLoadedImage(imago::Settings& vars, const imago::Image& image, const std::string& configName);
+
+	// loads and recognizes the image, errors are returned in result.error
+	RecognitionResult recognizeFile(imago::Settings& vars, const std::string& imageName, const std::string& configName);
+
+	// processes every file using up to 'threads' worker threads, each file gets its own copy of 'vars';
+	// results are stored to <file>.result.mol, or appended to 'sdf' in completion order if specified;
+	// pages of multi-page TIFF files are recognized as separate items stored to <file>.page<N>.result.mol,
+	// with PAGE field in 'sdf' and <file>#p<N> name in 'manifest';
+	// items are recorded in 'manifest' if specified, completed and quarantined ones are skipped;
+	// items sampled by trace_sink::shouldSample() store their timeline to <item>.trace.json;
+	// progress is printed in files order if 'ordered' is set, otherwise in completion order
+	int performFilesActions(int threads, bool ordered, const imago::Settings& vars, const std::vector<std::string>& files,
+		                    const std::string& configName, sdf_writer::SdfWriter* sdf = NULL,
+		                    batch_manifest::BatchManifest* manifest = NULL);
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,268 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "regression.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "benchmark.h"
+#include "recognition_helpers.h"
+#include "exception.h"
+#include "scanner.h"
+#include "thread_pool.h"
+#include "indigo.h"
+
+namespace regression
+{
+	typedef std::chrono::steady_clock Clock;
+
+	void loadTestCases(const strings& files, std::vector<TestCase>& cases)
+	{
+		for (size_t u = 0; u < files.size(); u++)
+		{
+			TestCase test;
+			std::string reference_file;
+			if (!file_helpers::getReferenceFileName(files[u], reference_file) || reference_file == files[u])
+				continue;
+
+			try
+			{
+				imago::FileScanner fsc("%s", reference_file.c_str());
+				fsc.readAll(test.reference);
+			}
+			catch (imago::ImagoException&)
+			{
+				continue; // no reference
+			}
+
+			test.image = files[u];
+			cases.push_back(test);
+		}
+	}
+
+	bool compareMolecules(const std::string& molecule, const std::string& reference, std::string& error, bool& indigoError)
+	{
+		indigoError = false;
+
+		int result = indigoLoadMoleculeFromString(molecule.c_str());
+		int expected = (result == -1) ? -1 : indigoLoadMoleculeFromString(reference.c_str());
+		if (result == -1 || expected == -1)
+		{
+			error = std::string("Indigo: ") + indigoGetLastError();
+			indigoError = true;
+			indigoFreeAllObjects();
+			return false;
+		}
+
+		int match = indigoExactMatch(expected, result, "");
+		if (match == -1)
+		{
+			error = std::string("Indigo: ") + indigoGetLastError();
+			indigoError = true;
+		}
+		else if (match == 0)
+		{
+			error = "Imago";
+		}
+
+		indigoFreeAllObjects();
+		return match > 0;
+	}
+
+	static std::string escapeXml(const std::string& value)
+	{
+		std::string result;
+		for (size_t u = 0; u < value.size(); u++)
+		{
+			switch (value[u])
+			{
+			case '&':  result += "&amp;"; break;
+			case '<':  result += "&lt;"; break;
+			case '>':  result += "&gt;"; break;
+			case '"':  result += "&quot;"; break;
+			case '\'': result += "&apos;"; break;
+			default:
+				if ((unsigned char)value[u] >= 0x20 || value[u] == '\t')
+					result += value[u];
+				else
+					result += ' ';
+			}
+		}
+		return result;
+	}
+
+	void storeJUnitReport(FILE* out, const std::vector<TestCase>& cases, double wallTime)
+	{
+		size_t failures = 0, errors = 0;
+		for (size_t u = 0; u < cases.size(); u++)
+		{
+			if (cases[u].indigoError)
+				errors++;
+			else if (!cases[u].failure.empty())
+				failures++;
+		}
+
+		size_t compared = cases.size() - errors;
+		double accuracy = compared ? (double)(compared - failures) / compared : 0.0;
+
+		fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+		fprintf(out, "<testsuite name=\"Imago\" tests=\"%u\" failures=\"%u\" errors=\"%u\" time=\"%.3f\">\n",
+		        (unsigned int)cases.size(), (unsigned int)failures, (unsigned int)errors, wallTime / 1000.0);
+		fprintf(out, "  <properties>\n");
+		fprintf(out, "    <property name=\"accuracy\" value=\"%.4f\"/>\n", accuracy);
+		fprintf(out, "  </properties>\n");
+
+		for (size_t u = 0; u < cases.size(); u++)
+		{
+			const TestCase& test = cases[u];
+
+			std::string name;
+			if (!file_helpers::getOnlyFileName(test.image, name))
+				name = test.image;
+
+			fprintf(out, "  <testcase classname=\"Imago\" name=\"%s\" time=\"%.3f\"", escapeXml(name).c_str(), test.time / 1000.0);
+			if (test.failure.empty())
+			{
+				fprintf(out, "/>\n");
+			}
+			else
+			{
+				fprintf(out, ">\n    <%s message=\"%s\"/>\n  </testcase>\n", test.indigoError ? "error" : "failure",
+				        escapeXml(test.failure).c_str());
+			}
+		}
+
+		fprintf(out, "</testsuite>\n");
+	}
+
+	int performRegression(const imago::Settings& vars, const strings& files, const std::string& configName,
+	                      int threads, const std::string& reportName)
+	{
+		std::vector<TestCase> cases;
+		loadTestCases(files, cases);
+
+		if (cases.empty())
+		{
+			printf("[ERROR] No images with reference molfiles\n");
+			return 1;
+		}
+
+		printf("Regression: %u images with references\n", (unsigned int)cases.size());
+
+		// the log is global and not thread-safe
+		if (vars.general.LogEnabled || vars.general.LogVFSEnabled)
+			threads = 1;
+
+		// without parallelism the calling thread processes the images with the default Indigo session
+		std::unique_ptr<imago::ThreadPool> pool;
+		if (threads != 1)
+			pool.reset(new imago::ThreadPool(threads));
+		size_t workers = pool ? pool->size() : 0;
+
+		imago::Settings workerVars = vars;
+		if (pool)
+			workerVars.general.MaxThreads = 1; // images are already processed in parallel
+
+		std::vector<qword> sessions(workers, 0);
+		std::vector<char> initialized(workers, 0); // not vector<bool>: written from different threads
+		std::mutex print_mutex;
+		size_t completed = 0;
+
+		Clock::time_point wallStart = Clock::now();
+
+		for (size_t u = 0; u < cases.size(); u++)
+		{
+			imago::ThreadPool::Task task = [&, u](int worker)
+			{
+				if (pool && !initialized[worker])
+				{
+					// Indigo sessions are not shared between threads
+					sessions[worker] = indigoAllocSessionId();
+					indigoSetSessionId(sessions[worker]);
+					initialized[worker] = 1;
+				}
+
+				TestCase& test = cases[u];
+				imago::Settings fileVars = workerVars;
+
+				Clock::time_point start = Clock::now();
+				recognition_helpers::RecognitionResult result = recognition_helpers::recognizeFile(fileVars, test.image, configName);
+				test.time = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+				test.molecule = result.molecule;
+				if (!result.error.empty())
+					test.failure = result.error;
+				else
+					compareMolecules(test.molecule, test.reference, test.failure, test.indigoError);
+
+				std::lock_guard<std::mutex> lock(print_mutex);
+				printf("[%u/%u] %s: %s (%.0f ms)\n", (unsigned int)++completed, (unsigned int)cases.size(), test.image.c_str(),
+				       test.failure.empty() ? "OK" : test.failure.c_str(), test.time);
+				fflush(stdout);
+			};
+
+			if (pool)
+				pool->enqueue(task);
+			else
+				task(0);
+		}
+
+		if (pool)
+			pool->wait();
+
+		double wallTime = std::chrono::duration<double, std::milli>(Clock::now() - wallStart).count();
+
+		for (size_t t = 0; t < sessions.size(); t++)
+			if (initialized[t])
+				indigoReleaseSessionId(sessions[t]);
+
+		size_t passed = 0, indigoFailed = 0;
+		std::vector<double> latencies;
+		for (size_t u = 0; u < cases.size(); u++)
+		{
+			if (cases[u].failure.empty())
+				passed++;
+			if (cases[u].indigoError)
+				indigoFailed++;
+			latencies.push_back(cases[u].time);
+		}
+
+		benchmark::StageStatistics latency = benchmark::calculateStatistics("latency", latencies);
+		size_t compared = cases.size() - indigoFailed;
+
+		printf("Test results:\n");
+		printf("Total images: %u\n", (unsigned int)compared);
+		printf("Successfully recognized images: %u, rate: %g\n", (unsigned int)passed, compared ? (double)passed / compared : 0.0);
+		printf("Indigo fails: %u\n", (unsigned int)indigoFailed);
+		printf("Latency: mean %.0f ms, p50 %.0f ms, p95 %.0f ms, max %.0f ms; wall time %.0f ms\n",
+		       latency.mean, latency.p50, latency.p95, latency.max, wallTime);
+
+		if (!reportName.empty())
+		{
+			FILE* out = (reportName == "-") ? stdout : fopen(reportName.c_str(), "w");
+			if (out == NULL)
+			{
+				printf("[ERROR] Can't create report file '%s'\n", reportName.c_str());
+				return 2;
+			}
+			storeJUnitReport(out, cases, wallTime);
+			if (out != stdout)
+				fclose(out);
+		}
+
+		return (passed == cases.size()) ? 0 : 3;
+	}
+}
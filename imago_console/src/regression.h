@@ -0,0 +1,55 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _regression_h
+#define _regression_h
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "file_helpers.h"
+#include "settings.h"
+
+namespace regression
+{
+	struct TestCase
+	{
+		std::string image;
+		std::string reference; // reference molfile text
+		std::string molecule;  // recognition result
+		std::string failure;   // empty if passed
+		bool indigoError;      // comparison is impossible
+		double time;           // milliseconds
+
+		TestCase() : indigoError(false), time(0.0) { }
+	};
+
+	// loads the images which have reference molfiles (image.png -> image.mol)
+	void loadTestCases(const strings& files, std::vector<TestCase>& cases);
+
+	// exact match of the molfiles using Indigo (the current Indigo session)
+	bool compareMolecules(const std::string& molecule, const std::string& reference, std::string& error, bool& indigoError);
+
+	void storeJUnitReport(FILE* out, const std::vector<TestCase>& cases, double wallTime);
+
+	// recognizes every image with reference using up to 'threads' threads in the current process,
+	// prints accuracy and latency summary and stores JUnit XML report to 'reportName';
+	// returns 0 if all the images are recognized exactly
+	int performRegression(const imago::Settings& vars, const strings& files, const std::string& configName,
+	                      int threads, const std::string& reportName);
+}
+
+#endif
@@ -0,0 +1,95 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#include "sdf_writer.h"
+#include "exception.h"
+
+namespace sdf_writer
+{
+	// records are collected up to this size before writing
+	static const size_t BUFFER_SIZE = 1024 * 1024;
+
+	static const char* EMPTY_MOLFILE = "\n  -IMAGO-\n\n  0  0  0  0  0  0  0  0  0  0999 V2000\nM  END\n";
+
+	SdfWriter::SdfWriter(const std::string& filename, bool append)
+	{
+		_written = 0;
+		_autoFlush = false;
+
+		if (filename == "-")
+		{
+			_file = stdout;
+		}
+		else
+		{
+			_file = fopen(filename.c_str(), append ? "ab" : "wb");
+			if (_file == NULL)
+				throw imago::ImagoException("Can't create SD file: " + filename);
+			if (append && fseek(_file, 0, SEEK_END) == 0)
+				_written = ftell(_file);
+		}
+		_buffer.reserve(BUFFER_SIZE);
+	}
+
+	SdfWriter::~SdfWriter()
+	{
+		flush();
+		if (_file != stdout)
+			fclose(_file);
+	}
+
+	long long SdfWriter::addRecord(const std::string& molfile, const DataFields& fields)
+	{
+		std::string record = molfile.empty() ? EMPTY_MOLFILE : molfile;
+		if (record[record.size() - 1] != '\n')
+			record += "\n";
+
+		for (size_t u = 0; u < fields.size(); u++)
+		{
+			// blank lines terminate the data item, so values are kept single-line
+			std::string value = fields[u].second;
+			for (size_t c = 0; c < value.size(); c++)
+				if (value[c] == '\n' || value[c] == '\r')
+					value[c] = ' ';
+
+			record += "> <" + fields[u].first + ">\n";
+			record += value + "\n\n";
+		}
+		record += "$$$$\n";
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		long long offset = _written + _buffer.size();
+		_buffer += record;
+		if (_autoFlush || _buffer.size() >= BUFFER_SIZE)
+			_flush();
+		return offset;
+	}
+
+	void SdfWriter::flush()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_flush();
+	}
+
+	void SdfWriter::_flush()
+	{
+		if (!_buffer.empty())
+		{
+			fwrite(_buffer.c_str(), 1, _buffer.size(), _file);
+			_written += _buffer.size();
+			_buffer.clear();
+		}
+		fflush(_file);
+	}
+}
@@ -0,0 +1,64 @@
+/****************************************************************************
+ * Copyright (C) 2009-2012 GGA Software Services LLC
+ * 
+ * This file is part of Imago toolkit.
+ * 
+ * This file may be distributed and/or modified under the terms of the
+ * GNU General Public License version 3 as published by the Free Software
+ * Foundation and appearing in the file LICENSE.GPL included in the
+ * packaging of this file.
+ * 
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ ***************************************************************************/
+
+#pragma once
+
+#ifndef _sdf_writer_h
+#define _sdf_writer_h
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sdf_writer
+{
+	typedef std::vector<std::pair<std::string, std::string> > DataFields;
+
+	// appends SD records to a single file (or stdout for "-"), thread-safe;
+	// records are buffered and written in the order they are added
+	class SdfWriter
+	{
+	public:
+		// 'append' keeps the existing records (for resumed runs)
+		SdfWriter(const std::string& filename, bool append = false);
+		~SdfWriter();
+
+		bool isStdout() const { return _file == stdout; }
+
+		// empty molfile means a record without structure (e.g. failed recognition);
+		// returns the offset of the record in the output
+		long long addRecord(const std::string& molfile, const DataFields& fields);
+
+		// write every record immediately, so it is not lost if the process crashes
+		void setAutoFlush(bool value) { _autoFlush = value; }
+
+		void flush();
+
+	private:
+		FILE* _file;
+		std::string _buffer;
+		long long _written;
+		bool _autoFlush;
+		std::mutex _mutex;
+
+		void _flush();
+
+		SdfWriter(const SdfWriter&);
+		SdfWriter& operator=(const SdfWriter&);
+	};
+}
+
+#endif // _sdf_writer_h
@@ -1,5 +1,7 @@
 #include "similarity_tools.h"
 
+#include <algorithm>
+
 #include "exception.h"
 #include "platform_tools.h"
 
@@ -17,6 +19,26 @@ namespace similarity_tools
 		similarity_tool_param = param;
 	}
 
+	bool isExternalSimilarityTool()
+	{
+		return !similarity_tool_exe.empty();
+	}
+
+	// both molecules are freed by the caller
+	static double compareMolecules(int outm, int refm)
+	{
+		indigoNormalize(refm, "");
+		indigoNormalize(outm, "");
+
+		float sim1 = indigoSimilarity(refm, outm, "normalized-edit");
+		indigoAromatize(refm);
+		indigoAromatize(outm);
+
+		float sim2 = indigoSimilarity(refm, outm, "normalized-edit");
+
+		return 100.0 * std::max(sim1, sim2);
+	}
+
 	std::string quote(const std::string input)
 	{
 		std::string result = input;
@@ -57,21 +79,37 @@ namespace similarity_tools
 				throw imago::IOException("Failed to load " + ctx.reference_file + ":" + indigoGetLastError());
          }
 
-         indigoNormalize(refm, "");
-         indigoNormalize(outm, "");
+         result = compareMolecules(outm, refm);
 
-         float sim1 = indigoSimilarity(refm, outm, "normalized-edit");
-         indigoAromatize(refm);
-         indigoAromatize(outm);
+         // Clear all the objects used by Indigo
+         indigoFreeAllObjects();
+		}
 
-         float sim2 = indigoSimilarity(refm, outm, "normalized-edit");
+		return result;
+	}
 
-         result = 100.0 * std::max(sim1, sim2);
+	double getSimilarity(const std::string& molfile, const std::string& reference_file)
+	{
+		if (molfile.empty())
+			throw imago::IOException("Failed to load recognized molecule: no structure");
 
-         // Clear all the objects used by Indigo
-         indigoFreeAllObjects();
+		int outm = indigoLoadMoleculeFromString(molfile.c_str());
+		if (outm == -1)
+		{
+			indigoFreeAllObjects();
+			throw imago::IOException(std::string("Failed to load recognized molecule:") + indigoGetLastError());
+		}
+		int refm = indigoLoadMoleculeFromFile(reference_file.c_str());
+		if (refm == -1)
+		{
+			indigoFreeAllObjects();
+			throw imago::IOException("Failed to load " + reference_file + ":" + indigoGetLastError());
 		}
 
+		double result = compareMolecules(outm, refm);
+
+		indigoFreeAllObjects();
+
 		return result;
 	}
 }
@@ -23,7 +23,11 @@
 namespace similarity_tools
 {
 	void   setExternalSimilarityTool(const std::string& executable, const std::string& param = "");
+	bool   isExternalSimilarityTool();
 	double getSimilarity(const LearningContext& ctx);
+
+	// compares the molfile text with the reference file in-process using Indigo (the current Indigo session)
+	double getSimilarity(const std::string& molfile, const std::string& reference_file);
 }
 
 #endif // _similarity_tools_h